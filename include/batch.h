@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "compressor.h"
+
+// dir 의 일반 파일 ('.' 로 시작하는 것 제외) 이름을 정렬해 돌려준다. 목록과 이름은 호출자가 free. 실패 시 1.
+int batch_list_files(const char *dir_name, char ***names_out, size_t *count_out);
+
+// output_dir/<name>.ddp (name 이 .bin 으로 끝나면 떼어 낸다). 호출자가 free, 실패 시 NULL.
+char *batch_output_path(const char *output_dir, const char *name);
+
+// input_dir 의 일반 파일을 이름 순서로 모두 압축해 output_dir/<이름>.ddp 로 기록한다
+// (이름이 .bin 으로 끝나면 떼어 낸다). opts->shared 는 한 번 읽어 둔 것을 모든 파일이
+// 같이 쓴다. 실패한 파일이 있어도 나머지는 계속 처리하고 하나라도 실패하면 1.
+int compress_directory(const char *input_dir, const char *output_dir,
+                       int width_bytes, int block_size_samples,
+                       const CompressOptions *opts);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "compressor.h"
+#include <stdio.h>
+
+// 벤치마크할 입력 파일과 sample 폭. sensor 이름은 파일 이름에서 _raw.bin (없으면 확장자) 을 뗀 것.
+typedef struct {
+    const char *path;
+    int width_bytes;
+} BenchInput;
+
+typedef struct {
+    int warmup;   // 측정하지 않고 버리는 실행 횟수 (page cache, allocator 예열)
+    int repeats;  // 측정 횟수. elapsed_sec 는 그 중앙값
+    const int *block_sizes;
+    size_t num_block_sizes;
+    const CompressOptions *compress;
+    const DecompressOptions *decompress;
+    FILE *csv;
+} BenchOptions;
+
+// 입력 x block 크기마다 압축 ('ENC') 과 복원 ('DEC') 을 process 안에서 반복 실행하고
+// encode_bench.sh/decode_bench.sh 와 같은 열 (mode,sensor,block_size,elapsed_sec,max_rss_kb)
+// 뒤에 mb_per_sec,ns_per_block,dict_hit_rate 를 붙여 csv 에 한 줄씩 쓴다.
+// 측정마다 fork 한 child 에서 실행해 max_rss_kb 가 그 측정의 최대 메모리만 담는다.
+// 중간 파일은 work_dir/<sensor>_b<B>.ddp, .bin 에 남는다. 하나라도 실패하면 1.
+int run_bench(const char *work_dir, const BenchInput *inputs, size_t num_inputs,
+              const BenchOptions *opts);
+
+#endif
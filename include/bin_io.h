@@ -2,9 +2,127 @@
 #define BIN_IO_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 int read_binary_file(const char *filename, unsigned char **data_out, size_t *nbytes_out);
 
+// 파일을 읽기 전용으로 mmap 한다 (복사 없음). 빈 파일이면 *data_out = NULL, *nbytes_out = 0.
+int map_binary_file(const char *filename, const unsigned char **data_out, size_t *nbytes_out);
+
+// 쓰기 가능한 copy-on-write mapping (MAP_PRIVATE). 고친 page 는 파일에 반영되지 않는다.
+int map_binary_file_private(const char *filename, unsigned char **data_out, size_t *nbytes_out);
+
+void unmap_binary_file(const unsigned char *data, size_t nbytes);
+
+// 이미 처리한 [0, done_bytes) 구간의 page 를 mapping 에서 내려 RSS 를 줄인다.
+void release_mapped_prefix(const unsigned char *data, size_t done_bytes);
+
+// nbytes 크기의 출력 파일을 만들고 쓰기 가능하게 mmap 한다 (MAP_SHARED).
+// 여러 thread 가 서로 다른 구간을 직접 채울 수 있다.
+int create_mapped_file(const char *filename, size_t nbytes, unsigned char **data_out);
+
+int close_mapped_file(unsigned char *data, size_t nbytes);
+
 int write_binary_file(const char *filename, const unsigned char *data, size_t nbytes);
 
+// FILE 앞단의 대용량 staging buffer. 작은 write 를 모아 한 번에 fwrite 하고,
+// 버퍼보다 큰 write 는 그대로 통과시킨다. 오류는 error 에 누적되어 bw_flush 가 보고한다.
+typedef struct {
+    FILE *fp;
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+    int error;
+} BinWriter;
+
+int bw_init(BinWriter *w, FILE *fp);
+
+// 파일 대신 메모리로 모으는 writer (fp == NULL). 결과는 buf[0, len), bw_free 로 해제.
+int bw_init_mem(BinWriter *w);
+
+void bw_free(BinWriter *w);
+
+// 메모리 writer 를 비운다. 버퍼는 그대로 두어 다음 기록에 다시 쓴다.
+void bw_reset(BinWriter *w);
+
+// 메모리 writer 끝에 n 바이트 자리를 확보하고 그 포인터를 돌려준다 (실패 시 NULL).
+unsigned char *bw_reserve(BinWriter *w, size_t n);
+
+int bw_flush(BinWriter *w);
+
+int bw_write(BinWriter *w, const void *data, size_t n);
+
+int bw_put_u8(BinWriter *w, uint8_t v);
+
+int bw_put_u32le(BinWriter *w, uint32_t v);
+
+int bw_put_u32le_array(BinWriter *w, const uint32_t *v, size_t n);
+
+// 읽기 쪽 staging buffer. br_* 는 요청한 바이트를 모두 읽었을 때 1 을 돌려준다.
+typedef struct {
+    FILE *fp;
+    unsigned char *buf;
+    size_t pos;
+    size_t len;
+    size_t cap;
+} BinReader;
+
+int br_init(BinReader *r, FILE *fp);
+
+// 메모리 구간 [data, data + n) 을 읽는 reader (fp == NULL). data 는 복사하지 않는다.
+void br_init_mem(BinReader *r, const unsigned char *data, size_t n);
+
+void br_free(BinReader *r);
+
+int br_read(BinReader *r, void *data, size_t n);
+
+int br_get_u8(BinReader *r, uint8_t *out);
+
+int br_get_u32le(BinReader *r, uint32_t *out);
+
+int br_get_u32le_array(BinReader *r, uint32_t *out, size_t n);
+
+// n 바이트를 건너뛴다. 버퍼에 없는 부분은 fseek 하므로 큰 section 도 읽지 않는다.
+int br_skip(BinReader *r, size_t n);
+
+// 다음에 읽을 바이트의 파일 (메모리 reader 는 구간) 내 위치.
+size_t br_tell(BinReader *r);
+
+// 아직 읽지 않은 바이트 수 (header 의 크기 값을 믿기 전에 확인하는 용도).
+size_t br_remaining(BinReader *r);
+
+// 더 읽을 바이트가 없으면 1.
+int br_at_eof(BinReader *r);
+
+// 출력 구간을 복사하지 않고 (pointer, 길이) 로 모았다가 writev 로 한 번에 내보내는 writer.
+// vw_add 에 넘긴 메모리는 vw_flush/vw_close 가 돌아올 때까지 유지되어야 한다.
+// 바로 앞 구간과 메모리가 이어지면 크기와 무관하게 하나로 합치므로 dictionary 에 연달아
+// 놓인 block 은 복사 없이 나간다. 이어지지 않는 256 byte 미만 구간 (이 repo 의 보통 block 크기)
+// 은 iovec 하나의 kernel 비용이 복사보다 비싸서 stage 에 한 번 복사해 모은다.
+// 오류는 error 에 누적된다.
+typedef struct {
+    int fd;
+    void *iov;    // struct iovec[VW_BATCH]
+    int n;
+    unsigned char *stage;
+    size_t stage_len;
+    int error;
+} VecWriter;
+
+int vw_open(VecWriter *w, const char *filename);
+
+int vw_add(VecWriter *w, const void *data, size_t n);
+
+int vw_flush(VecWriter *w);
+
+// 남은 구간을 내보내고 닫는다. 쓰기 오류가 있었으면 1.
+int vw_close(VecWriter *w);
+
+// 열려 있는 파일을 nbytes 로 자른다 (append 실패 시 원래 크기로 되돌리는 용도).
+int truncate_open_file(FILE *fp, size_t nbytes);
+
+// 버퍼를 비우고 파일 내용을 디스크까지 내린다 (append 의 commit 순서를 지키는 용도).
+int sync_open_file(FILE *fp);
+
 #endif
\ No newline at end of file
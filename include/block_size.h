@@ -0,0 +1,20 @@
+#ifndef BLOCK_SIZE_H
+#define BLOCK_SIZE_H
+
+#include <stddef.h>
+
+// block_size_samples = 0 (auto) 일 때 시험하는 후보 (encode_bench.sh 와 같은 2,4,...,32)
+#define AUTO_BLOCK_MIN  2
+#define AUTO_BLOCK_MAX  32
+#define AUTO_BLOCK_STEP 2
+
+// 자동 선택 시 입력 앞부분에서 읽는 최대 바이트 수
+#define AUTO_SAMPLE_BYTES (4u << 20)
+
+// 후보 block 크기마다 samples (n 개, 이미 transform 적용) 의 고유 block 수와
+// id run 수를 세어 출력 크기를 추정하고, 샘플당 추정 바이트가 가장 작은
+// block 크기를 돌려준다. 후보 block 을 하나도 채우지 못하면 AUTO_BLOCK_MIN.
+int choose_block_size(const unsigned char *samples, size_t n, int width_bytes,
+                      int packed_ids, int rle_ids, double *bytes_per_sample);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef CDC_H
+#define CDC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Gear rolling hash 기반 content-defined chunking.
+// 경계는 샘플 경계에서만 검사하므로 chunk 길이는 항상 width 의 배수다.
+// 평균 chunk 길이가 avg_samples 가 되도록 [avg/4, avg*4] 구간에서 자른다.
+typedef struct {
+    uint64_t gear[256];
+    uint64_t mask;     // 상위 bit mask: (h & mask) == 0 이면 경계
+    size_t min_bytes;
+    size_t max_bytes;
+    int width;
+} CdcParams;
+
+void cdc_init(CdcParams *c, int width, int avg_samples);
+
+// data[0, n) 의 첫 chunk 길이 (바이트). n 은 width 의 배수여야 하며 n 이하를 돌려준다.
+size_t cdc_next(const CdcParams *c, const unsigned char *data, size_t n);
+
+#endif
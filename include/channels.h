@@ -0,0 +1,38 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include "compressor.h"
+
+#define CHANNELS_MAX 64
+
+// 여러 channel 이 record 마다 interleave 된 입력 (예: T, RH, lux, P) 의 container.
+// record 는 channel 값을 순서대로 이어 붙인 것이고 channel 마다 따로 dedup 한
+// 고정 block stream 을 담는다. 정수는 little endian.
+//   magic "DDPC"
+//   u32: num_channels
+//   u32: record_count
+//   u32: tail_bytes (마지막에 record 를 채우지 못한 바이트)
+//   channel 마다: u8 width_bytes, u8[3] 0, u32 stream_bytes 하위, u32 stream_bytes 상위
+//   [tail]: tail_bytes 바이트 그대로
+//   channel 마다: stream_bytes 바이트의 DDP1/DDP2 (ddp_compress_buf 결과, 샘플 수 = record_count)
+typedef struct {
+    int num_channels;
+    int widths[CHANNELS_MAX];  // 1, 2, 4, 8
+} ChannelLayout;
+
+// "2,2,2,4" 같은 channel 폭 목록. 실패 시 메시지를 출력하고 1.
+int channel_layout_parse(const char *s, ChannelLayout *layout);
+
+// 입력을 한 번 mmap 하고 channel 마다 thread 하나가 자기 열을 모아 압축한다.
+// opts 는 channel 모두에 적용되며 stream, CDC, 공유 dictionary, segment 는 지원하지 않는다.
+int compress_channels(const char *input_filename, const char *output_filename,
+                      const ChannelLayout *layout, int block_size_samples,
+                      const CompressOptions *opts);
+
+// magic 이 DDPC 이면 1.
+int is_channel_file(const char *filename);
+
+// channel 마다 thread 하나가 복원해 mmap 한 출력의 자기 열에 바로 써 넣는다.
+int decompress_channels(const char *input_filename, const char *output_filename);
+
+#endif
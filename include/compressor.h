@@ -1,8 +1,95 @@
 #ifndef COMPRESSOR_H
 #define COMPRESSOR_H
 
+#include "bin_io.h"
+#include "shared_dict.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int stream;   // 1: 입력을 chunk 단위로 읽어 DDP_FLAG_STREAM 포맷으로 기록 (메모리 사용량 = dictionary 크기)
+    int threads;  // fingerprint 를 계산하는 thread 수 (1 = 단일 thread). 출력은 thread 수와 무관
+    int packed_ids;  // 1: block id 를 ceil(log2(dict_size)) bit 로 packing 한 DDP2 로 기록
+    int rle_ids;     // 1: 연속된 같은 block id 를 (id, 길이) run 으로 기록 (DDP_FLAG_RLE)
+    int transform;   // dedup 전에 적용할 DDP_TRANSFORM_* (transform.h), 기본 NONE
+    int codec;       // dictionary/id section 의 DDP_CODEC_* (entropy.h), 기본 NONE
+    int cdc;         // 1: 고정 block 대신 rolling hash 경계의 가변 chunk (DDP_FLAG_CDC), block_size 는 평균
+    size_t dict_limit_bytes;  // 0 이 아니면 stream 모드 dictionary 를 이 크기로 제한하고 CLOCK 으로 교체 (DDP_FLAG_BOUNDED)
+    SharedDict *shared;  // NULL 이 아니면 이 공유 dictionary 를 참조해 새 block 만 기록 (DDP_FLAG_SHARED)
+    uint64_t epsilon;    // 0 이 아니면 샘플마다 이 값 이내로 다른 기존 block 에 묶는 손실 압축 (near_match.h)
+    int freq_order;      // 1: dedup 뒤 새 dictionary 항목을 많이 쓰인 순서로 다시 번호 매김 (포맷은 그대로)
+    uint32_t segment_blocks;  // 0 이 아니면 이 block 수마다 독립 segment + CRC-32C + footer index (segments.h)
+} CompressOptions;
+
+void compress_options_init(CompressOptions *opts);
+
 int compress_file(const char *input_filename, const char *output_filename, int width_bytes, int block_size_sample);
 
+// block_size_sample 이 0 이면 입력 앞부분으로 block 크기를 자동 선택한다 (block_size.h).
+int compress_file_opts(const char *input_filename, const char *output_filename,
+                       int width_bytes, int block_size_sample,
+                       const CompressOptions *opts);
+
+// 기존 .ddp 파일 끝에 input 을 새 segment 로 덧붙인다. dictionary 는 기존 것을
+// 이어서 쓰고, 기존 id section 은 읽지 않고 건너뛰므로 비용은 dictionary 크기와
+// 새 입력 크기에 비례한다. width/block 크기는 header 를 따른다.
+int append_file(const char *input_filename, const char *ddp_filename, int threads);
+
+typedef struct {
+    int threads;  // 1 보다 크면 출력 파일을 mmap 해서 thread 별로 나눠 채움 (DDP_FLAG_STREAM 파일은 순차 복원)
+    const SharedDict *shared;  // DDP_FLAG_SHARED 파일이 참조하는 공유 dictionary
+} DecompressOptions;
+
+void decompress_options_init(DecompressOptions *opts);
+
 int decompress_file(const char *input_filename, const char *output_filename);
 
+int decompress_file_opts(const char *input_filename, const char *output_filename,
+                         const DecompressOptions *opts);
+
+// [start_sample, start_sample + count) 구간만 복원한다. 파일을 mmap 해서
+// 구간을 덮는 block 만 읽으므로 비용은 파일 크기가 아니라 구간 크기에 비례한다.
+int decompress_range(const char *input_filename, size_t start_sample, size_t count,
+                     const char *output_filename);
+
+// 메모리 버퍼용 압축/복원 context. 호출 사이에 dictionary arena/index, id 배열,
+// 출력 버퍼를 유지하므로 같은 크기의 batch 를 반복하면 새로 할당하지 않는다.
+// 고정 block 포맷 (stream/CDC 제외) 만 다루며 thread 하나에서만 써야 한다.
+typedef struct {
+    Dictionary dict;    // 압축용 (index 포함). 호출이 끝나면 항목만 비운다
+    Dictionary blocks;  // 복원용 arena (index 없음)
+    uint32_t *ids;
+    size_t ids_cap;
+    unsigned char *tail;
+    size_t tail_cap;
+    BinWriter out;      // 마지막 결과. 다음 호출이나 ddp_context_free 전까지 유효
+} DdpContext;
+
+int ddp_context_init(DdpContext *ctx);
+
+void ddp_context_free(DdpContext *ctx);
+
+// src[0, nbytes) 를 .ddp 바이트열로 압축한다. 결과는 *out, *out_len (ctx 소유).
+// opts 가 NULL 이면 기본값이며 opts->stream, opts->cdc 는 지원하지 않는다. 실패 시 1.
+int ddp_compress_buf(DdpContext *ctx, const void *src, size_t nbytes,
+                     int width_bytes, int block_size_samples, const CompressOptions *opts,
+                     const unsigned char **out, size_t *out_len);
+
+// .ddp 바이트열을 복원한다. shared 는 DDP_FLAG_SHARED 데이터일 때만 필요. 실패 시 1.
+int ddp_decompress_buf(DdpContext *ctx, const void *src, size_t nbytes,
+                       const SharedDict *shared, const unsigned char **out, size_t *out_len);
+
+// .ddp header 에 기록된 요약 정보. num_blocks 와 dict_size 로 dedup 비율을 알 수 있다.
+typedef struct {
+    uint32_t sample_count;
+    int width_bytes;
+    int block_size_samples;
+    int flags;           // DDP_FLAG_*
+    uint32_t dict_size;  // 서로 다른 block 수 (공유 dictionary 항목 포함)
+    uint32_t num_blocks;
+} DdpInfo;
+
+// header 만 읽는다. 실패 시 메시지를 출력하고 1.
+int read_ddp_info(const char *filename, DdpInfo *info);
+
 #endif
\ No newline at end of file
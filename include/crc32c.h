@@ -0,0 +1,11 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli). x86-64 에서 SSE4.2 가 있으면 crc32 명령을, 없으면 slice-by-8 table 을 쓴다.
+// crc 에 이전 결과를 넘기면 이어서 계산한다 (처음은 0).
+uint32_t crc32c(uint32_t crc, const void *data, size_t n);
+
+#endif
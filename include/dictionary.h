@@ -2,20 +2,117 @@
 #define DICTIONARY_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
-    unsigned char **blocks;
+    unsigned char *blocks;  // 모든 block 을 id 순서로 이어 붙인 arena (capacity * block_size)
     int size;
     int capacity;
     size_t block_size;
+    int indexed;        // index 에 등록된 block 수 (blocks[0, indexed))
+    uint64_t *hashes;   // id별 block fingerprint
+    uint32_t *table;    // open addressing index: id + 1, 0 = 빈 슬롯
+    size_t table_mask;  // table 크기 - 1 (2의 거듭제곱)
+    int kernel;         // block_size 에 맞춰 dict_init 에서 고른 hash/compare kernel
+    int borrowed;       // 1: blocks/hashes/table 이 외부 메모리 (처음 커질 때 복사, free 하지 않음)
 } Dictionary;
 
 void dict_init(Dictionary *dict, size_t block_size);
 
 void dict_free(Dictionary *dict);
 
+static inline unsigned char *dict_block(const Dictionary *dict, int id)
+{
+    return dict->blocks + (size_t)id * dict->block_size;
+}
+
+// n 개 block 자리를 arena 끝에 확보하고 첫 자리의 포인터를 돌려준다.
+// 호출자가 내용을 직접 채우며, dict_find 에 쓰려면 dict_reindex 를 불러야 한다.
+unsigned char *dict_append_raw(Dictionary *dict, int n);
+
+void dict_reindex(Dictionary *dict);
+
+uint64_t dict_hash(const Dictionary *dict, const unsigned char *block);
+
 int dict_find(const Dictionary *dict, const unsigned char *block);
 
 int dict_add(Dictionary *dict, const unsigned char *block);
 
+// h == dict_hash(dict, block) 를 이미 계산해 둔 경우의 변형.
+// dict_find_hashed 는 dictionary 를 수정하지 않으므로 여러 thread 에서 동시에 불러도 된다.
+int dict_find_hashed(const Dictionary *dict, const unsigned char *block, uint64_t h);
+
+int dict_add_hashed(Dictionary *dict, const unsigned char *block, uint64_t h);
+
+// dict_find_batch / dict_add_batch 가 hash 하고 prefetch 하는 group 크기
+#define DICT_BATCH 32
+
+// dict_find_batch 에서 찾지 못한 block 의 id
+#define DICT_MISSING UINT32_MAX
+
+// blocks 에 block_size 간격으로 이어진 count 개 block 을 DICT_BATCH 개씩 묶어
+// hash -> bucket prefetch -> 비교 순서로 찾는다. ids[i] 는 id 또는 DICT_MISSING,
+// hashes 가 NULL 이 아니면 hashes[i] = dict_hash. dict_find_hashed 처럼 읽기만 한다.
+void dict_find_batch(const Dictionary *dict, const unsigned char *blocks, size_t count,
+                     uint32_t *ids, uint64_t *hashes);
+
+// dict_find_batch 와 같이 찾되 없는 block 은 더한다. 결과는 block 마다
+// dict_find 후 dict_add 한 것과 같다 (새 id 는 첫 등장 순서).
+void dict_add_batch(Dictionary *dict, const unsigned char *blocks, size_t count, uint32_t *ids);
+
+// 항목 capacity 개 자리를 미리 정확히 확보한다 (크기 상한이 있는 dictionary 용).
+void dict_reserve(Dictionary *dict, int capacity);
+
+// 항목 id 의 내용을 block 으로 바꾸고 index 도 갱신한다 (h == dict_hash(dict, block)).
+void dict_replace_hashed(Dictionary *dict, int id, const unsigned char *block, uint64_t h);
+
+// 외부 메모리 (예: mmap 한 index 파일) 의 size 개 항목과 table 을 그대로 쓰는 dictionary.
+// table 은 dict_reindex 가 만든 것과 같은 배치여야 하며 (table_size 는 2의 거듭제곱,
+// size * 2 이하가 아님) 내용은 dictionary 가 고칠 수 있어야 한다 (MAP_PRIVATE 등).
+// 항목을 더해 자리가 모자라면 그때 자기 메모리로 복사한다. dict_free 는 외부 메모리를 놓지 않는다.
+void dict_borrow(Dictionary *dict, size_t block_size, int size, unsigned char *blocks,
+                 uint64_t *hashes, uint32_t *table, size_t table_size);
+
+// id >= size 인 항목을 지운다 (공유 dictionary 를 입력마다 재사용할 때).
+// 항목은 추가된 역순으로만 지워지므로 index 에서 slot 을 비우기만 하면 된다.
+// index 에서 항목을 찾지 못하면 (깨진 index) 남은 항목으로 index 를 다시 만들고 1.
+int dict_truncate(Dictionary *dict, int size);
+
+// 항목 [base, size) 의 id 를 바꾼다. 새 id base + k 는 이전 id order[k] 의 block 이며
+// order 는 [base, size) 의 순열이어야 한다. index 는 새 id 순서로 다시 만든다.
+// dict_truncate 가 실패하면 항목 [base, size) 가 지워진 채로 1.
+int dict_renumber(Dictionary *dict, int base, const uint32_t *order);
+
+// block 내용과 block_size 로 정해지는 64-bit checksum (공유 dictionary 식별용).
+uint64_t dict_checksum(const Dictionary *dict);
+
+// content-defined chunking 용 가변 길이 dictionary. 항목 i 는
+// data[offsets[i], offsets[i + 1]) 이고 index 구조는 Dictionary 와 같다.
+typedef struct {
+    unsigned char *data;
+    size_t data_len;
+    size_t data_cap;
+    size_t *offsets;    // size + 1 개
+    int size;
+    int capacity;
+    uint64_t *hashes;
+    uint32_t *table;
+    size_t table_mask;
+} VarDictionary;
+
+void vdict_init(VarDictionary *dict);
+
+void vdict_free(VarDictionary *dict);
+
+static inline size_t vdict_len(const VarDictionary *dict, int id)
+{
+    return dict->offsets[id + 1] - dict->offsets[id];
+}
+
+uint64_t vdict_hash(const unsigned char *chunk, size_t len);
+
+int vdict_find_hashed(const VarDictionary *dict, const unsigned char *chunk, size_t len, uint64_t h);
+
+int vdict_add_hashed(VarDictionary *dict, const unsigned char *chunk, size_t len, uint64_t h);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// dictionary / id section 에 적용하는 2차 압축. header_extra[3] 에 기록된다.
+//  RANS: order-0 byte rANS (12-bit 확률, state 2개 interleave)
+enum {
+    DDP_CODEC_NONE = 0,
+    DDP_CODEC_RANS = 1,
+    DDP_CODEC_COUNT
+};
+
+// "none", "rans" -> DDP_CODEC_*, 모르는 이름이면 -1.
+int codec_parse(const char *name);
+
+// rans_encode 출력의 최대 크기
+size_t rans_bound(size_t n);
+
+// in[0, n) 을 out 에 부호화하고 쓴 바이트 수를 돌려준다. out 은 rans_bound(n) 바이트.
+size_t rans_encode(const unsigned char *in, size_t n, unsigned char *out);
+
+// rans_encode 의 출력을 out[0, n) 로 복원한다. 입력이 손상되었으면 1.
+int rans_decode(const unsigned char *in, size_t in_size, unsigned char *out, size_t n);
+
+#endif
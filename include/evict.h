@@ -0,0 +1,25 @@
+#ifndef EVICT_H
+#define EVICT_H
+
+// 크기가 고정된 dictionary 의 CLOCK (second chance) 교체 정책.
+// 압축기와 복원기가 같은 순서로 touch/insert 를 부르면 같은 victim 이 나온다.
+typedef struct {
+    unsigned char *ref;  // id 별 reference bit
+    int capacity;
+    int hand;
+} ClockState;
+
+int clock_init(ClockState *c, int capacity);
+
+void clock_free(ClockState *c);
+
+static inline void clock_touch(ClockState *c, int id)
+{
+    c->ref[id] = 1;
+}
+
+// reference bit 가 꺼진 첫 id 를 고르고 (지나가는 id 의 bit 는 끈다) 그 자리를
+// 새 항목으로 표시한다. 돌려준 id 의 내용은 호출자가 바꾼다.
+int clock_evict(ClockState *c);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef ID_PACK_H
+#define ID_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// dict_size 개 id 를 표현하는 데 필요한 bit 수: ceil(log2(dict_size)), dict_size <= 1 이면 0
+int id_bits_for(uint32_t dict_size);
+
+size_t packed_ids_size(size_t n, int bits);
+
+// ids 를 LSB-first bit stream 으로 packing 한다. out 은 packed_ids_size(n, bits) 바이트.
+void pack_ids(const uint32_t *ids, size_t n, int bits, unsigned char *out);
+
+// packed 는 packed_ids_size(n, bits) 바이트여야 한다.
+void unpack_ids(const unsigned char *packed, size_t n, int bits, uint32_t *ids_out);
+
+// i 번째 id 하나만 꺼낸다 (random access 용). size 는 packed 의 바이트 수.
+uint32_t packed_id_at(const unsigned char *packed, size_t size, int bits, size_t i);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef NEAR_MATCH_H
+#define NEAR_MATCH_H
+
+#include "dictionary.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 허용 오차 (lossy) block 매칭. 모든 샘플 (unsigned little-endian) 의 차이가 epsilon
+// 이하인 dictionary 항목을 LSH bucket 으로 찾는다. table 마다 샘플을 offset 을 달리한
+// 격자 (cell) 로 양자화한 signature 를 hash 하므로, 가까운 block 은 적어도 한 table 에서
+// 같은 bucket 에 들어갈 가능성이 높다. bucket 후보는 샘플별로 다시 확인한다.
+#define NEAR_TABLES 4
+#define NEAR_CANDIDATES 64  // table 하나에서 확인하는 최근 항목 수
+
+typedef struct {
+    uint64_t epsilon;
+    uint64_t cell;        // 양자화 격자 크기
+    int width_bytes;
+    size_t block_samples;
+    uint32_t *heads;      // NEAR_TABLES * (head_mask + 1), bucket 의 최근 id + 1 (0 = 빈 bucket)
+    uint32_t *next;       // NEAR_TABLES * capacity, 같은 bucket 의 이전 id + 1
+    size_t head_mask;
+    int size;
+    int capacity;
+    size_t matches;       // near_find 가 찾아 준 횟수
+} NearIndex;
+
+// dict 의 기존 항목 (공유 dictionary 등) 을 모두 넣은 index 를 만든다. 실패 시 1.
+int near_init(NearIndex *ni, const Dictionary *dict, int width_bytes, uint64_t epsilon);
+
+void near_free(NearIndex *ni);
+
+// block 과 샘플마다 epsilon 이내인 항목의 id, 없으면 -1.
+int near_find(NearIndex *ni, const Dictionary *dict, const unsigned char *block);
+
+// dict 에 방금 더한 항목 id (== ni->size) 를 index 에 넣는다.
+void near_add(NearIndex *ni, const Dictionary *dict, int id);
+
+#endif
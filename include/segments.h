@@ -0,0 +1,42 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include "compressor.h"
+
+// 독립 segment 로 나눈 container (magic "DDPS"). segment 마다 segment_blocks 개 block
+// (마지막 segment 는 나머지 샘플 전부) 을 자기 dictionary 로 압축한 DDP1/DDP2 stream 과
+// CRC-32C 를 담고, 끝의 footer index 로 segment 위치를 바로 찾는다. segment 끼리 서로를
+// 참조하지 않으므로 검사, 복원, 건너뛰기를 segment 단위로 병렬로 할 수 있고, 쓰다 끊긴
+// 파일도 앞쪽 segment 는 header 를 따라가며 되살릴 수 있다. 정수는 little endian.
+//   header (16): "DDPS", u8 width_bytes, u8[3] 0, u32 block_size_samples, u32 segment_blocks
+//   segment 마다:
+//     "DSEG", u32 stream_bytes, u32 sample_count, u32 crc32c(stream)
+//     [stream]: stream_bytes 바이트 (ddp_compress_buf 결과)
+//   footer index: segment 마다 u64 offset (segment header 위치), u32 stream_bytes,
+//                 u32 sample_count, u32 crc32c(stream), u32 0
+//   trailer (20): u32 num_segments, u32 crc32c(footer index), u64 index offset, "DDPE"
+#define SEGMENTS_HEADER_SIZE 16
+#define SEGMENT_HEADER_SIZE 16
+#define SEGMENT_ENTRY_SIZE 24
+#define SEGMENTS_TRAILER_SIZE 20
+
+int compress_segmented(const char *input_filename, const char *output_filename,
+                       int width_bytes, int block_size_samples, const CompressOptions *opts);
+
+// magic 이 DDPS 이면 1.
+int is_segmented_file(const char *filename);
+
+// opts->threads 개 thread 가 segment 를 나눠 checksum 을 확인하고 mmap 한 출력의 제자리에 복원한다.
+// footer 가 없거나 깨졌으면 앞에서부터 온전한 segment 만 복원하고 1.
+int decompress_segmented(const char *input_filename, const char *output_filename,
+                         const DecompressOptions *opts);
+
+// [start_sample, start_sample + count) 를 덮는 segment 만 checksum 확인 후 복원한다.
+int decompress_segmented_range(const char *input_filename, uint64_t start_sample, uint64_t count,
+                               const char *output_filename);
+
+// 모든 segment 의 checksum 을 threads 개 thread 로 확인하고 깨진 segment 를 출력한다.
+// 하나라도 깨졌거나 footer 를 읽을 수 없으면 1.
+int verify_segmented(const char *input_filename, int threads);
+
+#endif
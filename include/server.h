@@ -0,0 +1,35 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "compressor.h"
+
+// 상주 압축 server ('w'). 파일 하나마다 process 를 띄우면 시작, allocator 예열, dict_init 을
+// 매번 다시 하므로 한 process 가 작업을 계속 받아 pipeline 으로 처리한다.
+//   reader thread -> dedup worker (opts->threads 개) -> writer thread
+// 단계 사이의 queue 는 queue_depth 개 slot 으로 제한되며, slot 마다 입력 buffer 와
+// DdpContext (dictionary arena/index, id 배열, 출력 buffer) 를 작업 사이에 재사용한다.
+// 출력은 <output>.tmp 에 쓴 뒤 rename 하므로 읽는 쪽은 완성된 .ddp 만 본다.
+//
+// 작업 원본:
+//   watch_dir:   시작할 때 출력이 없거나 입력보다 오래된 파일, 이후 쓰기를 마쳤거나
+//                (IN_CLOSE_WRITE) 옮겨 온 (IN_MOVED_TO) 파일을 output_dir/<이름>.ddp 로
+//                압축한다. '.' 로 시작하는 이름은 무시한다
+//   socket_path: Unix stream socket. 한 줄이 작업 하나로 "<input>" 또는 "<input>\t<output>"
+//                이며 (output 이 없으면 output_dir/<이름>.ddp) 끝나면 "ok <output>" 또는
+//                "error <input>" 한 줄로 답한다. 답의 순서는 끝난 순서다
+// SIGINT/SIGTERM 을 받으면 새 작업을 그만 받고 pipeline 에 있는 작업을 마친 뒤 돌아온다.
+typedef struct {
+    const char *watch_dir;    // NULL 이면 감시하지 않는다
+    const char *socket_path;  // NULL 이면 socket 을 열지 않는다
+    const char *output_dir;
+    int queue_depth;          // 동시에 pipeline 에 있는 파일 수 (slot 수), 0 이면 2 * worker + 2
+} ServerOptions;
+
+// opts 는 모든 작업에 적용되며 stream, CDC, segment, -M 은 지원하지 않는다. opts->shared 가
+// 있으면 dictionary 를 작업마다 고쳤다 되돌리므로 dedup worker 는 하나이고 그 안에서 -j 를 쓴다.
+// 시작하지 못했거나 pipeline 이 멈추면 1. 실패한 작업은 종료할 때 요약에 개수로만 남기고
+// 받아 둔 작업을 끝까지 처리했으면 0.
+int run_server(const ServerOptions *server, int width_bytes, int block_size_samples,
+               const CompressOptions *opts);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SHARED_DICT_H
+#define SHARED_DICT_H
+
+#include "dictionary.h"
+#include <stdint.h>
+
+// 여러 입력 (장치) 이 함께 쓰는 외부 dictionary 파일 (.ddpd).
+// 포맷:
+//  magic: 'D','D','P','D'
+//  u8 : width_bytes, u8[3]: 0
+//  u32: block_size_samples
+//  u32: dict_size
+//  u32: checksum 하위 32 bit, u32: 상위 32 bit (dict_checksum)
+//  [blocks]: dict_size * (block_size_samples * width_bytes) bytes
+//  flags & SHARED_DICT_FLAG_INDEX 이면 이어서 (파일 offset 8 byte 정렬까지 0 으로 채운 뒤)
+//  u64: table_size, u64[dict_size]: block hash, u32[table_size]: open addressing index
+//  (Dictionary 의 hashes/table 과 같은 배치, little-endian)
+// .ddp 파일은 checksum 과 항목 수로 이 파일을 참조한다 (DDP_FLAG_SHARED).
+#define SHARED_DICT_FLAG_INDEX 0x01
+
+typedef struct {
+    Dictionary dict;        // 압축 중에는 base_size 뒤에 입력별 항목이 잠시 붙는다
+    int base_size;          // 공유 항목 수
+    int width_bytes;
+    int block_size_samples;
+    uint64_t checksum;
+    unsigned char *map;     // index 가 있는 파일을 mmap 해서 직접 쓸 때의 mapping (없으면 NULL)
+    size_t map_bytes;
+    int verified;           // block 의 checksum 을 확인했으면 1 (index 를 빌렸으면 load 직후 0)
+} SharedDict;
+
+// index section 이 있으면 파일을 mmap (MAP_PRIVATE) 해서 block 과 index 를 그대로 쓴다.
+// 이때는 header 만 확인하고 checksum 은 미룬다 (압축은 저장된 hash 와 memcmp 가 모두 맞아야
+// 항목을 쓰므로 손상된 block 은 걸리지 않는다). 쓸 수 없는 index 이거나 index 가 없으면 block 을 읽어 index 를 만든다.
+int shared_dict_load(const char *filename, SharedDict *sd);
+
+// 공유 block 의 checksum 을 확인한다 (이미 확인했으면 바로 0). 복원은 확인하지 않은
+// dictionary 를 거부하므로 복원 전에 한 번 부른다. 맞지 않으면 메시지를 출력하고 1.
+int shared_dict_verify(const char *filename, SharedDict *sd);
+
+void shared_dict_free(SharedDict *sd);
+
+// inputs 를 모두 읽어 min_files 개 이상의 파일에 나오는 block 으로 dictionary 를
+// 만들고 filename 에 기록한다 (입력이 하나면 그 파일의 모든 block).
+// with_index 면 index section 도 기록한다 (항목당 8 + 약 8~16 byte 추가).
+int shared_dict_build(const char *filename, const char *const *inputs, int num_inputs,
+                      int width_bytes, int block_size_samples, int min_files, int with_index);
+
+#endif
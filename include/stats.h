@@ -0,0 +1,55 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// 압축 hot path 계측. make STATS=1 (-DDDP_STATS) 로 빌드했을 때만 기록하며,
+// 아니면 아래 macro 가 모두 빈 문장이 되어 비용이 없다.
+
+enum {
+    STATS_READ,        // 입력 mmap/read
+    STATS_DEDUP,       // fingerprint + dictionary lookup/insert
+    STATS_DICT_WRITE,  // header + dictionary section
+    STATS_ID_WRITE,    // id section + tail + close
+    STATS_PHASES
+};
+
+typedef struct {
+    double phase_sec[STATS_PHASES];
+    uint64_t probes;           // dictionary lookup 횟수
+    uint64_t probe_slots;      // lookup 이 들여다본 index slot 수 (빈 slot 제외)
+    uint64_t hash_collisions;  // fingerprint 는 같지만 내용이 다른 항목을 만난 횟수
+    uint64_t inserts;          // dictionary 에 새로 넣거나 교체한 항목 수
+} DdpStats;
+
+#ifdef DDP_STATS
+
+extern DdpStats ddp_stats;
+
+double stats_now(void);
+
+void stats_reset(void);
+
+// 계측 값과 input/output 파일 크기, output header 의 block 정보를 format ("json" 또는
+// "csv") 으로 fp 에 쓴다. csv 는 header 행과 값 행 두 줄. 실패 시 1.
+int stats_write(FILE *fp, const char *format, const char *input_filename,
+                const char *output_filename);
+
+// lookup 은 -j 의 worker thread 에서도 불리므로 counter 는 atomic 으로 더한다
+#define STATS_COUNT(field, n) \
+    ((void)__atomic_fetch_add(&ddp_stats.field, (uint64_t)(n), __ATOMIC_RELAXED))
+#define STATS_TIMER(t) double t = stats_now()
+#define STATS_PHASE(phase, t) (ddp_stats.phase_sec[phase] += stats_now() - (t))
+#define STATS_RESET() stats_reset()
+
+#else
+
+#define STATS_COUNT(field, n) ((void)0)
+#define STATS_TIMER(t) ((void)0)
+#define STATS_PHASE(phase, t) ((void)0)
+#define STATS_RESET() ((void)0)
+
+#endif
+
+#endif
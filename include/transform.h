@@ -0,0 +1,36 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// dedup 전에 샘플열에 적용하는 가역 변환. header_extra[2] 에 기록된다.
+//  DELTA: x[i] - x[i-1] (width 폭 정수, wrap-around)
+//  XOR:   x[i] ^ x[i-1]
+// 첫 샘플은 0 과의 차이로 기록된다.
+enum {
+    DDP_TRANSFORM_NONE = 0,
+    DDP_TRANSFORM_DELTA = 1,
+    DDP_TRANSFORM_XOR = 2,
+    DDP_TRANSFORM_COUNT
+};
+
+// chunk 단위로 나눠 호출할 수 있도록 직전 원본 샘플을 들고 다닌다.
+typedef struct {
+    int kind;
+    int width;
+    uint64_t prev;
+} TransformState;
+
+void transform_init(TransformState *t, int kind, int width);
+
+// n 개 샘플을 변환해 out 에 쓴다. in == out 이어도 된다.
+void transform_encode(TransformState *t, const unsigned char *in, unsigned char *out, size_t n);
+
+// transform_encode 의 역변환 (in-place).
+void transform_decode(TransformState *t, unsigned char *data, size_t n);
+
+// "none", "delta", "xor" -> DDP_TRANSFORM_*, 모르는 이름이면 -1.
+int transform_parse(const char *name);
+
+#endif
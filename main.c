@@ -1,37 +1,457 @@
+#include "./include/batch.h"
+#include "./include/bench.h"
+#include "./include/block_size.h"
+#include "./include/channels.h"
 #include "./include/compressor.h"
+#include "./include/entropy.h"
+#include "./include/segments.h"
+#include "./include/server.h"
+#include "./include/stats.h"
+#include "./include/transform.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // 사용법:
-//   압축:   ./dedup_bin c <width_bytes:1|2|4|8> <block_size_samples> <input.bin> <output.ddp>
-//   복원:   ./dedup_bin d <input.ddp> <output.bin>
+//   압축:   ./dedup_bin c [options] <width_bytes:1|2|4|8> <block_size_samples> <input.bin> <output.ddp>
+//   복원:   ./dedup_bin d [options] <input.ddp> <output.bin>
+//   추가:   ./dedup_bin a [-j N] <input.bin> <existing.ddp>
+//   구간:   ./dedup_bin r <input.ddp> <start_sample> <count> <output.bin>
+//   사전:   ./dedup_bin t [-n N] [-i] <width_bytes> <block_size_samples> <dict.ddpd> <input.bin>...
+//   일괄:   ./dedup_bin m [options] <width_bytes> <block_size_samples> <input_dir> <output_dir>
+//   다채널: ./dedup_bin i [options] <widths:2,2,2,4> <block_size_samples> <input.bin> <output.ddp>
+//   검사:   ./dedup_bin v [-j N] <input.ddp>
+//   서버:   ./dedup_bin w [-L socket] [-q N] [options] <width_bytes> <block_size_samples> <watch_dir|-> <output_dir>
+//   측정:   ./dedup_bin b [-n N] [-w N] [-b LIST] [-o F] [options] <work_dir> <input.bin:width>...
+//
+// block_size_samples 를 0 으로 주면 입력 앞부분에서 후보 (2..32) 별 출력 크기를
+// 추정해 가장 작은 것을 고른다.
+//
+// 압축 옵션:
+//   -s      streaming 모드 (입력을 chunk 단위로 읽음, 메모리 사용량이 입력 크기와 무관)
+//   -j N    N 개 thread 로 block fingerprint 계산 (출력은 -j 1 과 동일)
+//   -p      block id 를 bit-packing 한 DDP2 포맷으로 기록
+//   -r      연속된 같은 block id 를 run-length 로 기록
+//   -F      dedup 뒤 dictionary 항목을 많이 쓰인 순서로 다시 번호 매김. 자주 쓰는 block 이 앞에
+//           모여 복원할 때 cache 에 남고 흔한 id 가 작아져 -e rans 의 id section 이 준다.
+//           포맷과 복원기는 그대로이며 -s, -c 와 함께 쓸 수 없다
+//   -t T    dedup 전에 샘플열을 변환 (none|delta|xor). 천천히 변하는 센서 값에 유리.
+//           변환된 파일은 구간 복원('r')과 추가('a')를 지원하지 않는다
+//   -e C    dictionary 와 block id section 을 entropy coding (none|rans).
+//           구간 복원('r')을 지원하지 않으며 stream 모드와 함께 쓸 수 없다
+//   -c      content-defined chunking: rolling hash 로 경계를 골라 샘플 삽입/누락에도
+//           match 가 유지된다. block_size_samples 는 평균 chunk 길이. 'r', 'a', -s 미지원
+//   -D F    공유 dictionary F (.ddpd) 에 없는 block 만 기록. 복원할 때도 -D F 가 필요하다
+//   -E N    손실 압축: 같은 block 이 없으면 모든 샘플 (unsigned) 의 차이가 N 이하인 항목을
+//           LSH bucket 에서 찾아 그 id 를 쓴다. 복원 값은 샘플마다 원본과 N 이내이며 복원기는
+//           그대로다. 단일 thread 로 dedup 하며 -c, -M, -t 와 함께 쓸 수 없다
+//   --stats F  ('c' 만) 단계별 시간 (read, dedup, dictionary 기록, id 기록), dictionary lookup/slot/
+//           hash 충돌/삽입 수, 입출력 바이트와 압축률을 F (json|csv) 로 stdout 에 출력.
+//           make STATS=1 로 빌드해야 하며, 아니면 계측 코드가 컴파일되지 않는다
+//   -S N    N block 마다 자기 dictionary 를 가진 독립 segment 로 나누고 segment 마다 CRC-32C 를,
+//           끝에 footer index 를 기록 (DDPS). dedup 은 segment 안에서만 되지만 'v' 로 병렬 검사,
+//           'd -j' 로 segment 병렬 복원, 'r' 은 필요한 segment 만 복원하며, 쓰다 끊겨도 앞쪽
+//           segment 는 살아남는다. -j 는 segment 를 병렬로 압축한다. -s, -c 와 함께 쓸 수 없고
+//           'a', 'b', --stats 도 DDPS 파일에는 쓸 수 없다
+//   -M N    stream 모드 (-s) dictionary 를 N MiB (K/M/G 접미사 가능) 로 제한. 가득 차면 CLOCK 으로 오래 안 쓴
+//           항목을 새 block 으로 덮어쓰며, 복원기도 같은 상태를 따라가 같은 메모리만 쓴다
+//
+// 복원 옵션:
+//   -j N    N 개 thread 가 mmap 한 출력 파일을 나눠서 채움
+//   -D F    압축할 때 쓴 공유 dictionary
+//
+// 사전 ('t') 은 여러 장치의 입력에서 N 개 (기본 2) 이상의 파일에 나오는 block 으로 공유
+// dictionary 를 만든다. -i 면 hash index 도 파일에 넣어, 여는 쪽이 index 를 다시 만들지 않고
+// mmap 한 그대로 쓴다 (항목 수와 무관하게 바로 열림). 일괄 ('m') 은 input_dir 의 파일을 한 process 에서 모두 압축하며
+// 압축 옵션 (-D 포함) 을 그대로 받는다. 공유 dictionary 는 한 번만 읽고 index 한다.
+//
+// 다채널 ('i') 은 record 마다 channel 값이 interleave 된 입력 (예: T,RH,lux,P 를 2,2,2,4 바이트씩)
+// 을 한 번 mmap 하고 channel 마다 thread 하나가 자기 열을 따로 dedup 해 DDPC container 하나에 쓴다.
+// 미리 channel 별 파일로 나눌 필요가 없다. 복원은 'd' 가 그대로 하며 원래 interleave 로 되돌린다.
+// -s, -c, -D, -M 은 지원하지 않고 'r', 'a', --stats 도 DDPC 파일에는 쓸 수 없다.
+//
+// 추가 ('a') 는 기존 dictionary 에 대조해 새 입력만 dedup 하고 파일 끝에 segment 로
+// 덧붙인다. width/block 크기는 기존 header 를 따르며 stream 포맷 파일은 지원하지 않는다.
+//
+// 측정 ('b') 은 입력 x block 크기 (기본 2,4,...,32) 마다 압축과 복원을 이 process 안에서
+// -w 번 (기본 1) 예열한 뒤 -n 번 (기본 10) 반복해 중앙값을 -o F (기본 stdout) 에 CSV 로 쓴다.
+// 열은 scripts/*_bench.sh 와 같은 mode,sensor,block_size,elapsed_sec,max_rss_kb 에
+// mb_per_sec,ns_per_block,dict_hit_rate 가 붙는다. sudo 나 cache drop 없이 warm cache 기준이며
+// 중간 파일은 work_dir 에 남는다. 압축 옵션은 복원에도 -j, -D 로 그대로 쓴다.
+//
+// 검사 ('v') 는 -S 로 만든 파일의 segment checksum 을 -j 개 thread 로 확인하고 깨진 segment
+// 번호를 출력한다. footer index 가 없으면 (쓰다 끊긴 파일) 앞에서부터 온전한 segment 를 세고
+// 실패로 끝나며, 'd' 는 이때 그 segment 들만 복원한 뒤 실패를 돌려준다.
+//
+// 서버 ('w') 는 종료 신호 (SIGINT/SIGTERM) 까지 떠 있으면서 watch_dir 에 다 쓰였거나 옮겨 온
+// 파일과 -L 의 Unix socket 으로 받은 경로 ("<input>" 또는 "<input>\t<output>" 한 줄, 답은
+// "ok <output>" / "error <input>") 를 압축한다. reader -> -j 개 dedup worker -> writer 로 이어진
+// pipeline 에 -q 개 (기본 2 * worker + 2) 파일까지 동시에 두고, 입력 buffer 와 dictionary 는
+// 작업 사이에 재사용한다. watch_dir 를 - 로 주면 socket 만 쓴다. -s, -c, -S, -M 은 지원하지 않는다.
+//
+// 구간 복원 ('r') 은 [start_sample, start_sample + count) 를 덮는 block 만 읽는다.
+// stream 포맷 (-s) 파일은 block 위치를 계산할 수 없어 지원하지 않는다.
+
+static void print_compress_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s c [-s] [-j N] [-p] [-r] [-F] [-t T] [-e C] [-c] [-D F] [-E N] [-S N] [-M N] [--stats F] <width_bytes> <block_size_samples> <input.bin> <output.ddp>\n"
+            "  -s    stream input in fixed-size chunks (bounded memory)\n"
+            "  -j N  fingerprint blocks with N threads\n"
+            "  -p    bit-pack block ids (DDP2 format)\n"
+            "  -r    run-length encode repeated block ids\n"
+            "  -F    renumber dictionary blocks by use count (hot blocks first, smaller ids)\n"
+            "  -t T  transform samples before dedup: none, delta or xor\n"
+            "  -e C  entropy-code dictionary and id sections: none or rans\n"
+            "  -c    content-defined chunking (block_size_samples is the average chunk size)\n"
+            "  -D F  reference the shared dictionary F and store only new blocks\n"
+            "  -E N  lossy: reuse a dictionary block whose samples all differ by at most N\n"
+            "  -S N  write independent CRC-32C checked segments of N blocks with a footer index\n"
+            "  -M N  cap the stream-mode dictionary at N MiB, or 512K/2G (CLOCK eviction)\n"
+            "  --stats F  print phase timings and dictionary counters as json or csv (STATS=1 builds)\n"
+            "  block_size_samples 0 picks the block size automatically\n",
+            prog);
+}
+
+static void print_decompress_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s d [-j N] [-D F] <input.ddp> <output.bin>\n"
+            "  -j N  fill the output with N threads\n"
+            "  -D F  shared dictionary the file was compressed with\n",
+            prog);
+}
+
+static void print_append_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s a [-j N] <input.bin> <existing.ddp>\n"
+            "  -j N  fingerprint blocks with N threads\n",
+            prog);
+}
+
+static void print_train_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s t [-n N] [-i] <width_bytes> <block_size_samples> <dict.ddpd> <input.bin>...\n"
+            "  -n N  keep blocks that occur in at least N inputs (default 2)\n"
+            "  -i    store the hash index so loading maps it instead of rebuilding\n",
+            prog);
+}
+
+static void print_batch_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s m [compress options] <width_bytes> <block_size_samples> <input_dir> <output_dir>\n",
+            prog);
+}
+
+static void print_channels_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s i [compress options] <widths> <block_size_samples> <input.bin> <output.ddp>\n"
+            "  widths  comma-separated channel widths of one interleaved record, e.g. 2,2,2,4\n",
+            prog);
+}
+
+static void print_bench_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s b [-n N] [-w N] [-b LIST] [-o F] [compress options] <work_dir> <input.bin:width>...\n"
+            "  -n N     measured repetitions per run (default 10, median is reported)\n"
+            "  -w N     warm-up repetitions that are discarded (default 1)\n"
+            "  -b LIST  comma-separated block sizes (default 2,4,...,32)\n"
+            "  -o F     write the CSV to F instead of stdout\n",
+            prog);
+}
+
+static void print_verify_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s v [-j N] <input.ddp>\n"
+            "  -j N  check segment checksums with N threads (files written with -S)\n",
+            prog);
+}
+
+static void print_server_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s w [-L socket] [-q N] [compress options] <width_bytes> <block_size_samples> <watch_dir|-> <output_dir>\n"
+            "  -L F  also accept input paths, one per line, on the Unix socket F\n"
+            "  -q N  files in flight across the read/dedup/write stages (default 2 * workers + 2)\n"
+            "  -j N  number of dedup workers\n"
+            "  watch_dir - disables directory watching\n",
+            prog);
+}
+
+static void print_range_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s r <input.ddp> <start_sample> <count> <output.bin>\n",
+            prog);
+}
+
+// 음수나 숫자가 아닌 문자가 섞인 값은 거부한다. 실패 시 1.
+static int parse_sample_index(const char *s, size_t *out)
+{
+    char *end = NULL;
+    if (s[0] < '0' || s[0] > '9') {
+        return 1;
+    }
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end != '\0') {
+        return 1;
+    }
+    *out = (size_t)v;
+    return 0;
+}
+
+// "N", "NK", "NM", "NG" (단위 없으면 MiB) 를 바이트로. 0 이나 잘못된 값이면 1.
+static int parse_mem_size(const char *s, size_t *out)
+{
+    char *end = NULL;
+    if (s[0] < '0' || s[0] > '9') {
+        return 1;
+    }
+    unsigned long long v = strtoull(s, &end, 10);
+    int shift = 20;
+    if (*end == 'K' || *end == 'k') shift = 10, ++end;
+    else if (*end == 'M' || *end == 'm') shift = 20, ++end;
+    else if (*end == 'G' || *end == 'g') shift = 30, ++end;
+    if (*end != '\0' || v == 0 || v > (SIZE_MAX >> shift)) {
+        return 1;
+    }
+    *out = (size_t)v << shift;
+    return 0;
+}
+
+// "2,4,8" 형태의 block 크기 목록. 0 (auto) 은 허용. 실패 시 1.
+static int parse_block_list(const char *s, int *out, size_t cap, size_t *count_out)
+{
+    size_t count = 0;
+    while (*s != '\0') {
+        char *end = NULL;
+        if (*s < '0' || *s > '9' || count == cap) {
+            return 1;
+        }
+        long v = strtol(s, &end, 10);
+        if (v > INT32_MAX || (*end != ',' && *end != '\0')) {
+            return 1;
+        }
+        out[count++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    *count_out = count;
+    return count == 0;
+}
+
+static int parse_thread_count(int argc, char *argv[], int *argi, int *threads_out)
+{
+    if (*argi + 1 >= argc) {
+        fprintf(stderr, "Option -j requires a thread count\n");
+        return 1;
+    }
+    *threads_out = atoi(argv[++*argi]);
+    if (*threads_out <= 0) {
+        fprintf(stderr, "Invalid thread count '%s'\n", argv[*argi]);
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_shared_path(int argc, char *argv[], int *argi, const char **path_out)
+{
+    if (*argi + 1 >= argc) {
+        fprintf(stderr, "Option -D requires a dictionary file\n");
+        return 1;
+    }
+    *path_out = argv[++*argi];
+    return 0;
+}
+
+// argv[*argi] 부터 '-' 로 시작하는 압축 옵션을 읽는다. -D 의 파일 이름은 shared_path 로,
+// --stats 형식은 stats_format 으로 (NULL 이면 --stats 를 받지 않는다). 실패 시 1.
+static int parse_compress_options(int argc, char *argv[], int *argi,
+                                  CompressOptions *opts, const char **shared_path,
+                                  const char **stats_format)
+{
+    while (*argi < argc && argv[*argi][0] == '-' && argv[*argi][1] != '\0') {
+        const char *opt = argv[*argi];
+        if (strcmp(opt, "-s") == 0) {
+            opts->stream = 1;
+        } else if (strcmp(opt, "-j") == 0) {
+            if (parse_thread_count(argc, argv, argi, &opts->threads) != 0) {
+                return 1;
+            }
+        } else if (strcmp(opt, "-p") == 0) {
+            opts->packed_ids = 1;
+        } else if (strcmp(opt, "-r") == 0) {
+            opts->rle_ids = 1;
+        } else if (strcmp(opt, "-F") == 0) {
+            opts->freq_order = 1;
+        } else if (strcmp(opt, "-t") == 0) {
+            if (*argi + 1 >= argc) {
+                fprintf(stderr, "Option -t requires a transform name\n");
+                return 1;
+            }
+            opts->transform = transform_parse(argv[++*argi]);
+            if (opts->transform < 0) {
+                fprintf(stderr, "Unknown transform '%s'\n", argv[*argi]);
+                return 1;
+            }
+        } else if (strcmp(opt, "-c") == 0) {
+            opts->cdc = 1;
+        } else if (strcmp(opt, "-D") == 0) {
+            if (parse_shared_path(argc, argv, argi, shared_path) != 0) {
+                return 1;
+            }
+        } else if (strcmp(opt, "-E") == 0) {
+            size_t epsilon = 0;
+            if (*argi + 1 >= argc || parse_sample_index(argv[++*argi], &epsilon) != 0) {
+                fprintf(stderr, "Option -E requires a per-sample tolerance (non-negative integer)\n");
+                return 1;
+            }
+            opts->epsilon = (uint64_t)epsilon;
+        } else if (strcmp(opt, "-S") == 0) {
+            size_t blocks = 0;
+            if (*argi + 1 >= argc || parse_sample_index(argv[++*argi], &blocks) != 0 ||
+                blocks == 0 || blocks > UINT32_MAX) {
+                fprintf(stderr, "Option -S requires a positive number of blocks per segment\n");
+                return 1;
+            }
+            opts->segment_blocks = (uint32_t)blocks;
+        } else if (strcmp(opt, "-M") == 0) {
+            if (*argi + 1 >= argc || parse_mem_size(argv[++*argi], &opts->dict_limit_bytes) != 0) {
+                fprintf(stderr, "Option -M requires a size such as 64, 512K or 2G (default unit MiB)\n");
+                return 1;
+            }
+        } else if (stats_format && strcmp(opt, "--stats") == 0) {
+            if (*argi + 1 >= argc ||
+                (strcmp(argv[*argi + 1], "json") != 0 && strcmp(argv[*argi + 1], "csv") != 0)) {
+                fprintf(stderr, "Option --stats requires a format: json or csv\n");
+                return 1;
+            }
+            *stats_format = argv[++*argi];
+        } else if (strcmp(opt, "-e") == 0) {
+            if (*argi + 1 >= argc) {
+                fprintf(stderr, "Option -e requires a codec name\n");
+                return 1;
+            }
+            opts->codec = codec_parse(argv[++*argi]);
+            if (opts->codec < 0) {
+                fprintf(stderr, "Unknown codec '%s'\n", argv[*argi]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", opt);
+            return 1;
+        }
+        ++*argi;
+    }
+    return 0;
+}
+
+static int parse_decompress_options(int argc, char *argv[], int *argi,
+                                    DecompressOptions *opts, const char **shared_path)
+{
+    while (*argi < argc && argv[*argi][0] == '-' && argv[*argi][1] != '\0') {
+        const char *opt = argv[*argi];
+        if (strcmp(opt, "-j") == 0) {
+            if (parse_thread_count(argc, argv, argi, &opts->threads) != 0) {
+                return 1;
+            }
+        } else if (strcmp(opt, "-D") == 0) {
+            if (parse_shared_path(argc, argv, argi, shared_path) != 0) {
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", opt);
+            return 1;
+        }
+        ++*argi;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 2) {
         fprintf(stderr,
                 "Usage:\n"
-                "  Compress:   %s c <width_bytes> <block_size_samples> <input.bin> <output.ddp>\n"
-                "  Decompress: %s d <input.ddp> <output.bin>\n",
-                argv[0], argv[0]);
+                "  Compress:   %s c [options] <width_bytes> <block_size_samples> <input.bin> <output.ddp>\n"
+                "  Decompress: %s d [options] <input.ddp> <output.bin>\n"
+                "  Append:     %s a [options] <input.bin> <existing.ddp>\n"
+                "  Range:      %s r <input.ddp> <start_sample> <count> <output.bin>\n"
+                "  Verify:     %s v [-j N] <input.ddp>\n"
+                "  Train:      %s t [-n N] [-i] <width_bytes> <block_size_samples> <dict.ddpd> <input.bin>...\n"
+                "  Batch:      %s m [options] <width_bytes> <block_size_samples> <input_dir> <output_dir>\n"
+                "  Channels:   %s i [options] <widths> <block_size_samples> <input.bin> <output.ddp>\n"
+                "  Bench:      %s b [-n N] [-w N] [-b LIST] [-o F] [options] <work_dir> <input.bin:width>...\n"
+                "  Server:     %s w [-L socket] [-q N] [options] <width_bytes> <block_size_samples> <watch_dir|-> <output_dir>\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
 
     char mode = argv[1][0];
 
-    if (mode == 'c') {
-        if (argc != 6) {
-            fprintf(stderr,
-                    "Usage: %s c <width_bytes> <block_size_samples> <input.bin> <output.ddp>\n",
-                    argv[0]);
+    if (mode == 'c' || mode == 'm' || mode == 'i') {
+        CompressOptions opts;
+        compress_options_init(&opts);
+        const char *shared_path = NULL;
+        const char *stats_format = NULL;
+        int argi = 2;
+        if (parse_compress_options(argc, argv, &argi, &opts, &shared_path,
+                                   mode == 'c' ? &stats_format : NULL) != 0 ||
+            argc - argi != 4) {
+            if (mode == 'c') print_compress_usage(argv[0]);
+            else if (mode == 'm') print_batch_usage(argv[0]);
+            else print_channels_usage(argv[0]);
+            return 1;
+        }
+        ChannelLayout layout;
+        if (mode == 'i' && channel_layout_parse(argv[argi], &layout) != 0) {
+            return 1;
+        }
+        int width_bytes = atoi(argv[argi]);
+        int block_size_samples = atoi(argv[argi + 1]);
+#ifndef DDP_STATS
+        if (stats_format) {
+            fprintf(stderr, "--stats needs a build with instrumentation (make clean && make STATS=1)\n");
+            return 1;
+        }
+#endif
+        if (stats_format && opts.segment_blocks > 0) {
+            fprintf(stderr, "--stats is not supported for segmented (-S) files\n");
             return 1;
         }
-        int width_bytes = atoi(argv[2]);
-        int block_size_samples = atoi(argv[3]);
-        const char *input_bin = argv[4];
-        const char *output_ddp = argv[5];
 
-        int ret = compress_file(input_bin, output_ddp,
-                                width_bytes, block_size_samples);
+        SharedDict shared;
+        if (shared_path) {
+            if (shared_dict_load(shared_path, &shared) != 0) {
+                return 1;
+            }
+            opts.shared = &shared;
+        }
+        int ret;
+        if (mode == 'i') {
+            ret = compress_channels(argv[argi + 2], argv[argi + 3],
+                                    &layout, block_size_samples, &opts);
+        } else if (mode == 'm') {
+            ret = compress_directory(argv[argi + 2], argv[argi + 3],
+                                     width_bytes, block_size_samples, &opts);
+        } else {
+            ret = compress_file_opts(argv[argi + 2], argv[argi + 3],
+                                     width_bytes, block_size_samples, &opts);
+#ifdef DDP_STATS
+            if (ret == 0 && stats_format) {
+                ret = stats_write(stdout, stats_format, argv[argi + 2], argv[argi + 3]);
+            }
+#endif
+        }
+        if (shared_path) {
+            shared_dict_free(&shared);
+        }
         if (ret == 0) {
             printf("Compression succeeded.\n");
         } else {
@@ -40,16 +460,33 @@ int main(int argc, char *argv[])
         return ret;
 
     } else if (mode == 'd') {
-        if (argc != 4) {
-            fprintf(stderr,
-                    "Usage: %s d <input.ddp> <output.bin>\n",
-                    argv[0]);
+        DecompressOptions opts;
+        decompress_options_init(&opts);
+        const char *shared_path = NULL;
+        int argi = 2;
+        if (parse_decompress_options(argc, argv, &argi, &opts, &shared_path) != 0 ||
+            argc - argi != 2) {
+            print_decompress_usage(argv[0]);
             return 1;
         }
-        const char *input_ddp = argv[2];
-        const char *output_bin = argv[3];
+        const char *input_ddp = argv[argi];
+        const char *output_bin = argv[argi + 1];
 
-        int ret = decompress_file(input_ddp, output_bin);
+        SharedDict shared;
+        if (shared_path) {
+            if (shared_dict_load(shared_path, &shared) != 0) {
+                return 1;
+            }
+            if (shared_dict_verify(shared_path, &shared) != 0) {
+                shared_dict_free(&shared);
+                return 1;
+            }
+            opts.shared = &shared;
+        }
+        int ret = decompress_file_opts(input_ddp, output_bin, &opts);
+        if (shared_path) {
+            shared_dict_free(&shared);
+        }
         if (ret == 0) {
             printf("Decompression succeeded.\n");
         } else {
@@ -57,9 +494,266 @@ int main(int argc, char *argv[])
         }
         return ret;
 
+    } else if (mode == 'a') {
+        int threads = 1;
+        int argi = 2;
+        while (argi < argc && strcmp(argv[argi], "-j") == 0) {
+            if (parse_thread_count(argc, argv, &argi, &threads) != 0) {
+                print_append_usage(argv[0]);
+                return 1;
+            }
+            ++argi;
+        }
+        if (argc - argi != 2) {
+            print_append_usage(argv[0]);
+            return 1;
+        }
+
+        int ret = append_file(argv[argi], argv[argi + 1], threads);
+        if (ret == 0) {
+            printf("Append succeeded.\n");
+        } else {
+            printf("Append failed.\n");
+        }
+        return ret;
+
+    } else if (mode == 'r') {
+        size_t start_sample = 0;
+        size_t count = 0;
+        if (argc != 6) {
+            print_range_usage(argv[0]);
+            return 1;
+        }
+        if (parse_sample_index(argv[3], &start_sample) != 0 ||
+            parse_sample_index(argv[4], &count) != 0) {
+            fprintf(stderr, "Invalid sample range '%s' '%s'\n", argv[3], argv[4]);
+            return 1;
+        }
+
+        int ret = decompress_range(argv[2], start_sample, count, argv[5]);
+        if (ret == 0) {
+            printf("Range decompression succeeded.\n");
+        } else {
+            printf("Range decompression failed.\n");
+        }
+        return ret;
+
+    } else if (mode == 'v') {
+        int threads = 1;
+        int argi = 2;
+        while (argi < argc && strcmp(argv[argi], "-j") == 0) {
+            if (parse_thread_count(argc, argv, &argi, &threads) != 0) {
+                print_verify_usage(argv[0]);
+                return 1;
+            }
+            ++argi;
+        }
+        if (argc - argi != 1) {
+            print_verify_usage(argv[0]);
+            return 1;
+        }
+        int ret = verify_segmented(argv[argi], threads);
+        if (ret == 0) {
+            printf("Verification succeeded.\n");
+        } else {
+            printf("Verification failed.\n");
+        }
+        return ret;
+
+    } else if (mode == 'w') {
+        ServerOptions server;
+        memset(&server, 0, sizeof(server));
+        int argi = 2;
+        while (argi + 1 < argc) {
+            const char *opt = argv[argi];
+            if (strcmp(opt, "-L") == 0) {
+                server.socket_path = argv[argi + 1];
+            } else if (strcmp(opt, "-q") == 0) {
+                server.queue_depth = atoi(argv[argi + 1]);
+                if (server.queue_depth <= 0) {
+                    fprintf(stderr, "Invalid queue depth '%s'\n", argv[argi + 1]);
+                    return 1;
+                }
+            } else {
+                break;
+            }
+            argi += 2;
+        }
+        CompressOptions opts;
+        compress_options_init(&opts);
+        const char *shared_path = NULL;
+        if (parse_compress_options(argc, argv, &argi, &opts, &shared_path, NULL) != 0 ||
+            argc - argi != 4) {
+            print_server_usage(argv[0]);
+            return 1;
+        }
+        int width_bytes = atoi(argv[argi]);
+        int block_size_samples = atoi(argv[argi + 1]);
+        server.watch_dir = strcmp(argv[argi + 2], "-") == 0 ? NULL : argv[argi + 2];
+        server.output_dir = argv[argi + 3];
+
+        SharedDict shared;
+        if (shared_path) {
+            if (shared_dict_load(shared_path, &shared) != 0) {
+                return 1;
+            }
+            opts.shared = &shared;
+        }
+        int ret = run_server(&server, width_bytes, block_size_samples, &opts);
+        if (shared_path) {
+            shared_dict_free(&shared);
+        }
+        if (ret == 0) {
+            printf("Server stopped.\n");
+        } else {
+            printf("Server failed.\n");
+        }
+        return ret;
+
+    } else if (mode == 'b') {
+        int block_sizes[64];
+        size_t num_block_sizes = 0;
+        for (int b = AUTO_BLOCK_MIN; b <= AUTO_BLOCK_MAX; b += AUTO_BLOCK_STEP) {
+            block_sizes[num_block_sizes++] = b;
+        }
+        BenchOptions bench;
+        bench.warmup = 1;
+        bench.repeats = 10;
+        const char *csv_path = NULL;
+        int argi = 2;
+        while (argi + 1 < argc) {
+            const char *opt = argv[argi];
+            if (strcmp(opt, "-n") == 0) {
+                bench.repeats = atoi(argv[argi + 1]);
+            } else if (strcmp(opt, "-w") == 0) {
+                bench.warmup = atoi(argv[argi + 1]);
+            } else if (strcmp(opt, "-o") == 0) {
+                csv_path = argv[argi + 1];
+            } else if (strcmp(opt, "-b") == 0) {
+                if (parse_block_list(argv[argi + 1], block_sizes, 64, &num_block_sizes) != 0) {
+                    fprintf(stderr, "Invalid block size list '%s'\n", argv[argi + 1]);
+                    return 1;
+                }
+            } else {
+                break;
+            }
+            argi += 2;
+        }
+        if (bench.repeats <= 0 || bench.warmup < 0) {
+            print_bench_usage(argv[0]);
+            return 1;
+        }
+
+        CompressOptions copts;
+        compress_options_init(&copts);
+        const char *shared_path = NULL;
+        if (parse_compress_options(argc, argv, &argi, &copts, &shared_path, NULL) != 0 ||
+            argc - argi < 2) {
+            print_bench_usage(argv[0]);
+            return 1;
+        }
+        const char *work_dir = argv[argi++];
+
+        size_t num_inputs = (size_t)(argc - argi);
+        BenchInput *inputs = (BenchInput *)malloc(num_inputs * sizeof(BenchInput));
+        if (!inputs) {
+            fprintf(stderr, "Failed to allocate bench inputs\n");
+            return 1;
+        }
+        for (size_t i = 0; i < num_inputs; ++i) {
+            char *colon = strrchr(argv[argi + (int)i], ':');
+            int width = colon ? atoi(colon + 1) : 0;
+            if (!(width == 1 || width == 2 || width == 4 || width == 8)) {
+                fprintf(stderr, "Bench input '%s' needs a :width suffix of 1, 2, 4 or 8\n",
+                        argv[argi + (int)i]);
+                free(inputs);
+                return 1;
+            }
+            *colon = '\0';
+            inputs[i].path = argv[argi + (int)i];
+            inputs[i].width_bytes = width;
+        }
+
+        DecompressOptions dopts;
+        decompress_options_init(&dopts);
+        dopts.threads = copts.threads;
+        SharedDict shared;
+        if (shared_path) {
+            if (shared_dict_load(shared_path, &shared) != 0) {
+                free(inputs);
+                return 1;
+            }
+            if (shared_dict_verify(shared_path, &shared) != 0) {
+                shared_dict_free(&shared);
+                free(inputs);
+                return 1;
+            }
+            copts.shared = &shared;
+            dopts.shared = &shared;
+        }
+        FILE *csv = stdout;
+        if (csv_path && (csv = fopen(csv_path, "w")) == NULL) {
+            perror("fopen csv");
+            csv = NULL;
+        }
+
+        int ret = 1;
+        if (csv) {
+            bench.block_sizes = block_sizes;
+            bench.num_block_sizes = num_block_sizes;
+            bench.compress = &copts;
+            bench.decompress = &dopts;
+            bench.csv = csv;
+            ret = run_bench(work_dir, inputs, num_inputs, &bench);
+            if (csv != stdout && fclose(csv) != 0) {
+                ret = 1;
+            }
+        }
+        if (shared_path) {
+            shared_dict_free(&shared);
+        }
+        free(inputs);
+        if (ret != 0) {
+            fprintf(stderr, "Benchmark failed.\n");
+        }
+        return ret;
+
+    } else if (mode == 't') {
+        int min_files = 2;
+        int with_index = 0;
+        int argi = 2;
+        while (argi < argc && argv[argi][0] == '-') {
+            if (strcmp(argv[argi], "-i") == 0) {
+                with_index = 1;
+                ++argi;
+            } else if (strcmp(argv[argi], "-n") == 0 && argi + 1 < argc &&
+                       (min_files = atoi(argv[argi + 1])) > 0) {
+                argi += 2;
+            } else {
+                print_train_usage(argv[0]);
+                return 1;
+            }
+        }
+        if (argc - argi < 4) {
+            print_train_usage(argv[0]);
+            return 1;
+        }
+        int ret = shared_dict_build(argv[argi + 2], (const char *const *)(argv + argi + 3),
+                                    argc - argi - 3, atoi(argv[argi]), atoi(argv[argi + 1]),
+                                    min_files, with_index);
+        if (ret == 0) {
+            printf("Shared dictionary build succeeded.\n");
+        } else {
+            printf("Shared dictionary build failed.\n");
+        }
+        return ret;
+
     } else {
         fprintf(stderr,
-                "Unknown mode '%c'. Use 'c' (compress) or 'd' (decompress).\n",
+                "Unknown mode '%c'. Use 'c' (compress), 'd' (decompress), 'a' (append), 'r' (range),\n"
+                "'t' (train a shared dictionary), 'm' (batch compress a directory),\n"
+                "'i' (compress interleaved channels), 'v' (verify segments), 'w' (serve a directory\n"
+                "or socket) or 'b' (benchmark).\n",
                 mode);
         return 1;
     }
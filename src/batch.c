@@ -0,0 +1,121 @@
+#define _DEFAULT_SOURCE
+#include "../include/batch.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static char *join_path(const char *dir, const char *name, const char *suffix)
+{
+    size_t n = strlen(dir) + strlen(name) + strlen(suffix) + 2;
+    char *path = (char *)malloc(n);
+    if (path)
+        snprintf(path, n, "%s/%s%s", dir, name, suffix);
+    return path;
+}
+
+int batch_list_files(const char *dir_name, char ***names_out, size_t *count_out)
+{
+    DIR *dir = opendir(dir_name);
+    if (!dir)
+    {
+        perror("opendir");
+        return 1;
+    }
+    char **names = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL)
+    {
+        if (e->d_name[0] == '.')
+            continue;
+        char *path = join_path(dir_name, e->d_name, "");
+        struct stat st;
+        int regular = path && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+        free(path);
+        if (!regular)
+            continue;
+        if (count == cap)
+        {
+            size_t new_cap = cap ? cap * 2 : 64;
+            char **grown = (char **)realloc(names, sizeof(char *) * new_cap);
+            if (!grown)
+                break;
+            names = grown;
+            cap = new_cap;
+        }
+        names[count] = strdup(e->d_name);
+        if (!names[count])
+            break;
+        ++count;
+    }
+    int failed = e != NULL;
+    closedir(dir);
+    if (failed)
+    {
+        fprintf(stderr, "Failed to allocate file list\n");
+        for (size_t i = 0; i < count; ++i)
+            free(names[i]);
+        free(names);
+        return 1;
+    }
+    if (count > 1)
+        qsort(names, count, sizeof(char *), compare_names);
+    *names_out = names;
+    *count_out = count;
+    return 0;
+}
+
+char *batch_output_path(const char *output_dir, const char *name)
+{
+    size_t len = strlen(name);
+    if (len > 4 && strcmp(name + len - 4, ".bin") == 0)
+        len -= 4;
+    size_t n = strlen(output_dir) + len + sizeof("/.ddp");
+    char *path = (char *)malloc(n);
+    if (path)
+        snprintf(path, n, "%s/%.*s.ddp", output_dir, (int)len, name);
+    return path;
+}
+
+int compress_directory(const char *input_dir, const char *output_dir,
+                       int width_bytes, int block_size_samples,
+                       const CompressOptions *opts)
+{
+    char **names = NULL;
+    size_t count = 0;
+    if (batch_list_files(input_dir, &names, &count) != 0)
+        return 1;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        char *input = join_path(input_dir, names[i], "");
+        char *output = batch_output_path(output_dir, names[i]);
+        if (!input || !output)
+        {
+            fprintf(stderr, "Failed to allocate path\n");
+            ++failed;
+        }
+        else
+        {
+            fprintf(stderr, "[%zu/%zu] %s\n", i + 1, count, input);
+            if (compress_file_opts(input, output, width_bytes, block_size_samples, opts) != 0)
+                ++failed;
+        }
+        free(input);
+        free(output);
+        free(names[i]);
+    }
+    free(names);
+
+    fprintf(stderr, "Batch: %zu files, %zu failed\n", count, failed);
+    return failed > 0 || count == 0;
+}
@@ -0,0 +1,242 @@
+#define _DEFAULT_SOURCE
+#include "../include/bench.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+enum
+{
+    BENCH_ENC,
+    BENCH_DEC
+};
+
+// child 가 pipe 로 돌려주는 측정 결과
+typedef struct
+{
+    int ok;
+    double elapsed_sec;
+} BenchResult;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// "T_raw.bin" -> "T", "seven_day_T.bin" -> "seven_day_T"
+static void sensor_name(const char *path, char *out, size_t cap)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t n = strlen(base);
+    const char *dot = strrchr(base, '.');
+    if (n > 8 && strcmp(base + n - 8, "_raw.bin") == 0)
+        n -= 8;
+    else if (dot && dot != base)
+        n = (size_t)(dot - base);
+    if (n >= cap)
+        n = cap - 1;
+    memcpy(out, base, n);
+    out[n] = '\0';
+}
+
+static int run_once(int mode, const char *input, const char *ddp, const char *bin,
+                    int width_bytes, int block_size, const BenchOptions *opts)
+{
+    if (mode == BENCH_ENC)
+        return compress_file_opts(input, ddp, width_bytes, block_size, opts->compress);
+    return decompress_file_opts(ddp, bin, opts->decompress);
+}
+
+// child 본체: warmup + repeats 번 실행하고 중앙값을 fd 로 보낸다.
+// 첫 실행의 메시지만 남기고 이후 실행의 stderr 는 버린다.
+static void bench_child(int fd, int mode, const char *input, const char *ddp, const char *bin,
+                        int width_bytes, int block_size, const BenchOptions *opts)
+{
+    BenchResult res = { 0, 0.0 };
+    double *times = (double *)malloc((size_t)opts->repeats * sizeof(double));
+    int total = opts->warmup + opts->repeats;
+    int i = 0;
+    if (times)
+    {
+        for (; i < total; ++i)
+        {
+            if (i == 1)
+            {
+                int null_fd = open("/dev/null", O_WRONLY);
+                if (null_fd >= 0)
+                {
+                    dup2(null_fd, STDERR_FILENO);
+                    close(null_fd);
+                }
+            }
+            double t0 = now_sec();
+            if (run_once(mode, input, ddp, bin, width_bytes, block_size, opts) != 0)
+                break;
+            double t1 = now_sec();
+            if (i >= opts->warmup)
+                times[i - opts->warmup] = t1 - t0;
+        }
+    }
+    if (times && i == total)
+    {
+        qsort(times, (size_t)opts->repeats, sizeof(double), compare_doubles);
+        res.ok = 1;
+        res.elapsed_sec = times[opts->repeats / 2];
+    }
+    free(times);
+    ssize_t w = write(fd, &res, sizeof(res));
+    _exit(w == (ssize_t)sizeof(res) && res.ok ? 0 : 1);
+}
+
+// 측정 하나를 fork 한 child 에서 실행한다. max_rss_kb 는 wait4 로 받은 child 의 최대 RSS. 실패 시 1.
+static int bench_fork(int mode, const char *input, const char *ddp, const char *bin,
+                      int width_bytes, int block_size, const BenchOptions *opts,
+                      double *elapsed_out, long *max_rss_kb_out)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        bench_child(fds[1], mode, input, ddp, bin, width_bytes, block_size, opts);
+    }
+    close(fds[1]);
+
+    BenchResult res = { 0, 0.0 };
+    ssize_t got;
+    do
+    {
+        got = read(fds[0], &res, sizeof(res));
+    } while (got < 0 && errno == EINTR);
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    while (wait4(pid, &status, 0, &ru) < 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("wait4");
+            return 1;
+        }
+    }
+    if (got != (ssize_t)sizeof(res) || !res.ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return 1;
+    *elapsed_out = res.elapsed_sec;
+    *max_rss_kb_out = ru.ru_maxrss;
+    return 0;
+}
+
+int run_bench(const char *work_dir, const BenchInput *inputs, size_t num_inputs,
+              const BenchOptions *opts)
+{
+    if (opts->warmup < 0 || opts->repeats <= 0)
+    {
+        fprintf(stderr, "Invalid bench repetition counts: warmup=%d repeats=%d\n",
+                opts->warmup, opts->repeats);
+        return 1;
+    }
+    // dict_hit_rate 등은 DDP1/DDP2 header 에서 읽는다
+    if (opts->compress && opts->compress->segment_blocks > 0)
+    {
+        fprintf(stderr, "Bench is not supported for segmented (-S) files\n");
+        return 1;
+    }
+    if (mkdir(work_dir, 0755) != 0 && errno != EEXIST)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    fprintf(opts->csv, "mode,sensor,block_size,elapsed_sec,max_rss_kb,mb_per_sec,ns_per_block,dict_hit_rate\n");
+
+    int failed = 0;
+    size_t path_cap = strlen(work_dir) + 96;
+    char *ddp = (char *)malloc(path_cap);
+    char *bin = (char *)malloc(path_cap);
+    if (!ddp || !bin)
+    {
+        fprintf(stderr, "Failed to allocate bench paths\n");
+        free(ddp);
+        free(bin);
+        return 1;
+    }
+
+    for (size_t i = 0; i < num_inputs; ++i)
+    {
+        char sensor[64];
+        sensor_name(inputs[i].path, sensor, sizeof(sensor));
+        for (size_t b = 0; b < opts->num_block_sizes; ++b)
+        {
+            int block_size = opts->block_sizes[b];
+            snprintf(ddp, path_cap, "%s/%s_b%d.ddp", work_dir, sensor, block_size);
+            snprintf(bin, path_cap, "%s/%s_b%d.bin", work_dir, sensor, block_size);
+
+            double enc_sec = 0.0, dec_sec = 0.0;
+            long enc_rss = 0, dec_rss = 0;
+            DdpInfo info;
+            if (bench_fork(BENCH_ENC, inputs[i].path, ddp, bin, inputs[i].width_bytes,
+                           block_size, opts, &enc_sec, &enc_rss) != 0 ||
+                read_ddp_info(ddp, &info) != 0 ||
+                bench_fork(BENCH_DEC, inputs[i].path, ddp, bin, inputs[i].width_bytes,
+                           block_size, opts, &dec_sec, &dec_rss) != 0)
+            {
+                fprintf(stderr, "Bench failed: sensor=%s, block_size=%d\n", sensor, block_size);
+                failed = 1;
+                continue;
+            }
+
+            double raw_mb = (double)info.sample_count * (double)info.width_bytes / 1e6;
+            double blocks = info.num_blocks ? (double)info.num_blocks : 1.0;
+            double hit_rate = info.num_blocks
+                                  ? 1.0 - (double)info.dict_size / (double)info.num_blocks
+                                  : 0.0;
+            if (hit_rate < 0.0)
+                hit_rate = 0.0;  // 공유 dictionary 항목이 block 수보다 많은 경우
+            const int modes[2] = { BENCH_ENC, BENCH_DEC };
+            const double secs[2] = { enc_sec, dec_sec };
+            const long rss[2] = { enc_rss, dec_rss };
+            for (int m = 0; m < 2; ++m)
+            {
+                double sec = secs[m] > 0.0 ? secs[m] : 1e-9;
+                fprintf(opts->csv, "%s,%s,%d,%.6f,%ld,%.2f,%.1f,%.4f\n",
+                        modes[m] == BENCH_ENC ? "ENC" : "DEC", sensor, block_size,
+                        secs[m], rss[m], raw_mb / sec, sec * 1e9 / blocks, hit_rate);
+            }
+            fflush(opts->csv);
+        }
+    }
+
+    free(ddp);
+    free(bin);
+    return failed;
+}
@@ -1,6 +1,15 @@
+#define _DEFAULT_SOURCE
 #include "../include/bin_io.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <limits.h>
 
 int read_binary_file(const char *filename,
                      unsigned char **data_out,
@@ -51,6 +60,134 @@ int read_binary_file(const char *filename,
     return 0;
 }
 
+static int map_file(const char *filename, int prot, int advice,
+                    void **data_out, size_t *nbytes_out)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open input");
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("fstat");
+        close(fd);
+        return 1;
+    }
+    size_t sz = (size_t)st.st_size;
+    if (sz == 0)
+    {
+        close(fd);
+        *data_out = NULL;
+        *nbytes_out = 0;
+        return 0;
+    }
+
+    void *p = mmap(NULL, sz, prot, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    madvise(p, sz, advice);
+
+    *data_out = p;
+    *nbytes_out = sz;
+    return 0;
+}
+
+int map_binary_file(const char *filename,
+                    const unsigned char **data_out,
+                    size_t *nbytes_out)
+{
+    // block 순서대로 한 번 훑으므로 readahead 를 키우도록 알린다
+    void *p = NULL;
+    if (map_file(filename, PROT_READ, MADV_SEQUENTIAL, &p, nbytes_out) != 0)
+        return 1;
+    *data_out = (const unsigned char *)p;
+    return 0;
+}
+
+int map_binary_file_private(const char *filename,
+                            unsigned char **data_out,
+                            size_t *nbytes_out)
+{
+    // index lookup 은 임의 위치를 읽으므로 readahead 를 끈다
+    void *p = NULL;
+    if (map_file(filename, PROT_READ | PROT_WRITE, MADV_RANDOM, &p, nbytes_out) != 0)
+        return 1;
+    *data_out = (unsigned char *)p;
+    return 0;
+}
+
+void unmap_binary_file(const unsigned char *data, size_t nbytes)
+{
+    if (data && nbytes > 0)
+    {
+        munmap((void *)data, nbytes);
+    }
+}
+
+void release_mapped_prefix(const unsigned char *data, size_t done_bytes)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = done_bytes - done_bytes % page;
+    if (data && len > 0)
+    {
+        madvise((void *)data, len, MADV_DONTNEED);
+    }
+}
+
+int create_mapped_file(const char *filename,
+                       size_t nbytes,
+                       unsigned char **data_out)
+{
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("open output");
+        return 1;
+    }
+    if (nbytes == 0)
+    {
+        close(fd);
+        *data_out = NULL;
+        return 0;
+    }
+    if (ftruncate(fd, (off_t)nbytes) != 0)
+    {
+        perror("ftruncate");
+        close(fd);
+        return 1;
+    }
+
+    void *p = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap output");
+        return 1;
+    }
+    *data_out = (unsigned char *)p;
+    return 0;
+}
+
+int close_mapped_file(unsigned char *data, size_t nbytes)
+{
+    if (!data || nbytes == 0)
+        return 0;
+    if (munmap(data, nbytes) != 0)
+    {
+        perror("munmap output");
+        return 1;
+    }
+    return 0;
+}
+
 int write_binary_file(const char *filename,
                       const unsigned char *data,
                       size_t nbytes)
@@ -71,3 +208,483 @@ int write_binary_file(const char *filename,
     fclose(fp);
     return 0;
 }
+
+
+#define BIN_IO_BUFFER_SIZE (1u << 20)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HOST_IS_LE 1
+#else
+#define HOST_IS_LE 0
+#endif
+
+static void encode_u32le(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+static uint32_t decode_u32le(const unsigned char *p)
+{
+    return (uint32_t)p[0]
+         | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+int bw_init(BinWriter *w, FILE *fp)
+{
+    w->fp = fp;
+    w->len = 0;
+    w->cap = BIN_IO_BUFFER_SIZE;
+    w->error = 0;
+    w->buf = (unsigned char *)malloc(w->cap);
+    if (!w->buf)
+    {
+        fprintf(stderr, "Failed to allocate write buffer\n");
+        return 1;
+    }
+    return 0;
+}
+
+int bw_init_mem(BinWriter *w)
+{
+    if (bw_init(w, NULL) != 0)
+        return 1;
+    return 0;
+}
+
+void bw_free(BinWriter *w)
+{
+    free(w->buf);
+    w->buf = NULL;
+    w->len = 0;
+    w->cap = 0;
+}
+
+// 메모리 sink 는 내보내는 대신 버퍼를 키운다
+static int bw_grow(BinWriter *w, size_t n)
+{
+    size_t cap = w->cap * 2;
+    while (cap < w->len + n)
+        cap *= 2;
+    unsigned char *buf = (unsigned char *)realloc(w->buf, cap);
+    if (!buf)
+    {
+        w->error = 1;
+        return 1;
+    }
+    w->buf = buf;
+    w->cap = cap;
+    return 0;
+}
+
+void bw_reset(BinWriter *w)
+{
+    w->len = 0;
+    w->error = 0;
+}
+
+unsigned char *bw_reserve(BinWriter *w, size_t n)
+{
+    if (w->error || w->fp)
+        return NULL;
+    if (w->len + n > w->cap && bw_grow(w, n) != 0)
+        return NULL;
+    unsigned char *p = w->buf + w->len;
+    w->len += n;
+    return p;
+}
+
+int bw_flush(BinWriter *w)
+{
+    if (!w->fp)
+        return w->error ? 1 : 0;
+    if (!w->error && w->len > 0)
+    {
+        if (fwrite(w->buf, 1, w->len, w->fp) != w->len)
+        {
+            w->error = 1;
+        }
+    }
+    w->len = 0;
+    return w->error ? 1 : 0;
+}
+
+int bw_write(BinWriter *w, const void *data, size_t n)
+{
+    if (w->error)
+        return 0;
+    if (w->len + n > w->cap && !w->fp)
+    {
+        if (bw_grow(w, n) != 0)
+            return 0;
+    }
+    else if (w->len + n > w->cap)
+    {
+        if (bw_flush(w) != 0)
+            return 0;
+        if (n >= w->cap)
+        {
+            if (fwrite(data, 1, n, w->fp) != n)
+            {
+                w->error = 1;
+                return 0;
+            }
+            return 1;
+        }
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+    return 1;
+}
+
+int bw_put_u8(BinWriter *w, uint8_t v)
+{
+    return bw_write(w, &v, 1);
+}
+
+int bw_put_u32le(BinWriter *w, uint32_t v)
+{
+    if (w->len + 4 > w->cap && (w->fp ? bw_flush(w) : bw_grow(w, 4)) != 0)
+        return 0;
+    if (w->error)
+        return 0;
+    encode_u32le(w->buf + w->len, v);
+    w->len += 4;
+    return 1;
+}
+
+int bw_put_u32le_array(BinWriter *w, const uint32_t *v, size_t n)
+{
+    if (HOST_IS_LE)
+    {
+        return bw_write(w, v, n * sizeof(uint32_t));
+    }
+    // big-endian host: 버퍼 단위로 변환해서 모은다
+    while (n > 0)
+    {
+        if (w->cap - w->len < 4 && (w->fp ? bw_flush(w) : bw_grow(w, 4)) != 0)
+            return 0;
+        if (w->error)
+            return 0;
+        size_t room = (w->cap - w->len) / 4;
+        size_t k = n < room ? n : room;
+        for (size_t i = 0; i < k; ++i)
+        {
+            encode_u32le(w->buf + w->len + i * 4, v[i]);
+        }
+        w->len += k * 4;
+        v += k;
+        n -= k;
+    }
+    return 1;
+}
+
+int br_init(BinReader *r, FILE *fp)
+{
+    r->fp = fp;
+    r->pos = 0;
+    r->len = 0;
+    r->cap = BIN_IO_BUFFER_SIZE;
+    r->buf = (unsigned char *)malloc(r->cap);
+    if (!r->buf)
+    {
+        fprintf(stderr, "Failed to allocate read buffer\n");
+        return 1;
+    }
+    return 0;
+}
+
+void br_init_mem(BinReader *r, const unsigned char *data, size_t n)
+{
+    r->fp = NULL;
+    r->buf = (unsigned char *)data;
+    r->pos = 0;
+    r->len = n;
+    r->cap = 0;
+}
+
+void br_free(BinReader *r)
+{
+    if (r->fp)
+        free(r->buf);
+    r->buf = NULL;
+    r->pos = 0;
+    r->len = 0;
+    r->cap = 0;
+}
+
+static int br_fill(BinReader *r)
+{
+    if (!r->fp)
+        return 0;
+    if (r->pos < r->len)
+    {
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+    }
+    r->len -= r->pos;
+    r->pos = 0;
+    size_t n = fread(r->buf + r->len, 1, r->cap - r->len, r->fp);
+    r->len += n;
+    return n > 0;
+}
+
+int br_read(BinReader *r, void *data, size_t n)
+{
+    unsigned char *dst = (unsigned char *)data;
+    size_t avail = r->len - r->pos;
+    if (n <= avail)
+    {
+        memcpy(dst, r->buf + r->pos, n);
+        r->pos += n;
+        return 1;
+    }
+
+    memcpy(dst, r->buf + r->pos, avail);
+    r->pos = r->len;
+    dst += avail;
+    n -= avail;
+    if (!r->fp)
+        return 0;
+    if (n >= r->cap)
+    {
+        // 큰 section 은 버퍼를 거치지 않고 목적지로 바로 읽는다
+        return fread(dst, 1, n, r->fp) == n;
+    }
+    while (n > 0)
+    {
+        if (r->pos == r->len && !br_fill(r))
+            return 0;
+        size_t k = r->len - r->pos;
+        if (k > n)
+            k = n;
+        memcpy(dst, r->buf + r->pos, k);
+        r->pos += k;
+        dst += k;
+        n -= k;
+    }
+    return 1;
+}
+
+int br_get_u8(BinReader *r, uint8_t *out)
+{
+    return br_read(r, out, 1);
+}
+
+int br_get_u32le(BinReader *r, uint32_t *out)
+{
+    if (r->len - r->pos < 4)
+    {
+        unsigned char b[4];
+        if (!br_read(r, b, 4))
+            return 0;
+        *out = decode_u32le(b);
+        return 1;
+    }
+    *out = decode_u32le(r->buf + r->pos);
+    r->pos += 4;
+    return 1;
+}
+
+int br_get_u32le_array(BinReader *r, uint32_t *out, size_t n)
+{
+    if (!br_read(r, out, n * sizeof(uint32_t)))
+        return 0;
+    if (!HOST_IS_LE)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = decode_u32le((const unsigned char *)&out[i]);
+        }
+    }
+    return 1;
+}
+int br_skip(BinReader *r, size_t n)
+{
+    size_t avail = r->len - r->pos;
+    if (n <= avail)
+    {
+        r->pos += n;
+        return 1;
+    }
+    if (!r->fp)
+        return 0;
+    n -= avail;
+    r->pos = 0;
+    r->len = 0;
+    // fseek 는 EOF 너머로도 성공하므로 길이는 호출 측이 확인한다
+    return fseeko(r->fp, (off_t)n, SEEK_CUR) == 0;
+}
+
+int br_at_eof(BinReader *r)
+{
+    if (r->pos < r->len)
+        return 0;
+    return !br_fill(r);
+}
+
+int truncate_open_file(FILE *fp, size_t nbytes)
+{
+    if (fflush(fp) != 0)
+        return 1;
+    if (ftruncate(fileno(fp), (off_t)nbytes) != 0)
+    {
+        perror("ftruncate");
+        return 1;
+    }
+    return 0;
+}
+
+int sync_open_file(FILE *fp)
+{
+    if (fflush(fp) != 0)
+        return 1;
+    if (fsync(fileno(fp)) != 0)
+    {
+        perror("fsync");
+        return 1;
+    }
+    return 0;
+}
+
+size_t br_tell(BinReader *r)
+{
+    if (!r->fp)
+        return r->pos;
+    off_t at = ftello(r->fp);
+    return at < 0 ? 0 : (size_t)at - (r->len - r->pos);
+}
+
+size_t br_remaining(BinReader *r)
+{
+    if (!r->fp)
+        return r->len - r->pos;
+    struct stat st;
+    off_t at = ftello(r->fp);
+    if (at < 0 || fstat(fileno(r->fp), &st) != 0 || st.st_size < at)
+        return r->len - r->pos;
+    return (size_t)(st.st_size - at) + (r->len - r->pos);
+}
+
+// 한 번의 writev 에 넘기는 최대 구간 수 (Linux 의 IOV_MAX)
+#define VW_BATCH 1024
+// 이보다 작고 앞 구간에 이어지지 않는 구간은 pointer 대신 stage 에 복사한다
+#define VW_COPY_MAX 256
+#define VW_STAGE_SIZE (256u << 10)
+
+int vw_open(VecWriter *w, const char *filename)
+{
+    w->n = 0;
+    w->stage_len = 0;
+    w->error = 0;
+    w->iov = malloc(sizeof(struct iovec) * VW_BATCH);
+    w->stage = (unsigned char *)malloc(VW_STAGE_SIZE);
+    if (!w->iov || !w->stage)
+    {
+        fprintf(stderr, "Failed to allocate iovec batch\n");
+        free(w->iov);
+        free(w->stage);
+        return 1;
+    }
+    w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0)
+    {
+        perror("open output");
+        free(w->iov);
+        free(w->stage);
+        w->iov = NULL;
+        w->stage = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+int vw_flush(VecWriter *w)
+{
+    struct iovec *iov = (struct iovec *)w->iov;
+    int first = 0;
+    while (!w->error && first < w->n)
+    {
+        ssize_t r = writev(w->fd, iov + first, w->n - first);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("writev");
+            w->error = 1;
+            break;
+        }
+        // 일부만 쓰였으면 다 쓴 구간을 건너뛰고 걸친 구간은 앞부분을 잘라 낸다
+        size_t done = (size_t)r;
+        while (first < w->n && done >= iov[first].iov_len)
+        {
+            done -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < w->n)
+        {
+            iov[first].iov_base = (unsigned char *)iov[first].iov_base + done;
+            iov[first].iov_len -= done;
+        }
+    }
+    w->n = 0;
+    w->stage_len = 0;
+    return w->error;
+}
+
+// 바로 앞 구간 끝에 이어지는 메모리면 그 구간을 늘린다.
+static int vw_extend_last(VecWriter *w, const void *data, size_t n)
+{
+    if (w->n == 0)
+        return 0;
+    struct iovec *last = &((struct iovec *)w->iov)[w->n - 1];
+    if ((const unsigned char *)last->iov_base + last->iov_len != (const unsigned char *)data ||
+        last->iov_len > SSIZE_MAX - n)
+        return 0;
+    last->iov_len += n;
+    return 1;
+}
+
+int vw_add(VecWriter *w, const void *data, size_t n)
+{
+    if (n == 0)
+        return !w->error;
+    // 크기와 무관하게 먼저 합쳐 본다: dictionary 에서 연달아 놓인 새 id 의 block 은
+    // 작아도 복사 없이 arena 를 가리키는 iovec 하나가 된다
+    if (vw_extend_last(w, data, n))
+        return !w->error;
+    if (n < VW_COPY_MAX)
+    {
+        // stage 를 덮어쓰기 전에 내보내야 하므로 자리가 모자라면 먼저 flush
+        if ((w->stage_len + n > VW_STAGE_SIZE || w->n == VW_BATCH) && vw_flush(w) != 0)
+            return 0;
+        unsigned char *dst = w->stage + w->stage_len;
+        memcpy(dst, data, n);
+        w->stage_len += n;
+        data = dst;
+        if (vw_extend_last(w, data, n))
+            return !w->error;
+    }
+    if (w->n == VW_BATCH && vw_flush(w) != 0)
+        return 0;
+    struct iovec *iov = (struct iovec *)w->iov;
+    iov[w->n].iov_base = (void *)data;
+    iov[w->n].iov_len = n;
+    ++w->n;
+    return !w->error;
+}
+
+int vw_close(VecWriter *w)
+{
+    int ret = vw_flush(w);
+    if (close(w->fd) != 0)
+        ret = 1;
+    free(w->iov);
+    free(w->stage);
+    w->iov = NULL;
+    w->stage = NULL;
+    return ret;
+}
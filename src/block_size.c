@@ -0,0 +1,83 @@
+#include "../include/block_size.h"
+#include "../include/dictionary.h"
+#include "../include/id_pack.h"
+#include <stdint.h>
+
+// compressor.c 의 dictionary + id section 크기 계산을 그대로 따른다 (header, tail 제외).
+static size_t estimate_bytes(size_t dict_size, size_t block_bytes, size_t num_blocks,
+                             size_t num_runs, uint32_t max_len,
+                             int packed_ids, int rle_ids)
+{
+    size_t dict_bytes = dict_size * block_bytes;
+    int id_bits = id_bits_for((uint32_t)dict_size);
+    if (!rle_ids)
+    {
+        return dict_bytes + (packed_ids ? packed_ids_size(num_blocks, id_bits) : num_blocks * 4);
+    }
+    if (packed_ids)
+    {
+        int len_bits = id_bits_for(max_len + 1);
+        return dict_bytes + 8 + packed_ids_size(num_runs, id_bits) +
+               packed_ids_size(num_runs, len_bits);
+    }
+    return dict_bytes + 4 + num_runs * 8;
+}
+
+int choose_block_size(const unsigned char *samples, size_t n, int width_bytes,
+                      int packed_ids, int rle_ids, double *bytes_per_sample)
+{
+    int best = AUTO_BLOCK_MIN;
+    double best_cost = 0.0;
+    int found = 0;
+
+    for (int bs = AUTO_BLOCK_MIN; bs <= AUTO_BLOCK_MAX; bs += AUTO_BLOCK_STEP)
+    {
+        size_t num_blocks = n / (size_t)bs;
+        if (num_blocks == 0)
+            break;
+        size_t block_bytes = (size_t)bs * (size_t)width_bytes;
+
+        Dictionary dict;
+        dict_init(&dict, block_bytes);
+        size_t num_runs = 0;
+        uint32_t run_len = 0;
+        uint32_t max_len = 0;
+        int prev = -1;
+        uint32_t ids[4 * DICT_BATCH];
+        for (size_t b0 = 0; b0 < num_blocks; b0 += 4 * DICT_BATCH)
+        {
+            size_t m = num_blocks - b0 < 4 * DICT_BATCH ? num_blocks - b0 : 4 * DICT_BATCH;
+            dict_add_batch(&dict, samples + b0 * block_bytes, m, ids);
+            for (size_t i = 0; i < m; ++i)
+            {
+                int id = (int)ids[i];
+                if (id != prev)
+                {
+                    ++num_runs;
+                    run_len = 0;
+                    prev = id;
+                }
+                else if (++run_len > max_len)
+                {
+                    max_len = run_len;
+                }
+            }
+        }
+
+        size_t bytes = estimate_bytes((size_t)dict.size, block_bytes, num_blocks,
+                                      num_runs, max_len, packed_ids, rle_ids);
+        dict_free(&dict);
+
+        double cost = (double)bytes / (double)(num_blocks * (size_t)bs);
+        if (!found || cost < best_cost)
+        {
+            best = bs;
+            best_cost = cost;
+            found = 1;
+        }
+    }
+
+    if (bytes_per_sample)
+        *bytes_per_sample = best_cost;
+    return best;
+}
@@ -0,0 +1,82 @@
+#include "../include/cdc.h"
+
+// hash 는 한 바이트마다 1 bit 씩 밀리므로 마지막 64 바이트에만 의존한다.
+// min_bytes 앞의 이 구간만 미리 굴려 두면 경계가 chunk 시작 위치와 무관해진다.
+#define GEAR_WINDOW 64
+
+static uint64_t splitmix64(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void cdc_init(CdcParams *c, int width, int avg_samples)
+{
+    uint64_t seed = 0x6764647063646331ULL;  // 고정 seed: 같은 입력이면 항상 같은 경계
+    for (int i = 0; i < 256; ++i)
+    {
+        c->gear[i] = splitmix64(&seed);
+    }
+
+    size_t min_samples = (size_t)avg_samples / 4;
+    if (min_samples == 0)
+        min_samples = 1;
+    c->width = width;
+    c->min_bytes = min_samples * (size_t)width;
+    c->max_bytes = (size_t)avg_samples * 4 * (size_t)width;
+
+    // min 이후 샘플마다 2^-bits 확률로 자르면 평균 길이가 avg 근처가 된다
+    size_t expected = (size_t)avg_samples > min_samples ? (size_t)avg_samples - min_samples : 1;
+    int bits = 0;
+    while (bits < 63 && ((size_t)2 << bits) <= expected)
+    {
+        ++bits;
+    }
+    c->mask = bits ? (~0ULL << (64 - bits)) : 0;
+}
+
+// width 가 상수로 inline 되면 샘플 안쪽 루프가 풀린다.
+static inline __attribute__((always_inline)) size_t cdc_scan(const CdcParams *c, const unsigned char *p,
+                                                             size_t n, int width)
+{
+    if (n <= c->min_bytes)
+        return n;
+    size_t end = n < c->max_bytes ? n : c->max_bytes;
+    const uint64_t *gear = c->gear;
+    const uint64_t mask = c->mask;
+
+    uint64_t h = 0;
+    size_t i = c->min_bytes > GEAR_WINDOW ? c->min_bytes - GEAR_WINDOW : 0;
+    for (; i < c->min_bytes; ++i)
+    {
+        h = (h << 1) + gear[p[i]];
+    }
+    for (; i < end; i += (size_t)width)
+    {
+        // 바이트마다 (h << 1) + gear 를 한 것과 같은 값. 샘플 안의 gear 합은 h 와
+        // 독립이라 의존 사슬이 바이트당이 아니라 샘플당 shift + add 하나로 줄어든다.
+        uint64_t g = 0;
+        for (int k = 0; k < width; ++k)
+        {
+            g = (g << 1) + gear[p[i + (size_t)k]];
+        }
+        h = (h << width) + g;
+        if ((h & mask) == 0)
+            return i + (size_t)width;
+    }
+    return end;
+}
+
+size_t cdc_next(const CdcParams *c, const unsigned char *data, size_t n)
+{
+    switch (c->width)
+    {
+    case 1: return cdc_scan(c, data, n, 1);
+    case 2: return cdc_scan(c, data, n, 2);
+    case 4: return cdc_scan(c, data, n, 4);
+    case 8: return cdc_scan(c, data, n, 8);
+    default: return cdc_scan(c, data, n, c->width);
+    }
+}
@@ -0,0 +1,362 @@
+#include "../include/channels.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANNEL_HEADER_SIZE 16
+#define CHANNEL_ENTRY_SIZE 12
+
+// channel 하나의 압축/복원 작업. 결과 stream 은 ctx 가 들고 있다.
+typedef struct
+{
+    const unsigned char *records;  // 입력 (압축) 또는 출력 (복원) 의 첫 record 에서 이 channel 위치
+    size_t record_count;
+    size_t record_bytes;
+    int width;
+    int block_size_samples;
+    const CompressOptions *opts;
+    const unsigned char *stream;  // 복원할 DDP stream
+    size_t stream_bytes;
+    DdpContext ctx;
+    const unsigned char *out;
+    size_t out_len;
+    int ret;
+} ChannelJob;
+
+static uint32_t load_u32_le(const unsigned char *b)
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+int channel_layout_parse(const char *s, ChannelLayout *layout)
+{
+    layout->num_channels = 0;
+    while (*s != '\0')
+    {
+        char *end = NULL;
+        long w = strtol(s, &end, 10);
+        if (end == s || (*end != ',' && *end != '\0') || !(w == 1 || w == 2 || w == 4 || w == 8))
+        {
+            fprintf(stderr, "Channel layout must be a comma-separated list of widths 1,2,4,8\n");
+            return 1;
+        }
+        if (layout->num_channels == CHANNELS_MAX)
+        {
+            fprintf(stderr, "At most %d channels are supported\n", CHANNELS_MAX);
+            return 1;
+        }
+        layout->widths[layout->num_channels++] = (int)w;
+        s = *end == ',' ? end + 1 : end;
+    }
+    if (layout->num_channels == 0)
+    {
+        fprintf(stderr, "Channel layout is empty\n");
+        return 1;
+    }
+    return 0;
+}
+
+// record 열 하나를 연속 배열로 (또는 그 반대로) 옮긴다. 폭이 상수인 memcpy 로 펼쳐지게 나눈다.
+#define STRIDED_COPY(DST, DST_STEP, SRC, SRC_STEP, N, W)                  \
+    for (size_t r = 0; r < (N); ++r)                                      \
+        memcpy((DST) + r * (DST_STEP), (SRC) + r * (SRC_STEP), (W));
+
+static void copy_strided(unsigned char *dst, size_t dst_step, const unsigned char *src,
+                         size_t src_step, size_t n, int width)
+{
+    switch (width)
+    {
+    case 1: STRIDED_COPY(dst, dst_step, src, src_step, n, 1) break;
+    case 2: STRIDED_COPY(dst, dst_step, src, src_step, n, 2) break;
+    case 4: STRIDED_COPY(dst, dst_step, src, src_step, n, 4) break;
+    default: STRIDED_COPY(dst, dst_step, src, src_step, n, 8) break;
+    }
+}
+
+static void *compress_worker(void *arg)
+{
+    ChannelJob *job = (ChannelJob *)arg;
+    size_t width = (size_t)job->width;
+    unsigned char *column = (unsigned char *)malloc(job->record_count * width);
+    if (!column)
+    {
+        fprintf(stderr, "Failed to allocate channel buffer\n");
+        return NULL;
+    }
+    copy_strided(column, width, job->records, job->record_bytes, job->record_count, job->width);
+    job->ret = ddp_compress_buf(&job->ctx, column, job->record_count * width, job->width,
+                                job->block_size_samples, job->opts, &job->out, &job->out_len);
+    free(column);
+    return NULL;
+}
+
+static void *decompress_worker(void *arg)
+{
+    ChannelJob *job = (ChannelJob *)arg;
+    if (ddp_decompress_buf(&job->ctx, job->stream, job->stream_bytes, NULL,
+                           &job->out, &job->out_len) != 0)
+        return NULL;
+    if (job->out_len != job->record_count * (size_t)job->width)
+    {
+        fprintf(stderr, "Channel stream does not match the record count\n");
+        return NULL;
+    }
+    // records 는 복원할 때 쓰기 가능한 출력 mapping 이다
+    copy_strided((unsigned char *)job->records, job->record_bytes, job->out, (size_t)job->width,
+                 job->record_count, job->width);
+    job->ret = 0;
+    return NULL;
+}
+
+// channel 마다 thread 하나. 만들지 못한 thread 의 작업은 현재 thread 가 한다.
+static void run_jobs(ChannelJob *jobs, int n, void *(*worker)(void *))
+{
+    pthread_t tids[CHANNELS_MAX];
+    int started[CHANNELS_MAX];
+    for (int c = 1; c < n; ++c)
+        started[c] = pthread_create(&tids[c], NULL, worker, &jobs[c]) == 0;
+    worker(&jobs[0]);
+    for (int c = 1; c < n; ++c)
+    {
+        if (started[c])
+            pthread_join(tids[c], NULL);
+        else
+            worker(&jobs[c]);
+    }
+}
+
+static int init_jobs(ChannelJob *jobs, int n)
+{
+    for (int c = 0; c < n; ++c)
+    {
+        memset(&jobs[c], 0, sizeof(jobs[c]));
+        jobs[c].ret = 1;
+        if (ddp_context_init(&jobs[c].ctx) != 0)
+        {
+            for (int k = 0; k < c; ++k)
+                ddp_context_free(&jobs[k].ctx);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void free_jobs(ChannelJob *jobs, int n)
+{
+    for (int c = 0; c < n; ++c)
+        ddp_context_free(&jobs[c].ctx);
+}
+
+static int write_container(const char *output_filename, const ChannelLayout *layout,
+                           const ChannelJob *jobs, size_t record_count,
+                           const unsigned char *tail, size_t tail_bytes)
+{
+    FILE *fp = fopen(output_filename, "wb");
+    if (!fp)
+    {
+        perror("fopen output");
+        return 1;
+    }
+    BinWriter w;
+    if (bw_init(&w, fp) != 0)
+    {
+        fclose(fp);
+        return 1;
+    }
+    int ok = bw_write(&w, "DDPC", 4) &&
+             bw_put_u32le(&w, (uint32_t)layout->num_channels) &&
+             bw_put_u32le(&w, (uint32_t)record_count) &&
+             bw_put_u32le(&w, (uint32_t)tail_bytes);
+    for (int c = 0; ok && c < layout->num_channels; ++c)
+    {
+        uint64_t n = (uint64_t)jobs[c].out_len;
+        ok = bw_put_u8(&w, (uint8_t)layout->widths[c]) && bw_put_u8(&w, 0) &&
+             bw_put_u8(&w, 0) && bw_put_u8(&w, 0) &&
+             bw_put_u32le(&w, (uint32_t)n) && bw_put_u32le(&w, (uint32_t)(n >> 32));
+    }
+    ok = ok && bw_write(&w, tail, tail_bytes);
+    for (int c = 0; ok && c < layout->num_channels; ++c)
+        ok = bw_write(&w, jobs[c].out, jobs[c].out_len);
+    int ret = bw_flush(&w) != 0 || !ok;
+    if (fclose(fp) != 0)
+        ret = 1;
+    bw_free(&w);
+    if (ret)
+        fprintf(stderr, "Failed to write output\n");
+    return ret;
+}
+
+int compress_channels(const char *input_filename, const char *output_filename,
+                      const ChannelLayout *layout, int block_size_samples,
+                      const CompressOptions *opts)
+{
+    if (opts->stream || opts->cdc || opts->shared || opts->dict_limit_bytes > 0 || opts->segment_blocks > 0)
+    {
+        fprintf(stderr, "Multi-channel input does not support -s, -c, -D, -M or -S\n");
+        return 1;
+    }
+    size_t record_bytes = 0;
+    for (int c = 0; c < layout->num_channels; ++c)
+        record_bytes += (size_t)layout->widths[c];
+
+    const unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file(input_filename, &data, &nbytes) != 0)
+        return 1;
+    size_t record_count = nbytes / record_bytes;
+    if (record_count == 0 || record_count > UINT32_MAX)
+    {
+        fprintf(stderr, record_count ? "Input has too many records for the DDP header\n"
+                                     : "Input is smaller than one record\n");
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+
+    ChannelJob jobs[CHANNELS_MAX];
+    if (init_jobs(jobs, layout->num_channels) != 0)
+    {
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    size_t offset = 0;
+    for (int c = 0; c < layout->num_channels; ++c)
+    {
+        jobs[c].records = data + offset;
+        jobs[c].record_count = record_count;
+        jobs[c].record_bytes = record_bytes;
+        jobs[c].width = layout->widths[c];
+        jobs[c].block_size_samples = block_size_samples;
+        jobs[c].opts = opts;
+        offset += (size_t)layout->widths[c];
+    }
+    run_jobs(jobs, layout->num_channels, compress_worker);
+
+    int ret = 0;
+    for (int c = 0; c < layout->num_channels; ++c)
+    {
+        if (jobs[c].ret != 0)
+        {
+            fprintf(stderr, "Failed to compress channel %d\n", c);
+            ret = 1;
+        }
+    }
+    size_t tail_bytes = nbytes - record_count * record_bytes;
+    if (ret == 0)
+        ret = write_container(output_filename, layout, jobs, record_count,
+                              data + record_count * record_bytes, tail_bytes);
+    if (ret == 0)
+    {
+        fprintf(stderr, "Compressed (channels): records=%zu, record_bytes=%zu, tail_bytes=%zu\n",
+                record_count, record_bytes, tail_bytes);
+        for (int c = 0; c < layout->num_channels; ++c)
+            fprintf(stderr, "  channel %d: width_bytes=%d, stream_bytes=%zu\n",
+                    c, layout->widths[c], jobs[c].out_len);
+    }
+    free_jobs(jobs, layout->num_channels);
+    unmap_binary_file(data, nbytes);
+    return ret;
+}
+
+int is_channel_file(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return 0;
+    unsigned char magic[4];
+    int yes = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "DDPC", 4) == 0;
+    fclose(fp);
+    return yes;
+}
+
+int decompress_channels(const char *input_filename, const char *output_filename)
+{
+    const unsigned char *file = NULL;
+    size_t file_size = 0;
+    if (map_binary_file(input_filename, &file, &file_size) != 0)
+        return 1;
+
+    int num_channels = 0;
+    size_t record_count = 0, tail_bytes = 0, record_bytes = 0, pos = 0;
+    int valid = file_size >= CHANNEL_HEADER_SIZE && memcmp(file, "DDPC", 4) == 0;
+    if (valid)
+    {
+        uint32_t n = load_u32_le(file + 4);
+        record_count = load_u32_le(file + 8);
+        tail_bytes = load_u32_le(file + 12);
+        num_channels = (int)n;
+        pos = CHANNEL_HEADER_SIZE;
+        valid = n >= 1 && n <= CHANNELS_MAX &&
+                file_size - pos >= (size_t)n * CHANNEL_ENTRY_SIZE;
+    }
+
+    ChannelJob jobs[CHANNELS_MAX];
+    if (!valid || init_jobs(jobs, num_channels) != 0)
+    {
+        if (!valid)
+            fprintf(stderr, "Invalid multi-channel header\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    for (int c = 0; valid && c < num_channels; ++c)
+    {
+        const unsigned char *e = file + pos + (size_t)c * CHANNEL_ENTRY_SIZE;
+        jobs[c].width = e[0];
+        jobs[c].stream_bytes = (size_t)((uint64_t)load_u32_le(e + 4) |
+                                        ((uint64_t)load_u32_le(e + 8) << 32));
+        jobs[c].record_count = record_count;
+        valid = jobs[c].width == 1 || jobs[c].width == 2 || jobs[c].width == 4 || jobs[c].width == 8;
+        record_bytes += (size_t)jobs[c].width;
+    }
+    pos += (size_t)num_channels * CHANNEL_ENTRY_SIZE;
+    const unsigned char *tail = file + pos;
+    valid = valid && file_size - pos >= tail_bytes;
+    pos += valid ? tail_bytes : 0;
+    for (int c = 0; valid && c < num_channels; ++c)
+    {
+        valid = file_size - pos >= jobs[c].stream_bytes;
+        jobs[c].stream = file + pos;
+        pos += valid ? jobs[c].stream_bytes : 0;
+    }
+    if (!valid || pos != file_size)
+    {
+        fprintf(stderr, "Invalid multi-channel layout\n");
+        free_jobs(jobs, num_channels);
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+
+    size_t out_bytes = record_count * record_bytes + tail_bytes;
+    unsigned char *out = NULL;
+    if (create_mapped_file(output_filename, out_bytes, &out) != 0)
+    {
+        free_jobs(jobs, num_channels);
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    size_t offset = 0;
+    for (int c = 0; c < num_channels; ++c)
+    {
+        jobs[c].records = out + offset;
+        jobs[c].record_bytes = record_bytes;
+        offset += (size_t)jobs[c].width;
+    }
+    run_jobs(jobs, num_channels, decompress_worker);
+
+    int ret = 0;
+    for (int c = 0; c < num_channels; ++c)
+    {
+        if (jobs[c].ret != 0)
+        {
+            fprintf(stderr, "Failed to decompress channel %d\n", c);
+            ret = 1;
+        }
+    }
+    if (tail_bytes > 0)
+        memcpy(out + record_count * record_bytes, tail, tail_bytes);
+    if (close_mapped_file(out, out_bytes) != 0)
+        ret = 1;
+    free_jobs(jobs, num_channels);
+    unmap_binary_file(file, file_size);
+    return ret;
+}
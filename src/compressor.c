@@ -1,30 +1,95 @@
 #include "../include/compressor.h"
 #include "../include/dictionary.h"
 #include "../include/bin_io.h"
+#include "../include/id_pack.h"
+#include "../include/transform.h"
+#include "../include/entropy.h"
+#include "../include/block_size.h"
+#include "../include/cdc.h"
+#include "../include/channels.h"
+#include "../include/segments.h"
+#include "../include/shared_dict.h"
+#include "../include/evict.h"
+#include "../include/near_match.h"
+#include "../include/stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
 
-static int write_u32_le(FILE *fp, uint32_t v) {
-    unsigned char b[4];
-    b[0] = (unsigned char)(v & 0xFF);
-    b[1] = (unsigned char)((v >> 8) & 0xFF);
-    b[2] = (unsigned char)((v >> 16) & 0xFF);
-    b[3] = (unsigned char)((v >> 24) & 0xFF);
-    return (fwrite(b, 1, 4, fp) == 4) ? 1 : 0;
+static int open_writer(const char *filename, BinWriter *w) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        perror("fopen output");
+        return 1;
+    }
+    if (bw_init(w, fp) != 0) {
+        fclose(fp);
+        return 1;
+    }
+    return 0;
 }
 
-static int read_u32_le(FILE *fp, uint32_t *out) {
-    unsigned char b[4];
-    size_t n = fread(b, 1, 4, fp);
-    if (n != 4) return 0;
-    *out = (uint32_t)b[0]
-         | ((uint32_t)b[1] << 8)
-         | ((uint32_t)b[2] << 16)
-         | ((uint32_t)b[3] << 24);
-    return 1;
+// 남은 버퍼를 내보내고 파일을 닫는다. 쓰기 오류가 있었으면 1.
+static int close_writer(BinWriter *w) {
+    int ret = bw_flush(w);
+    if (fclose(w->fp) != 0) ret = 1;
+    if (ret != 0) fprintf(stderr, "Failed to write output\n");
+    bw_free(w);
+    return ret;
+}
+
+static void abort_writer(BinWriter *w) {
+    fclose(w->fp);
+    bw_free(w);
+}
+
+static int open_reader(const char *filename, BinReader *r) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        perror("fopen compressed");
+        return 1;
+    }
+    if (br_init(r, fp) != 0) {
+        fclose(fp);
+        return 1;
+    }
+    return 0;
+}
+
+static void close_reader(BinReader *r) {
+    fclose(r->fp);
+    br_free(r);
+}
+
+typedef struct {
+    int version;  // 1: 'DDP1' (u32 id), 2: 'DDP2' (bit-packed id)
+    uint32_t sample_count;
+    uint32_t block_size_samples;
+    int width_bytes;
+    unsigned char flags;
+    int transform;  // DDP_TRANSFORM_* (header_extra[2])
+    int codec;      // DDP_CODEC_* (header_extra[3])
+    uint32_t dict_size;
+    uint32_t num_blocks;
+} DdpHeader;
+
+static int write_header(BinWriter *w, const DdpHeader *h) {
+    const unsigned char magic[4] = { 'D', 'D', 'P', (unsigned char)('0' + h->version) };
+    unsigned char header_extra[4];
+    header_extra[0] = (unsigned char)h->width_bytes;
+    header_extra[1] = h->flags;
+    header_extra[2] = (unsigned char)h->transform;
+    header_extra[3] = (unsigned char)h->codec;
+    return bw_write(w, magic, 4) &&
+           bw_put_u32le(w, h->sample_count) &&
+           bw_put_u32le(w, h->block_size_samples) &&
+           bw_write(w, header_extra, 4) &&
+           bw_put_u32le(w, h->dict_size) &&
+           bw_put_u32le(w, h->num_blocks);
 }
 
 // 포맷:
@@ -32,317 +97,3269 @@ static int read_u32_le(FILE *fp, uint32_t *out) {
 //  u32: sample_count (압축에 사용된 샘플 수)
 //  u32: block_size_samples
 //  u8 : width_bytes
-//  u8[3]: reserved(0)
+//  u8 : flags (DDP_FLAG_*)
+//  u8 : transform (DDP_TRANSFORM_*, transform.h). dictionary/tail 은 변환된 샘플을 담는다
+//  u8 : codec (DDP_CODEC_*, entropy.h)
 //  u32: dict_size
 //  u32: num_blocks
 //  [dictionary]: dict_size * (block_size_samples * width_bytes) bytes
 //  [block_ids]:  num_blocks * 4 bytes (u32, LE)
+//
+// codec 이 NONE 이 아니면 dictionary 와 block_ids section 은 각각 아래 section 으로 감싼다.
+//  u8 : method (0 = 그대로, 1 = rANS; 부호화가 더 크면 그대로 저장)
+//  u32: raw_size (감싸기 전 section 크기)
+//  u32: stored_size
+//  [stored_size bytes]
+//
+// magic 'DDP2' 는 같은 header 에 block_ids 만 bit-packing 한 형식이다.
+//  [block_ids]:  ceil(num_blocks * id_bits / 8) bytes, id_bits = ceil(log2(dict_size)),
+//                LSB-first bit stream (id_pack.h)
+//
+// DDP_FLAG_STREAM 인 경우 dictionary/block_ids section 대신 block 마다
+//  u32: id, 그리고 id 가 처음 등장한 새 항목(id == 지금까지의 dict 크기)이면
+//  바로 뒤에 block 내용이 이어진다. header 의 카운트는 압축이 끝난 뒤 채운다.
+//
+// DDP_FLAG_RLE 인 경우 [block_ids] 는 같은 id 가 연속된 run 단위로 기록한다.
+//  u32: num_runs
+//  u32: len_bits (DDP2 만)
+//  [run_ids]:  num_runs 개 id (block_ids 와 같은 인코딩)
+//  [run_lens]: num_runs 개 (run 길이 - 1), DDP1 은 u32 LE, DDP2 는 len_bits 폭
+// DDP_FLAG_RUN_INDEX 가 함께 있으면 run_lens 뒤에 구간 복원용 sparse index 가 온다.
+//  [run_index]: ceil(num_runs / RUN_INDEX_STRIDE) 개 u32 LE, k 번째 값은
+//               run k * RUN_INDEX_STRIDE 앞의 block 수 (segment 마다 0 부터)
+//
+// DDP_FLAG_SEGMENTS 인 경우 파일 끝에 append 된 segment 가 이어진다. header 의
+// 카운트는 첫 segment 것이고, 각 segment 는 앞 segment 의 dictionary 를 이어서 쓴다.
+//  magic: 'D','S','E','G' (0 이면 append 가 확정하지 못한 segment 로, 거기서 파일이 끝난다)
+//  u32: sample_count
+//  u32: dict_added (이 segment 에서 새로 추가된 dictionary 항목 수)
+//  u32: num_blocks
+//  [dictionary]: dict_added * (block_size_samples * width_bytes) bytes
+//  [block_ids]:  위와 같은 인코딩, id_bits 는 이 segment 까지의 누적 dict 크기 기준
+//
+// DDP_FLAG_TAIL 이면 block 을 채우지 못한 마지막 샘플도 보존한다. sample_count 가
+// num_blocks * block_size_samples 보다 크면 그 차이 (< block_size_samples) 만큼의
+// 샘플이 id section (stream 포맷은 마지막 block) 바로 뒤에 raw 로 이어진다.
+// segment 마다 자기 tail 을 가질 수 있고, 복원하면 그 segment 의 block 바로 뒤에 온다.
+//
+// DDP_FLAG_CDC 이면 block 은 Gear rolling hash 로 자른 가변 길이 chunk (cdc.h) 이고
+// block_size_samples 는 평균 chunk 길이다. dictionary 앞에 항목별 길이가 온다.
+//  [chunk_lens]: dict_size 개 u32 LE (샘플 수), codec 이 있으면 section 으로 감쌈
+//  [dictionary]: sum(chunk_lens) * width_bytes bytes
+//  [block_ids]:  위와 같은 인코딩 (num_blocks = chunk 수)
+// 마지막 chunk 가 남은 샘플을 모두 덮으므로 tail 은 없다. STREAM/SEGMENTS/TAIL 과
+// 함께 쓸 수 없다.
+//
+// DDP_FLAG_BOUNDED 는 STREAM 에만 붙는다. header 바로 뒤에 u32 max_entries 가 오고
+// dictionary 는 그 개수를 넘지 않는다. 가득 찬 뒤의 새 block 은 id == max_entries 와
+// 내용으로 기록되고 CLOCK (evict.h) 이 고른 항목을 덮어쓴다. 이미 있는 항목을 가리킨
+// id 는 reference bit 를 켠다. 복원기는 같은 순서로 같은 동작을 되풀이한다.
+// header 의 dict_size 는 기록된 새 block 의 총 개수다.
+//
+// DDP_FLAG_SHARED 이면 header 바로 뒤에 외부 공유 dictionary (shared_dict.h) 참조가 온다.
+//  u32: checksum 하위 32 bit, u32: 상위 32 bit
+//  u32: base_size (공유 항목 수, id [0, base_size) 가 공유 dictionary 를 가리킴)
+// header 의 dict_size 는 공유 항목을 포함한 전체 크기이고 [dictionary] 는
+// (dict_size - base_size) 개의 이 파일 고유 항목만 담는다. STREAM/CDC/SEGMENTS 와
+// 함께 쓸 수 없다.
 
-int compress_file(const char *input_filename,
-                  const char *output_filename,
-                  int width_bytes,
-                  int block_size_samples)
-{
-    if (!(width_bytes == 1 || width_bytes == 2 ||
-          width_bytes == 4 || width_bytes == 8)) {
-        fprintf(stderr, "width_bytes must be 1,2,4,8\n");
+#define DDP_HEADER_SIZE 24
+#define DDP_HEADER_FLAGS_OFFSET 13
+#define DDP_SEGMENT_HEADER_SIZE 16
+
+#define DDP_FLAG_STREAM   0x01
+#define DDP_FLAG_RLE      0x02
+#define DDP_FLAG_SEGMENTS 0x04
+#define DDP_FLAG_TAIL     0x08
+#define DDP_FLAG_CDC      0x10
+#define DDP_FLAG_SHARED   0x20
+#define DDP_FLAG_BOUNDED  0x40
+#define DDP_FLAG_RUN_INDEX 0x80
+
+#define DDP_KNOWN_FLAGS (DDP_FLAG_STREAM | DDP_FLAG_RLE | DDP_FLAG_SEGMENTS | DDP_FLAG_TAIL | \
+                         DDP_FLAG_CDC | DDP_FLAG_SHARED | DDP_FLAG_BOUNDED | DDP_FLAG_RUN_INDEX)
+
+// run_index 항목 하나가 덮는 run 수. 구간 복원은 최대 이만큼의 run 길이만 더해 본다.
+#define RUN_INDEX_STRIDE 64
+
+static uint32_t load_u32_le(const unsigned char *b) {
+    return (uint32_t)b[0]
+         | ((uint32_t)b[1] << 8)
+         | ((uint32_t)b[2] << 16)
+         | ((uint32_t)b[3] << 24);
+}
+
+#define DDP_SHARED_REF_SIZE 12
+
+// DDP_FLAG_SHARED: header 바로 뒤의 공유 dictionary 참조
+static int write_shared_ref(BinWriter *w, const SharedDict *sd) {
+    return bw_put_u32le(w, (uint32_t)sd->checksum) &&
+           bw_put_u32le(w, (uint32_t)(sd->checksum >> 32)) &&
+           bw_put_u32le(w, (uint32_t)sd->base_size);
+}
+
+// 파일이 참조하는 공유 dictionary 가 sd 인지 확인한다. 실패 시 메시지를 출력하고 1.
+static int check_shared_ref(const unsigned char *p, const DdpHeader *h, const SharedDict *sd) {
+    uint64_t checksum = (uint64_t)load_u32_le(p) | ((uint64_t)load_u32_le(p + 4) << 32);
+    uint32_t base_size = load_u32_le(p + 8);
+    if (!sd) {
+        fprintf(stderr, "File needs shared dictionary %016llx (pass it with -D)\n",
+                (unsigned long long)checksum);
         return 1;
     }
-    if (block_size_samples <= 0) {
-        fprintf(stderr, "block_size_samples must be positive\n");
+    if (sd->checksum != checksum || (uint32_t)sd->base_size != base_size ||
+        sd->width_bytes != h->width_bytes ||
+        (uint32_t)sd->block_size_samples != h->block_size_samples) {
+        fprintf(stderr, "Shared dictionary mismatch: file needs %016llx (%u entries), got %016llx (%d entries)\n",
+                (unsigned long long)checksum, base_size,
+                (unsigned long long)sd->checksum, sd->base_size);
         return 1;
     }
-
-    unsigned char *data = NULL;
-    size_t nbytes = 0;
-    if (read_binary_file(input_filename, &data, &nbytes) != 0) {
+    if (!sd->verified) {
+        fprintf(stderr, "Shared dictionary blocks are not verified (call shared_dict_verify)\n");
+        return 1;
+    }
+    if (h->dict_size < base_size) {
+        fprintf(stderr, "Invalid dict_size for shared dictionary\n");
         return 1;
     }
+    return 0;
+}
+
+typedef struct {
+    uint32_t sample_count;
+    uint32_t dict_added;
+    uint32_t num_blocks;
+} SegmentHeader;
+
+static const unsigned char segment_magic[4] = { 'D', 'S', 'E', 'G' };
 
-    if (nbytes < (size_t)width_bytes) {
-        fprintf(stderr, "Input file too small\n");
-        free(data);
+// magic 자리는 0 으로 둔다. append_file 이 segment 를 디스크에 내린 뒤 채운다 (commit).
+static int write_segment_header(BinWriter *w, const SegmentHeader *s) {
+    static const unsigned char pending[4] = { 0, 0, 0, 0 };
+    return bw_write(w, pending, 4) &&
+           bw_put_u32le(w, s->sample_count) &&
+           bw_put_u32le(w, s->dict_added) &&
+           bw_put_u32le(w, s->num_blocks);
+}
+
+// p 에 남은 n 바이트에서 segment header 를 읽는다. magic 자리가 0 이면 (중간에 잘렸어도)
+// append 가 확정하지 못한 segment 이므로 -1 을 돌려주고, 읽는 쪽은 파일이 거기서 끝난 것으로
+// 본다. 잘못된 header 면 메시지를 출력하고 1.
+static int parse_segment_header(const unsigned char *p, size_t n, SegmentHeader *s) {
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    memcpy(magic, p, n < 4 ? n : 4);
+    if ((magic[0] | magic[1] | magic[2] | magic[3]) == 0) {
+        return -1;
+    }
+    if (n < DDP_SEGMENT_HEADER_SIZE) {
+        fprintf(stderr, "Truncated segment header\n");
+        return 1;
+    }
+    if (memcmp(p, segment_magic, 4) != 0) {
+        fprintf(stderr, "Invalid segment magic\n");
         return 1;
     }
+    s->sample_count = load_u32_le(p + 4);
+    s->dict_added = load_u32_le(p + 8);
+    s->num_blocks = load_u32_le(p + 12);
+    return 0;
+}
 
-    size_t total_samples = nbytes / (size_t)width_bytes;
-    if (total_samples == 0) {
-        fprintf(stderr, "No full samples found\n");
-        free(data);
+static int read_segment_header(BinReader *r, SegmentHeader *s) {
+    unsigned char buf[DDP_SEGMENT_HEADER_SIZE];
+    size_t n = br_remaining(r);
+    if (n > DDP_SEGMENT_HEADER_SIZE) n = DDP_SEGMENT_HEADER_SIZE;
+    if (!br_read(r, buf, n)) {
+        fprintf(stderr, "Truncated segment header\n");
         return 1;
     }
+    return parse_segment_header(buf, n, s);
+}
 
-    size_t num_blocks = total_samples / (size_t)block_size_samples;
-    if (num_blocks == 0) {
-        fprintf(stderr,
-                "Not enough samples for at least one full block "
-                "(need >= %d samples)\n",
-                block_size_samples);
-        free(data);
+// segment 의 id section 을 header 와 같은 함수로 다루기 위한 view.
+// dict_size 는 이 segment 까지의 누적 크기 (id_bits 계산 기준).
+static DdpHeader segment_header_view(const DdpHeader *h, const SegmentHeader *s,
+                                     uint32_t dict_size) {
+    DdpHeader v = *h;
+    v.sample_count = s->sample_count;
+    v.dict_size = dict_size;
+    v.num_blocks = s->num_blocks;
+    return v;
+}
+
+// header (또는 segment view) 의 카운트로 tail literal 크기를 구한다. 잘못된 값이면 1.
+// DDP_FLAG_TAIL 이 없는 예전 파일은 sample_count 가 더 커도 tail 이 없다.
+static int tail_size(const DdpHeader *h, size_t *tail_bytes) {
+    size_t block_samples = (size_t)h->num_blocks * (size_t)h->block_size_samples;
+    *tail_bytes = 0;
+    if (!(h->flags & DDP_FLAG_TAIL) || (size_t)h->sample_count <= block_samples) {
+        return 0;
+    }
+    size_t tail_samples = (size_t)h->sample_count - block_samples;
+    if (tail_samples >= (size_t)h->block_size_samples) {
+        fprintf(stderr, "Invalid tail literal: %zu samples\n", tail_samples);
         return 1;
     }
+    *tail_bytes = tail_samples * (size_t)h->width_bytes;
+    return 0;
+}
 
-    size_t used_samples = num_blocks * (size_t)block_size_samples;
-    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+// mmap 입력에서 처리가 끝난 page 를 내려놓는 간격
+#define RELEASE_INTERVAL_BYTES (8u << 20)
+
+// streaming 압축 시 한 번에 읽는 입력 크기 (block 크기의 배수로 맞춤)
+#define STREAM_CHUNK_BYTES (1u << 20)
 
-    if (used_samples < total_samples) {
-        fprintf(stderr,
-                "Warning: last %zu samples (%zu bytes) are ignored (not enough to fill a block)\n",
-                (total_samples - used_samples),
-                (total_samples - used_samples) * (size_t)width_bytes);
+static size_t read_full(FILE *fp, unsigned char *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        size_t r = fread(buf + total, 1, n - total, fp);
+        if (r == 0) break;
+        total += r;
     }
+    return total;
+}
 
-    uint32_t *block_ids = (uint32_t *)malloc(sizeof(uint32_t) * num_blocks);
-    if (!block_ids) {
-        fprintf(stderr, "Failed to allocate block_ids\n");
-        free(data);
+#define SECTION_STORED 0
+#define SECTION_RANS   1
+
+// data[0, n) 을 codec section 으로 감싸 기록한다 (codec == NONE 이면 그대로).
+static int write_section(BinWriter *w, int codec, const unsigned char *data, size_t n) {
+    if (codec == DDP_CODEC_NONE) {
+        return bw_write(w, data, n);
+    }
+    if (n > UINT32_MAX) {
+        fprintf(stderr, "Section too large for entropy coding\n");
+        return 0;
+    }
+    unsigned char *coded = (unsigned char *)malloc(rans_bound(n));
+    if (!coded) {
+        fprintf(stderr, "Failed to allocate entropy coder buffer\n");
+        return 0;
+    }
+    size_t m = rans_encode(data, n, coded);
+    int method = SECTION_RANS;
+    if (m >= n) {
+        method = SECTION_STORED;
+        m = n;
+    }
+    int ok = bw_put_u8(w, (uint8_t)method) &&
+             bw_put_u32le(w, (uint32_t)n) &&
+             bw_put_u32le(w, (uint32_t)m) &&
+             bw_write(w, method == SECTION_RANS ? coded : data, m);
+    free(coded);
+    return ok;
+}
+
+static int read_section_header(BinReader *r, int *method, size_t *raw_size, size_t *stored_size) {
+    uint8_t m;
+    uint32_t raw;
+    uint32_t stored;
+    if (!br_get_u8(r, &m) || !br_get_u32le(r, &raw) || !br_get_u32le(r, &stored)) {
+        fprintf(stderr, "Failed to read section header\n");
+        return 0;
+    }
+    if (m > SECTION_RANS || (m == SECTION_STORED && stored != raw)) {
+        fprintf(stderr, "Invalid section header\n");
+        return 0;
+    }
+    *method = (int)m;
+    *raw_size = (size_t)raw;
+    *stored_size = (size_t)stored;
+    return 1;
+}
+
+// section header 뒤의 stored_size 바이트를 dst[0, n) 로 복원한다.
+static int read_section_payload(BinReader *r, int method, size_t stored_size,
+                                unsigned char *dst, size_t n) {
+    if (method == SECTION_STORED) {
+        if (!br_read(r, dst, n)) {
+            fprintf(stderr, "Failed to read section\n");
+            return 0;
+        }
         return 1;
     }
+    unsigned char *coded = (unsigned char *)malloc(stored_size > 0 ? stored_size : 1);
+    if (!coded) {
+        fprintf(stderr, "Failed to allocate entropy coder buffer\n");
+        return 0;
+    }
+    int ok = br_read(r, coded, stored_size);
+    if (!ok) {
+        fprintf(stderr, "Failed to read section\n");
+    } else if (rans_decode(coded, stored_size, dst, n) != 0) {
+        fprintf(stderr, "Corrupt entropy-coded section\n");
+        ok = 0;
+    }
+    free(coded);
+    return ok;
+}
 
-    Dictionary dict;
-    dict_init(&dict, block_size_bytes);
+// n 바이트로 알려진 section 을 dst 로 복원한다 (dictionary 용).
+static int read_section_into(BinReader *r, int codec, unsigned char *dst, size_t n) {
+    if (codec == DDP_CODEC_NONE) {
+        return br_read(r, dst, n);
+    }
+    int method;
+    size_t raw_size;
+    size_t stored_size;
+    if (!read_section_header(r, &method, &raw_size, &stored_size)) {
+        return 0;
+    }
+    if (raw_size != n) {
+        fprintf(stderr, "Section size mismatch: %zu != %zu\n", raw_size, n);
+        return 0;
+    }
+    return read_section_payload(r, method, stored_size, dst, n);
+}
 
-    for (size_t b = 0; b < num_blocks; ++b) {
-        size_t offset = b * block_size_bytes;
-        const unsigned char *block_ptr = data + offset;
+// 크기를 모르는 section 을 새로 할당한 버퍼로 복원한다 (id section 용).
+static int read_section(BinReader *r, unsigned char **out, size_t *n) {
+    int method;
+    size_t raw_size;
+    size_t stored_size;
+    if (!read_section_header(r, &method, &raw_size, &stored_size)) {
+        return 0;
+    }
+    *out = (unsigned char *)malloc(raw_size > 0 ? raw_size : 1);
+    if (!*out) {
+        fprintf(stderr, "Failed to allocate section buffer\n");
+        return 0;
+    }
+    if (!read_section_payload(r, method, stored_size, *out, raw_size)) {
+        free(*out);
+        *out = NULL;
+        return 0;
+    }
+    *n = raw_size;
+    return 1;
+}
 
-        int idx = dict_find(&dict, block_ptr);
-        if (idx == -1) {
-            idx = dict_add(&dict, block_ptr);
+static int skip_section(BinReader *r) {
+    int method;
+    size_t raw_size;
+    size_t stored_size;
+    if (!read_section_header(r, &method, &raw_size, &stored_size)) {
+        return 0;
+    }
+    return br_skip(r, stored_size);
+}
+
+// id 배열 하나를 기록한다: DDP1 은 u32 LE, DDP2 는 bits 폭으로 bit-packing
+static int write_id_array(BinWriter *w, int version, const uint32_t *v, size_t n, int bits) {
+    if (version == 2) {
+        size_t nbytes = packed_ids_size(n, bits);
+        unsigned char *packed = (unsigned char *)malloc(nbytes > 0 ? nbytes : 1);
+        if (!packed) {
+            fprintf(stderr, "Failed to allocate packed id buffer\n");
+            return 0;
         }
-        block_ids[b] = (uint32_t)idx;
+        pack_ids(v, n, bits, packed);
+        int ok = bw_write(w, packed, nbytes);
+        if (!ok) fprintf(stderr, "Failed to write packed block ids\n");
+        free(packed);
+        return ok;
     }
 
-    FILE *fp = fopen(output_filename, "wb");
-    if (!fp) {
-        perror("fopen output");
-        free(block_ids);
-        dict_free(&dict);
-        free(data);
-        return 1;
+    if (!bw_put_u32le_array(w, v, n)) {
+        fprintf(stderr, "Failed to write block ids\n");
+        return 0;
     }
+    return 1;
+}
 
-    const unsigned char magic[4] = { 'D', 'D', 'P', '1' };
-    if (fwrite(magic, 1, 4, fp) != 4) {
-        fprintf(stderr, "Failed to write magic\n");
-        fclose(fp);
-        free(block_ids);
-        dict_free(&dict);
-        free(data);
+static int read_id_array(BinReader *r, int version, uint32_t *v, size_t n, int bits) {
+    if (version == 2) {
+        size_t nbytes = packed_ids_size(n, bits);
+        unsigned char *packed = (unsigned char *)malloc(nbytes > 0 ? nbytes : 1);
+        if (!packed) {
+            fprintf(stderr, "Failed to allocate packed id buffer\n");
+            return 0;
+        }
+        if (!br_read(r, packed, nbytes)) {
+            fprintf(stderr, "Failed to read packed block ids\n");
+            free(packed);
+            return 0;
+        }
+        unpack_ids(packed, n, bits, v);
+        free(packed);
         return 1;
     }
 
-    uint32_t sample_count_u32 = (uint32_t)used_samples;
-    uint32_t block_size_samples_u32 = (uint32_t)block_size_samples;
-    uint32_t dict_size_u32 = (uint32_t)dict.size;
-    uint32_t num_blocks_u32 = (uint32_t)num_blocks;
+    if (!br_get_u32le_array(r, v, n)) {
+        fprintf(stderr, "Failed to read block ids\n");
+        return 0;
+    }
+    return 1;
+}
+
+// 복원 쪽 id 표현: lens == NULL 이면 run 길이가 모두 1 (ids == block_ids)
+typedef struct {
+    uint32_t *ids;
+    uint32_t *lens;
+    size_t num_runs;
+} IdRuns;
 
-    if (!write_u32_le(fp, sample_count_u32) ||
-        !write_u32_le(fp, block_size_samples_u32)) {
-        fprintf(stderr, "Failed to write header\n");
-        fclose(fp);
-        free(block_ids);
-        dict_free(&dict);
-        free(data);
-        return 1;
+static void id_runs_free(IdRuns *r) {
+    free(r->ids);
+    free(r->lens);
+    r->ids = NULL;
+    r->lens = NULL;
+    r->num_runs = 0;
+}
+
+static int write_id_section(BinWriter *w, const DdpHeader *h, const uint32_t *block_ids) {
+    if (h->codec != DDP_CODEC_NONE) {
+        // 메모리에 raw section 을 만든 뒤 codec section 으로 감싼다
+        DdpHeader raw = *h;
+        raw.codec = DDP_CODEC_NONE;
+        BinWriter m;
+        if (bw_init_mem(&m) != 0) return 0;
+        int ok = write_id_section(&m, &raw, block_ids) &&
+                 write_section(w, h->codec, m.buf, m.len);
+        bw_free(&m);
+        return ok;
     }
 
-    unsigned char header_extra[4];
-    header_extra[0] = (unsigned char)width_bytes;
-    header_extra[1] = 0;
-    header_extra[2] = 0;
-    header_extra[3] = 0;
-    if (fwrite(header_extra, 1, 4, fp) != 4) {
-        fprintf(stderr, "Failed to write header extra\n");
-        fclose(fp);
-        free(block_ids);
-        dict_free(&dict);
-        free(data);
-        return 1;
+    size_t num_blocks = (size_t)h->num_blocks;
+    int id_bits = id_bits_for(h->dict_size);
+    if (!(h->flags & DDP_FLAG_RLE)) {
+        return write_id_array(w, h->version, block_ids, num_blocks, id_bits);
     }
 
-    if (!write_u32_le(fp, dict_size_u32) ||
-        !write_u32_le(fp, num_blocks_u32)) {
-        fprintf(stderr, "Failed to write header tail\n");
-        fclose(fp);
-        free(block_ids);
-        dict_free(&dict);
-        free(data);
-        return 1;
+    size_t num_runs = 0;
+    for (size_t b = 0; b < num_blocks; ++b) {
+        if (b == 0 || block_ids[b] != block_ids[b - 1]) ++num_runs;
+    }
+    uint32_t *run_ids = (uint32_t *)malloc(sizeof(uint32_t) * (num_runs + 1));
+    uint32_t *run_lens = (uint32_t *)malloc(sizeof(uint32_t) * (num_runs + 1));
+    if (!run_ids || !run_lens) {
+        fprintf(stderr, "Failed to allocate run buffers\n");
+        free(run_ids);
+        free(run_lens);
+        return 0;
     }
 
-    for (int i = 0; i < dict.size; ++i) {
-        if (fwrite(dict.blocks[i], 1, block_size_bytes, fp)
-            != block_size_bytes) {
-            fprintf(stderr, "Failed to write dictionary block %d\n", i);
-            fclose(fp);
-            free(block_ids);
-            dict_free(&dict);
-            free(data);
-            return 1;
-        }
+    // run 길이는 (len - 1) 로 저장
+    size_t r = 0;
+    uint32_t max_len = 0;
+    for (size_t b = 0; b < num_blocks; ) {
+        size_t e = b + 1;
+        while (e < num_blocks && block_ids[e] == block_ids[b]) ++e;
+        run_ids[r] = block_ids[b];
+        run_lens[r] = (uint32_t)(e - b - 1);
+        if (run_lens[r] > max_len) max_len = run_lens[r];
+        ++r;
+        b = e;
     }
 
-    for (size_t b = 0; b < num_blocks; ++b) {
-        if (!write_u32_le(fp, block_ids[b])) {
-            fprintf(stderr, "Failed to write block id %zu\n", b);
-            fclose(fp);
-            free(block_ids);
-            dict_free(&dict);
-            free(data);
-            return 1;
+    int len_bits = id_bits_for(max_len + 1);
+    int ok = bw_put_u32le(w, (uint32_t)num_runs) &&
+             (h->version != 2 || bw_put_u32le(w, (uint32_t)len_bits)) &&
+             write_id_array(w, h->version, run_ids, num_runs, id_bits) &&
+             write_id_array(w, h->version, run_lens, num_runs, len_bits);
+    if (ok && (h->flags & DDP_FLAG_RUN_INDEX)) {
+        uint32_t start = 0;
+        for (size_t i = 0; ok && i < num_runs; ++i) {
+            if (i % RUN_INDEX_STRIDE == 0) ok = bw_put_u32le(w, start);
+            start += run_lens[i] + 1;
         }
     }
+    if (!ok) fprintf(stderr, "Failed to write run-length id section\n");
+    free(run_ids);
+    free(run_lens);
+    return ok;
+}
 
-    fclose(fp);
-    free(block_ids);
-    dict_free(&dict);
-    free(data);
+static size_t run_index_size(size_t num_runs) {
+    return (num_runs + RUN_INDEX_STRIDE - 1) / RUN_INDEX_STRIDE * 4;
+}
 
-    fprintf(stderr,
-            "Compressed: used_samples=%zu, block_size_samples=%d, dict_size=%d, num_blocks=%zu\n",
-            used_samples, block_size_samples, dict.size, num_blocks);
+static int read_id_section(BinReader *r, const DdpHeader *h, IdRuns *runs) {
+    if (h->codec != DDP_CODEC_NONE) {
+        unsigned char *raw_bytes = NULL;
+        size_t raw_size = 0;
+        if (!read_section(r, &raw_bytes, &raw_size)) return 0;
+        DdpHeader raw = *h;
+        raw.codec = DDP_CODEC_NONE;
+        BinReader m;
+        br_init_mem(&m, raw_bytes, raw_size);
+        int ok = read_id_section(&m, &raw, runs);
+        free(raw_bytes);
+        return ok;
+    }
 
-    return 0;
-}
+    size_t num_blocks = (size_t)h->num_blocks;
+    int id_bits = id_bits_for(h->dict_size);
+    runs->ids = NULL;
+    runs->lens = NULL;
+    runs->num_runs = 0;
 
-int decompress_file(const char *input_filename,
-                    const char *output_filename)
-{
-    FILE *fp = fopen(input_filename, "rb");
-    if (!fp) {
-        perror("fopen compressed");
+    if (!(h->flags & DDP_FLAG_RLE)) {
+        runs->ids = (uint32_t *)malloc(sizeof(uint32_t) * (num_blocks + 1));
+        if (!runs->ids) {
+            fprintf(stderr, "Failed to allocate block_ids\n");
+            return 0;
+        }
+        runs->num_runs = num_blocks;
+        if (!read_id_array(r, h->version, runs->ids, num_blocks, id_bits)) {
+            id_runs_free(runs);
+            return 0;
+        }
         return 1;
     }
 
-    unsigned char magic[4];
-    if (fread(magic, 1, 4, fp) != 4) {
-        fprintf(stderr, "Failed to read magic\n");
-        fclose(fp);
-        return 1;
+    uint32_t num_runs_u32;
+    uint32_t len_bits = 32;
+    if (!br_get_u32le(r, &num_runs_u32) ||
+        (h->version == 2 && !br_get_u32le(r, &len_bits))) {
+        fprintf(stderr, "Failed to read run-length header\n");
+        return 0;
     }
-    if (!(magic[0] == 'D' && magic[1] == 'D' &&
-          magic[2] == 'P' && magic[3] == '1')) {
-        fprintf(stderr, "Invalid magic, not a DDP1 file\n");
-        fclose(fp);
-        return 1;
+    size_t num_runs = (size_t)num_runs_u32;
+    if (num_runs > num_blocks || len_bits > 32) {
+        fprintf(stderr, "Invalid run-length header\n");
+        return 0;
+    }
+    runs->ids = (uint32_t *)malloc(sizeof(uint32_t) * (num_runs + 1));
+    runs->lens = (uint32_t *)malloc(sizeof(uint32_t) * (num_runs + 1));
+    if (!runs->ids || !runs->lens) {
+        fprintf(stderr, "Failed to allocate run buffers\n");
+        id_runs_free(runs);
+        return 0;
+    }
+    runs->num_runs = num_runs;
+    if (!read_id_array(r, h->version, runs->ids, num_runs, id_bits) ||
+        !read_id_array(r, h->version, runs->lens, num_runs, (int)len_bits) ||
+        ((h->flags & DDP_FLAG_RUN_INDEX) && !br_skip(r, run_index_size(num_runs)))) {
+        id_runs_free(runs);
+        return 0;
     }
 
-    uint32_t sample_count_u32;
-    uint32_t block_size_samples_u32;
-    if (!read_u32_le(fp, &sample_count_u32) ||
-        !read_u32_le(fp, &block_size_samples_u32)) {
-        fprintf(stderr, "Failed to read header\n");
-        fclose(fp);
-        return 1;
+    size_t total = 0;
+    for (size_t r = 0; r < num_runs; ++r) {
+        runs->lens[r] += 1;
+        total += runs->lens[r];
+        if (runs->lens[r] == 0 || total > num_blocks) break;
     }
+    if (total != num_blocks) {
+        fprintf(stderr, "Run lengths do not add up to num_blocks\n");
+        id_runs_free(runs);
+        return 0;
+    }
+    return 1;
+}
 
-    unsigned char header_extra[4];
-    if (fread(header_extra, 1, 4, fp) != 4) {
-        fprintf(stderr, "Failed to read header extra\n");
-        fclose(fp);
-        return 1;
+// src 의 run 을 dst 뒤에 이어 붙인다. 두 쪽의 lens 유무는 같아야 한다.
+static int id_runs_append(IdRuns *dst, const IdRuns *src) {
+    size_t n = dst->num_runs + src->num_runs;
+    uint32_t *ids = (uint32_t *)realloc(dst->ids, sizeof(uint32_t) * (n + 1));
+    if (!ids) {
+        fprintf(stderr, "Failed to grow block_ids\n");
+        return 0;
     }
-    int width_bytes = (int)header_extra[0];
-    if (!(width_bytes == 1 || width_bytes == 2 ||
-          width_bytes == 4 || width_bytes == 8)) {
-        fprintf(stderr, "Invalid width_bytes in header: %d\n", width_bytes);
-        fclose(fp);
-        return 1;
+    dst->ids = ids;
+    memcpy(dst->ids + dst->num_runs, src->ids, sizeof(uint32_t) * src->num_runs);
+    if (dst->lens) {
+        uint32_t *lens = (uint32_t *)realloc(dst->lens, sizeof(uint32_t) * (n + 1));
+        if (!lens) {
+            fprintf(stderr, "Failed to grow run buffers\n");
+            return 0;
+        }
+        dst->lens = lens;
+        memcpy(dst->lens + dst->num_runs, src->lens, sizeof(uint32_t) * src->num_runs);
     }
+    dst->num_runs = n;
+    return 1;
+}
 
-    uint32_t dict_size_u32;
-    uint32_t num_blocks_u32;
-    if (!read_u32_le(fp, &dict_size_u32) ||
-        !read_u32_le(fp, &num_blocks_u32)) {
-        fprintf(stderr, "Failed to read header tail\n");
-        fclose(fp);
-        return 1;
+// id section 을 읽지 않고 건너뛴다 (append 시 끝 위치만 필요).
+static int skip_id_section(BinReader *r, const DdpHeader *h) {
+    if (h->codec != DDP_CODEC_NONE) {
+        return skip_section(r);
     }
 
-    size_t sample_count = (size_t)sample_count_u32;
-    size_t block_size_samples = (size_t)block_size_samples_u32;
-    size_t dict_size = (size_t)dict_size_u32;
-    size_t num_blocks = (size_t)num_blocks_u32;
-    size_t block_size_bytes = block_size_samples * (size_t)width_bytes;
+    size_t num_blocks = (size_t)h->num_blocks;
+    int id_bits = id_bits_for(h->dict_size);
+    if (!(h->flags & DDP_FLAG_RLE)) {
+        return br_skip(r, (h->version == 2) ? packed_ids_size(num_blocks, id_bits)
+                                            : num_blocks * 4);
+    }
 
-    Dictionary dict;
-    dict_init(&dict, block_size_bytes);
+    uint32_t num_runs_u32;
+    uint32_t len_bits = 32;
+    if (!br_get_u32le(r, &num_runs_u32) ||
+        (h->version == 2 && !br_get_u32le(r, &len_bits))) {
+        fprintf(stderr, "Failed to read run-length header\n");
+        return 0;
+    }
+    size_t num_runs = (size_t)num_runs_u32;
+    if (num_runs > num_blocks || len_bits > 32) {
+        fprintf(stderr, "Invalid run-length header\n");
+        return 0;
+    }
+    size_t index_bytes = (h->flags & DDP_FLAG_RUN_INDEX) ? run_index_size(num_runs) : 0;
+    if (h->version == 2) {
+        return br_skip(r, packed_ids_size(num_runs, id_bits) +
+                          packed_ids_size(num_runs, (int)len_bits) + index_bytes);
+    }
+    return br_skip(r, num_runs * 8 + index_bytes);
+}
 
-    for (size_t i = 0; i < dict_size; ++i) {
-        unsigned char *buf = (unsigned char *)malloc(block_size_bytes);
-        if (!buf) {
-            fprintf(stderr, "Failed to allocate block buffer\n");
-            dict_free(&dict);
-            fclose(fp);
-            return 1;
+// 병렬 fingerprint 단계에서 한 번에 처리하는 최대 block 수
+#define DEDUP_WINDOW_BLOCKS (1u << 18)
+
+#define MAX_THREADS 256
+
+#define ID_PENDING DICT_MISSING
+
+typedef struct {
+    const Dictionary *dict;
+    const unsigned char *data;
+    size_t block_size_bytes;
+    size_t begin;
+    size_t end;
+    uint64_t *hashes;     // window 기준 index
+    uint32_t *block_ids;  // window 기준 index
+} FingerprintJob;
+
+// worker: 담당 구간의 fingerprint 를 계산하고, window 시작 시점의 dictionary 에서
+// 이미 있는 block 은 id 를 미리 찾아 둔다 (dictionary 는 읽기만 함).
+static void *fingerprint_worker(void *arg)
+{
+    FingerprintJob *job = (FingerprintJob *)arg;
+    dict_find_batch(job->dict, job->data + job->begin * job->block_size_bytes,
+                    job->end - job->begin, job->block_ids + job->begin, job->hashes + job->begin);
+    return NULL;
+}
+
+// near 모드: 일치하는 항목이 없으면 허용 오차 안의 항목을 쓰고, 그것도 없을 때만 더한다.
+// 어느 항목과 묶일지가 앞 block 들의 결과에 달려 있으므로 단일 thread 로 처리한다.
+static void dedup_near(Dictionary *dict, NearIndex *near, const unsigned char *data,
+                       size_t num_blocks, size_t block_size_bytes, uint32_t *block_ids)
+{
+    for (size_t b = 0; b < num_blocks; ++b) {
+        const unsigned char *block_ptr = data + b * block_size_bytes;
+        uint64_t h = dict_hash(dict, block_ptr);
+        int idx = dict_find_hashed(dict, block_ptr, h);
+        if (idx == -1) {
+            idx = near_find(near, dict, block_ptr);
         }
-        size_t n = fread(buf, 1, block_size_bytes, fp);
-        if (n != block_size_bytes) {
-            fprintf(stderr, "Failed to read dictionary block %zu\n", i);
-            free(buf);
-            dict_free(&dict);
-            fclose(fp);
-            return 1;
+        if (idx == -1) {
+            idx = dict_add_hashed(dict, block_ptr, h);
+            near_add(near, dict, idx);
         }
-        dict_add(&dict, buf);
-        free(buf);
+        block_ids[b] = (uint32_t)idx;
     }
+}
 
-    uint32_t *block_ids = (uint32_t *)malloc(sizeof(uint32_t) * num_blocks);
-    if (!block_ids) {
-        fprintf(stderr, "Failed to allocate block_ids\n");
-        dict_free(&dict);
-        fclose(fp);
-        return 1;
+// data 의 num_blocks 개 block 을 dictionary 에 대조해 block_ids 를 채운다.
+// threads > 1 이면 hashes (DEDUP_WINDOW_BLOCKS 개) 를 scratch 로 쓰며, id 는
+// 순서대로 merge 하므로 결과는 단일 thread 와 같다. near 가 있으면 허용 오차 매칭 (threads 무시).
+static int dedup_blocks(Dictionary *dict,
+                        const unsigned char *data,
+                        size_t num_blocks,
+                        size_t block_size_bytes,
+                        uint32_t *block_ids,
+                        int threads,
+                        uint64_t *hashes,
+                        NearIndex *near)
+{
+    if (near) {
+        dedup_near(dict, near, data, num_blocks, block_size_bytes, block_ids);
+        return 0;
     }
-    for (size_t b = 0; b < num_blocks; ++b) {
-        if (!read_u32_le(fp, &block_ids[b])) {
-            fprintf(stderr, "Failed to read block id %zu\n", b);
-            free(block_ids);
-            dict_free(&dict);
-            fclose(fp);
-            return 1;
-        }
+    if (threads <= 1) {
+        dict_add_batch(dict, data, num_blocks, block_ids);
+        return 0;
     }
 
-    fclose(fp);
+    pthread_t tids[MAX_THREADS];
+    FingerprintJob jobs[MAX_THREADS];
 
-    size_t total_bytes = sample_count * (size_t)width_bytes;
-    unsigned char *out = (unsigned char *)malloc(total_bytes);
-    if (!out) {
-        fprintf(stderr, "Failed to allocate output buffer\n");
-        free(block_ids);
-        dict_free(&dict);
-        return 1;
-    }
+    for (size_t w0 = 0; w0 < num_blocks; w0 += DEDUP_WINDOW_BLOCKS) {
+        size_t wn = num_blocks - w0;
+        if (wn > DEDUP_WINDOW_BLOCKS) wn = DEDUP_WINDOW_BLOCKS;
+        const unsigned char *wdata = data + w0 * block_size_bytes;
+        uint32_t *wids = block_ids + w0;
 
-    size_t bytes_written = 0;
-    for (size_t b = 0; b < num_blocks; ++b) {
-        uint32_t id = block_ids[b];
-        if (id >= dict.size) {
-            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", id, b);
-            free(out);
-            free(block_ids);
-            dict_free(&dict);
-            return 1;
+        int nthreads = threads;
+        if ((size_t)nthreads > wn) nthreads = (int)wn;
+        int started = 0;
+        for (int t = 0; t < nthreads; ++t) {
+            jobs[t].dict = dict;
+            jobs[t].data = wdata;
+            jobs[t].block_size_bytes = block_size_bytes;
+            jobs[t].begin = wn * (size_t)t / (size_t)nthreads;
+            jobs[t].end = wn * (size_t)(t + 1) / (size_t)nthreads;
+            jobs[t].hashes = hashes;
+            jobs[t].block_ids = wids;
+            if (t == 0) continue;  // 0번 구간은 현재 thread 가 처리
+            if (pthread_create(&tids[t], NULL, fingerprint_worker, &jobs[t]) != 0) {
+                fprintf(stderr, "Failed to create worker thread\n");
+                for (int k = 1; k < t; ++k) {
+                    pthread_join(tids[k], NULL);
+                }
+                return 1;
+            }
+            started = t;
+        }
+        fingerprint_worker(&jobs[0]);
+        for (int t = 1; t <= started; ++t) {
+            pthread_join(tids[t], NULL);
         }
-        unsigned char *block = dict.blocks[id];
 
-        size_t to_copy = block_size_bytes;
-        if (bytes_written + to_copy > total_bytes) {
-            to_copy = total_bytes - bytes_written;
+        // merge: window 안에서 처음 나온 block 만 dictionary 에 추가 (첫 등장 순서 유지)
+        for (size_t i = 0; i < wn; ++i) {
+            if (wids[i] != ID_PENDING) continue;
+            const unsigned char *block_ptr = wdata + i * block_size_bytes;
+            int idx = dict_find_hashed(dict, block_ptr, hashes[i]);
+            if (idx == -1) {
+                idx = dict_add_hashed(dict, block_ptr, hashes[i]);
+            }
+            wids[i] = (uint32_t)idx;
         }
-        memcpy(out + bytes_written, block, to_copy);
-        bytes_written += to_copy;
-        if (bytes_written >= total_bytes) break;
     }
+    return 0;
+}
 
-    int ret = write_binary_file(output_filename, out, bytes_written);
+// mmap 한 입력의 map + skip 부터 num_blocks 개 block 을 dedup_blocks 로 처리한다.
+// 새 block 은 dictionary 로 복사되므로 mapped 면 지나간 입력 page 는 구간마다 내려놓는다.
+// xf 가 있으면 구간마다 scratch 로 변환한 뒤 dedup 한다 (상태는 xf 에 이어짐).
+static int dedup_mapped(Dictionary *dict,
+                        const unsigned char *map,
+                        size_t skip,
+                        size_t num_blocks,
+                        uint32_t *block_ids,
+                        int threads,
+                        TransformState *xf,
+                        NearIndex *near,
+                        int mapped)
+{
+    size_t block_size_bytes = dict->block_size;
+    size_t step = RELEASE_INTERVAL_BYTES / block_size_bytes;
+    if (step == 0) step = 1;
 
-    free(out);
+    uint64_t *hashes = NULL;
+    unsigned char *scratch = NULL;
+    if (threads > 1 && !near) {
+        hashes = (uint64_t *)malloc(sizeof(uint64_t) * DEDUP_WINDOW_BLOCKS);
+    }
+    if (xf) {
+        scratch = (unsigned char *)malloc(step * block_size_bytes);
+    }
+    if ((threads > 1 && !near && !hashes) || (xf && !scratch)) {
+        fprintf(stderr, "Failed to allocate fingerprint buffer\n");
+        free(hashes);
+        free(scratch);
+        return 1;
+    }
+
+    for (size_t b = 0; b < num_blocks; b += step) {
+        size_t n = num_blocks - b;
+        if (n > step) n = step;
+        const unsigned char *src = map + skip + b * block_size_bytes;
+        if (xf) {
+            transform_encode(xf, src, scratch, n * block_size_bytes / (size_t)xf->width);
+            src = scratch;
+        }
+        if (dedup_blocks(dict, src, n, block_size_bytes,
+                         block_ids + b, threads, hashes, near) != 0) {
+            free(hashes);
+            free(scratch);
+            return 1;
+        }
+        if (mapped) release_mapped_prefix(map, skip + (b + n) * block_size_bytes);
+    }
+    free(hashes);
+    free(scratch);
+    return 0;
+}
+
+// 한 chunk 의 block 을 dedup 해서 stream 포맷으로 기록한다. 실패 시 1.
+static int emit_stream_blocks(BinWriter *w, Dictionary *dict,
+                              const unsigned char *chunk, size_t nblk,
+                              uint32_t *chunk_ids, int threads, uint64_t *hashes,
+                              NearIndex *near, size_t *num_blocks)
+{
+    size_t block_size_bytes = dict->block_size;
+    uint32_t first_new = (uint32_t)dict->size;
+    if (dedup_blocks(dict, chunk, nblk, block_size_bytes,
+                     chunk_ids, threads, hashes, near) != 0) {
+        return 1;
+    }
+
+    // id 는 첫 등장 순서로 매겨지므로 next_new 와 같으면 이 chunk 에서 새로 생긴 항목
+    uint32_t next_new = first_new;
+    for (size_t b = 0; b < nblk; ++b) {
+        const unsigned char *block_ptr = chunk + b * block_size_bytes;
+        int is_new = (chunk_ids[b] == next_new);
+        if (!bw_put_u32le(w, chunk_ids[b]) ||
+            (is_new && !bw_write(w, block_ptr, block_size_bytes))) {
+            fprintf(stderr, "Failed to write block %zu\n", *num_blocks);
+            return 1;
+        }
+        if (is_new) ++next_new;
+        ++*num_blocks;
+    }
+    return 0;
+}
+
+// DDP_FLAG_BOUNDED 용 emit_stream_blocks. 가득 차면 CLOCK victim 을 새 block 으로 덮는다.
+// 교체가 block 마다 index 를 바꾸므로 단일 thread 로 처리한다. 실패 시 1.
+static int emit_bounded_blocks(BinWriter *w, Dictionary *dict, ClockState *clock,
+                               int max_entries, const unsigned char *chunk, size_t nblk,
+                               size_t *num_blocks, size_t *inserted, size_t *evicted)
+{
+    size_t block_size_bytes = dict->block_size;
+    for (size_t b = 0; b < nblk; ++b) {
+        const unsigned char *block_ptr = chunk + b * block_size_bytes;
+        uint64_t h = dict_hash(dict, block_ptr);
+        int id = dict_find_hashed(dict, block_ptr, h);
+        uint32_t code = (uint32_t)id;
+        int is_new = id < 0;
+        if (!is_new) {
+            clock_touch(clock, id);
+        } else if (dict->size < max_entries) {
+            code = (uint32_t)dict_add_hashed(dict, block_ptr, h);
+            clock_touch(clock, (int)code);
+        } else {
+            dict_replace_hashed(dict, clock_evict(clock), block_ptr, h);
+            code = (uint32_t)max_entries;
+            ++*evicted;
+        }
+        if (is_new) ++*inserted;
+        if (!bw_put_u32le(w, code) ||
+            (is_new && !bw_write(w, block_ptr, block_size_bytes))) {
+            fprintf(stderr, "Failed to write block %zu\n", *num_blocks);
+            return 1;
+        }
+        ++*num_blocks;
+    }
+    return 0;
+}
+
+static int compress_stream(const char *input_filename,
+                           const char *output_filename,
+                           int width_bytes,
+                           int block_size_samples,
+                           const CompressOptions *opts)
+{
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+    size_t chunk_blocks = STREAM_CHUNK_BYTES / block_size_bytes;
+    if (chunk_blocks == 0) chunk_blocks = 1;
+    size_t chunk_bytes = chunk_blocks * block_size_bytes;
+
+    // 상한이 있으면 항목 하나당 block + hash (8) + index (최대 16) + reference bit 로 계산
+    int max_entries = 0;
+    if (opts->dict_limit_bytes > 0) {
+        size_t n = opts->dict_limit_bytes / (block_size_bytes + 25);
+        if (n == 0) {
+            fprintf(stderr, "-M is smaller than one dictionary entry (%zu bytes)\n",
+                    block_size_bytes + 25);
+            return 1;
+        }
+        max_entries = n > (size_t)INT32_MAX ? INT32_MAX : (int)n;
+    }
+
+    FILE *in = fopen(input_filename, "rb");
+    if (!in) {
+        perror("fopen input");
+        return 1;
+    }
+
+    unsigned char *chunk = (unsigned char *)malloc(chunk_bytes);
+    uint32_t *chunk_ids = (uint32_t *)malloc(sizeof(uint32_t) * chunk_blocks);
+    uint64_t *hashes = NULL;
+    if (opts->threads > 1) {
+        size_t n = chunk_blocks < DEDUP_WINDOW_BLOCKS ? chunk_blocks : DEDUP_WINDOW_BLOCKS;
+        hashes = (uint64_t *)malloc(sizeof(uint64_t) * n);
+    }
+    if (!chunk || !chunk_ids || (opts->threads > 1 && !hashes)) {
+        fprintf(stderr, "Failed to allocate stream buffer\n");
+        free(hashes);
+        free(chunk_ids);
+        free(chunk);
+        fclose(in);
+        return 1;
+    }
+
+    BinWriter w;
+    if (open_writer(output_filename, &w) != 0) {
+        free(hashes);
+        free(chunk_ids);
+        free(chunk);
+        fclose(in);
+        return 1;
+    }
+
+    DdpHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.block_size_samples = (uint32_t)block_size_samples;
+    hdr.width_bytes = width_bytes;
+    hdr.version = 1;
+    hdr.flags = DDP_FLAG_STREAM | (max_entries > 0 ? DDP_FLAG_BOUNDED : 0);
+    hdr.transform = opts->transform;
+    if (!write_header(&w, &hdr) ||
+        (max_entries > 0 && !bw_put_u32le(&w, (uint32_t)max_entries))) {
+        fprintf(stderr, "Failed to write header\n");
+        abort_writer(&w);
+        free(hashes);
+        free(chunk_ids);
+        free(chunk);
+        fclose(in);
+        return 1;
+    }
+
+    Dictionary dict;
+    dict_init(&dict, block_size_bytes);
+    ClockState clock = { NULL, 0, 0 };
+    if (max_entries > 0) {
+        dict_reserve(&dict, max_entries);
+        if (clock_init(&clock, max_entries) != 0) {
+            abort_writer(&w);
+            dict_free(&dict);
+            free(hashes);
+            free(chunk_ids);
+            free(chunk);
+            fclose(in);
+            return 1;
+        }
+    }
+
+    NearIndex near;
+    NearIndex *nearp = NULL;
+    if (opts->epsilon > 0) {
+        if (near_init(&near, &dict, width_bytes, opts->epsilon) != 0) {
+            abort_writer(&w);
+            clock_free(&clock);
+            dict_free(&dict);
+            free(hashes);
+            free(chunk_ids);
+            free(chunk);
+            fclose(in);
+            return 1;
+        }
+        nearp = &near;
+    }
+
+    TransformState xf;
+    transform_init(&xf, opts->transform, width_bytes);
+
+    size_t num_blocks = 0;
+    size_t leftover = 0;
+    size_t inserted = 0;
+    size_t evicted = 0;
+    int failed = 0;
+    // stream 포맷은 block 과 새 항목을 섞어 쓰므로 기록 시간도 dedup 에 들어간다
+    for (;;) {
+        STATS_TIMER(t_read);
+        size_t n = read_full(in, chunk, chunk_bytes);
+        STATS_PHASE(STATS_READ, t_read);
+        size_t nblk = n / block_size_bytes;
+        leftover = n - nblk * block_size_bytes;
+        STATS_TIMER(t_dedup);
+        transform_encode(&xf, chunk, chunk, n / (size_t)width_bytes);
+
+        int ret = (max_entries > 0)
+            ? emit_bounded_blocks(&w, &dict, &clock, max_entries, chunk, nblk,
+                                  &num_blocks, &inserted, &evicted)
+            : emit_stream_blocks(&w, &dict, chunk, nblk, chunk_ids, opts->threads,
+                                 hashes, nearp, &num_blocks);
+        STATS_PHASE(STATS_DEDUP, t_dedup);
+        if (ret != 0) {
+            failed = 1;
+            break;
+        }
+        // 입력 크기를 미리 모르므로 chunk 마다 header 의 u32 카운트를 넘는지 본다
+        if (num_blocks * (size_t)block_size_samples + leftover / (size_t)width_bytes > UINT32_MAX) {
+            fprintf(stderr, "Input too large for the DDP header\n");
+            failed = 1;
+            break;
+        }
+        if (n < chunk_bytes) {
+            // 마지막 chunk: block 을 채우지 못한 샘플은 tail literal 로 남긴다
+            size_t tail_bytes = leftover - leftover % (size_t)width_bytes;
+            if (!bw_write(&w, chunk + nblk * block_size_bytes, tail_bytes)) {
+                fprintf(stderr, "Failed to write tail literal\n");
+                failed = 1;
+            }
+            leftover = tail_bytes;
+            break;
+        }
+    }
+
+    int read_error = ferror(in);
+    fclose(in);
+    free(hashes);
+    free(chunk_ids);
+    free(chunk);
+    size_t near_matches = nearp ? near.matches : 0;
+    if (nearp) near_free(&near);
+    if (failed) {
+        abort_writer(&w);
+        clock_free(&clock);
+        dict_free(&dict);
+        return 1;
+    }
+    if (read_error) {
+        fprintf(stderr, "Failed to read input\n");
+        abort_writer(&w);
+        clock_free(&clock);
+        dict_free(&dict);
+        return 1;
+    }
+
+    size_t tail_samples = leftover / (size_t)width_bytes;
+    size_t used_samples = num_blocks * (size_t)block_size_samples + tail_samples;
+    if (used_samples == 0) {
+        fprintf(stderr, "No full samples found\n");
+        abort_writer(&w);
+        clock_free(&clock);
+        dict_free(&dict);
+        return 1;
+    }
+
+    if (tail_samples > 0) hdr.flags |= DDP_FLAG_TAIL;
+    hdr.sample_count = (uint32_t)used_samples;
+    hdr.dict_size = (uint32_t)(max_entries > 0 ? inserted : (size_t)dict.size);
+    hdr.num_blocks = (uint32_t)num_blocks;
+    STATS_TIMER(t_ids);
+    if (bw_flush(&w) != 0 || fseek(w.fp, 0, SEEK_SET) != 0 ||
+        !write_header(&w, &hdr)) {
+        fprintf(stderr, "Failed to finalize header\n");
+        abort_writer(&w);
+        clock_free(&clock);
+        dict_free(&dict);
+        return 1;
+    }
+    if (close_writer(&w) != 0) {
+        clock_free(&clock);
+        dict_free(&dict);
+        return 1;
+    }
+    STATS_PHASE(STATS_ID_WRITE, t_ids);
+
+    fprintf(stderr,
+            "Compressed (stream): samples=%zu, block_size_samples=%d, dict_size=%d, num_blocks=%zu, tail_samples=%zu\n",
+            used_samples, block_size_samples, (int)hdr.dict_size, num_blocks, tail_samples);
+    if (max_entries > 0) {
+        fprintf(stderr, "Bounded dictionary: max_entries=%d, evicted=%zu\n", max_entries, evicted);
+    }
+    if (nearp) {
+        fprintf(stderr, "Near matches: %zu blocks within epsilon=%llu\n",
+                near_matches, (unsigned long long)opts->epsilon);
+    }
+    clock_free(&clock);
+    dict_free(&dict);
+    return 0;
+}
+
+// content-defined chunking 압축. 입력 전체를 mmap 해서 chunk 경계를 찾고
+// 가변 길이 dictionary 로 dedup 한다 (fingerprint 는 단일 thread).
+static int compress_cdc(const char *input_filename,
+                        const char *output_filename,
+                        int width_bytes,
+                        int avg_samples,
+                        const CompressOptions *opts)
+{
+    STATS_TIMER(t_read);
+    const unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file(input_filename, &data, &nbytes) != 0) {
+        return 1;
+    }
+    STATS_PHASE(STATS_READ, t_read);
+    size_t total_samples = nbytes / (size_t)width_bytes;
+    if (total_samples == 0 || total_samples > UINT32_MAX) {
+        fprintf(stderr, total_samples ? "Input too large for the DDP header\n"
+                                      : "No full samples found\n");
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    size_t total_bytes = total_samples * (size_t)width_bytes;
+
+    // 변환은 경계 검출 전에 입력 전체에 적용한다 (입력 크기만큼 추가 메모리)
+    STATS_TIMER(t_dedup);
+    const unsigned char *src = data;
+    unsigned char *xformed = NULL;
+    if (opts->transform != DDP_TRANSFORM_NONE) {
+        xformed = (unsigned char *)malloc(total_bytes);
+        if (!xformed) {
+            fprintf(stderr, "Failed to allocate transform buffer\n");
+            unmap_binary_file(data, nbytes);
+            return 1;
+        }
+        TransformState xf;
+        transform_init(&xf, opts->transform, width_bytes);
+        transform_encode(&xf, data, xformed, total_samples);
+        src = xformed;
+    }
+
+    CdcParams cdc;
+    cdc_init(&cdc, width_bytes, avg_samples);
+
+    size_t ids_cap = total_bytes / cdc.min_bytes + 1;
+    uint32_t *chunk_ids = (uint32_t *)malloc(sizeof(uint32_t) * ids_cap);
+    if (!chunk_ids) {
+        fprintf(stderr, "Failed to allocate block_ids\n");
+        free(xformed);
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+
+    VarDictionary dict;
+    vdict_init(&dict);
+    size_t num_chunks = 0;
+    for (size_t pos = 0; pos < total_bytes; ) {
+        size_t len = cdc_next(&cdc, src + pos, total_bytes - pos);
+        uint64_t h = vdict_hash(src + pos, len);
+        int id = vdict_find_hashed(&dict, src + pos, len, h);
+        if (id < 0) id = vdict_add_hashed(&dict, src + pos, len, h);
+        chunk_ids[num_chunks++] = (uint32_t)id;
+        pos += len;
+    }
+    STATS_PHASE(STATS_DEDUP, t_dedup);
+
+    unsigned char *lens = (unsigned char *)malloc(sizeof(uint32_t) * (size_t)dict.size + 1);
+    if (!lens) {
+        fprintf(stderr, "Failed to allocate chunk length buffer\n");
+        vdict_free(&dict);
+        free(chunk_ids);
+        free(xformed);
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    for (int i = 0; i < dict.size; ++i) {
+        uint32_t n = (uint32_t)(vdict_len(&dict, i) / (size_t)width_bytes);
+        for (int k = 0; k < 4; ++k) lens[(size_t)i * 4 + k] = (unsigned char)(n >> (8 * k));
+    }
+
+    DdpHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.version = opts->packed_ids ? 2 : 1;
+    hdr.sample_count = (uint32_t)total_samples;
+    hdr.block_size_samples = (uint32_t)avg_samples;
+    hdr.width_bytes = width_bytes;
+    hdr.flags = DDP_FLAG_CDC | (opts->rle_ids ? DDP_FLAG_RLE : 0);
+    hdr.transform = opts->transform;
+    hdr.codec = opts->codec;
+    hdr.dict_size = (uint32_t)dict.size;
+    hdr.num_blocks = (uint32_t)num_chunks;
+
+    STATS_TIMER(t_dict);
+    BinWriter w;
+    int ok = open_writer(output_filename, &w) == 0;
+    if (ok) {
+        ok = write_header(&w, &hdr) &&
+             write_section(&w, hdr.codec, lens, sizeof(uint32_t) * (size_t)dict.size) &&
+             write_section(&w, hdr.codec, dict.data, dict.data_len);
+        STATS_PHASE(STATS_DICT_WRITE, t_dict);
+        STATS_TIMER(t_ids);
+        ok = ok && write_id_section(&w, &hdr, chunk_ids);
+        if (!ok) {
+            fprintf(stderr, "Failed to write output\n");
+            abort_writer(&w);
+        } else {
+            ok = close_writer(&w) == 0;
+        }
+        STATS_PHASE(STATS_ID_WRITE, t_ids);
+    }
+
+    int dict_size = dict.size;
+    size_t dict_bytes = dict.data_len;
+    free(lens);
+    vdict_free(&dict);
+    free(chunk_ids);
+    free(xformed);
+    unmap_binary_file(data, nbytes);
+    if (!ok) {
+        return 1;
+    }
+
+    fprintf(stderr,
+            "Compressed (cdc): samples=%zu, avg_chunk_samples=%d, dict_size=%d, dict_samples=%zu, num_chunks=%zu\n",
+            total_samples, avg_samples, dict_size, dict_bytes / (size_t)width_bytes, num_chunks);
+    return 0;
+}
+
+// 입력 앞부분 (최대 AUTO_SAMPLE_BYTES) 만 읽어 block 크기를 고른다.
+// stream 모드에서도 같은 방식이므로 입력 전체를 메모리에 올리지 않는다.
+// buf[0, n) 샘플 (덮어써도 되는 사본) 을 변환하고 block 크기를 고른다.
+static int pick_block_size(unsigned char *buf, size_t n, int width_bytes,
+                           const CompressOptions *opts, double *cost) {
+    TransformState xf;
+    transform_init(&xf, opts->transform, width_bytes);
+    transform_encode(&xf, buf, buf, n);
+    return choose_block_size(buf, n, width_bytes, opts->packed_ids, opts->rle_ids, cost);
+}
+
+static int auto_block_size(const char *input_filename, int width_bytes,
+                           const CompressOptions *opts, int *block_size_samples) {
+    FILE *fp = fopen(input_filename, "rb");
+    if (!fp) {
+        perror("fopen input");
+        return 1;
+    }
+    unsigned char *buf = (unsigned char *)malloc(AUTO_SAMPLE_BYTES);
+    if (!buf) {
+        fprintf(stderr, "Failed to allocate sample buffer\n");
+        fclose(fp);
+        return 1;
+    }
+    size_t n = read_full(fp, buf, AUTO_SAMPLE_BYTES) / (size_t)width_bytes;
+    fclose(fp);
+
+    double cost = 0.0;
+    *block_size_samples = pick_block_size(buf, n, width_bytes, opts, &cost);
+    free(buf);
+    fprintf(stderr, "Auto block size: %d samples (estimated %.3f bytes/sample over %zu samples)\n",
+            *block_size_samples, cost, n);
+    return 0;
+}
+
+void compress_options_init(CompressOptions *opts)
+{
+    memset(opts, 0, sizeof(*opts));
+    opts->threads = 1;
+}
+
+int compress_file(const char *input_filename,
+                  const char *output_filename,
+                  int width_bytes,
+                  int block_size_samples)
+{
+    CompressOptions opts;
+    compress_options_init(&opts);
+    return compress_file_opts(input_filename, output_filename,
+                              width_bytes, block_size_samples, &opts);
+}
+
+// 공유 dictionary 는 이번 입력의 항목만 지우고 돌려준다. index 가 깨져 있었으면 1.
+static int release_dict(Dictionary *dict, const CompressOptions *opts)
+{
+    int ret = 0;
+    if (opts->shared) {
+        ret = dict_truncate(dict, opts->shared->base_size);
+        opts->shared->dict = *dict;  // 재할당으로 포인터가 바뀌었을 수 있다
+    } else {
+        dict_free(dict);
+    }
+    return ret;
+}
+
+// 파일/버퍼 압축 공통의 인자 검사. shared 가 있으면 block_size_samples 0 을 그 크기로 채운다. 실패 시 1.
+static int check_compress_args(int width_bytes, int *block_size_samples,
+                               const CompressOptions *opts) {
+    if (!(width_bytes == 1 || width_bytes == 2 ||
+          width_bytes == 4 || width_bytes == 8)) {
+        fprintf(stderr, "width_bytes must be 1,2,4,8\n");
+        return 1;
+    }
+    if (*block_size_samples < 0) {
+        fprintf(stderr, "block_size_samples must be positive (or 0 for auto)\n");
+        return 1;
+    }
+    if (opts->threads < 1 || opts->threads > MAX_THREADS) {
+        fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    if (opts->transform < 0 || opts->transform >= DDP_TRANSFORM_COUNT) {
+        fprintf(stderr, "Unknown transform %d\n", opts->transform);
+        return 1;
+    }
+    if (opts->codec < 0 || opts->codec >= DDP_CODEC_COUNT) {
+        fprintf(stderr, "Unknown codec %d\n", opts->codec);
+        return 1;
+    }
+
+    if (opts->stream && opts->packed_ids) {
+        fprintf(stderr, "Packed ids (DDP2) are not available in stream mode\n");
+        return 1;
+    }
+    if (opts->stream && opts->rle_ids) {
+        fprintf(stderr, "Run-length ids are not available in stream mode\n");
+        return 1;
+    }
+    if (opts->stream && opts->codec != DDP_CODEC_NONE) {
+        fprintf(stderr, "Entropy coding is not available in stream mode\n");
+        return 1;
+    }
+    if (opts->stream && opts->cdc) {
+        fprintf(stderr, "Content-defined chunking is not available in stream mode\n");
+        return 1;
+    }
+    if (opts->epsilon > 0 && (opts->cdc || opts->dict_limit_bytes > 0 ||
+                              opts->transform != DDP_TRANSFORM_NONE)) {
+        // 변환된 값의 오차는 복원할 때 누적되므로 원래 샘플에서만 허용 오차를 보장할 수 있다
+        fprintf(stderr, "Near matching is not available with -c, -M or a transform\n");
+        return 1;
+    }
+    if (opts->segment_blocks > 0 && (opts->stream || opts->cdc)) {
+        fprintf(stderr, "Segmented output is not available with -s or -c\n");
+        return 1;
+    }
+    if (opts->freq_order && (opts->stream || opts->cdc)) {
+        // stream 포맷은 block 이 나오는 대로 id 를 기록하므로 나중에 번호를 바꿀 수 없다
+        fprintf(stderr, "Frequency-ordered dictionaries are not available with -s or -c\n");
+        return 1;
+    }
+    if (opts->dict_limit_bytes > 0 && !opts->stream) {
+        // 교체된 항목을 복원기가 따라가려면 block 과 새 항목이 순서대로 섞인 stream 포맷이어야 한다
+        fprintf(stderr, "A dictionary memory cap needs stream mode (-s)\n");
+        return 1;
+    }
+    if (opts->shared) {
+        if (opts->stream || opts->cdc) {
+            fprintf(stderr, "A shared dictionary is not available with -s or -c\n");
+            return 1;
+        }
+        if (*block_size_samples == 0) {
+            *block_size_samples = opts->shared->block_size_samples;
+        }
+        if (width_bytes != opts->shared->width_bytes ||
+            *block_size_samples != opts->shared->block_size_samples) {
+            fprintf(stderr, "Shared dictionary was built for width_bytes=%d, block_size_samples=%d\n",
+                    opts->shared->width_bytes, opts->shared->block_size_samples);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 이 입력이 더한 항목 [base, size) 를 많이 쓰인 순서 (같으면 처음 나온 순서) 로 다시 번호를
+// 매기고 block_ids 도 고친다. 자주 쓰이는 block 이 arena 앞쪽에 모여 복원 memcpy 가 같은
+// cache line 을 다시 쓰고, 흔한 id 가 작아져 entropy coding 된 id section 이 줄어든다. 실패 시 1.
+static int renumber_by_frequency(Dictionary *dict, int base, uint32_t *block_ids, size_t num_blocks) {
+    size_t n = (size_t)(dict->size - base);
+    if (n < 2) {
+        return 0;
+    }
+    uint64_t *keys = (uint64_t *)calloc(n, sizeof(uint64_t));
+    uint32_t *order = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    if (!keys || !order) {
+        fprintf(stderr, "Failed to allocate id frequency table\n");
+        free(keys);
+        free(order);
+        return 1;
+    }
+    // 상위 32 bit 는 등장 횟수의 보수라 오름차순 정렬이 빈도 내림차순, 하위는 이전 id
+    for (size_t i = 0; i < num_blocks; ++i) {
+        if (block_ids[i] >= (uint32_t)base) keys[block_ids[i] - (uint32_t)base] += (uint64_t)1 << 32;
+    }
+    for (size_t k = 0; k < n; ++k) {
+        keys[k] = ((uint64_t)(UINT32_MAX - (uint32_t)(keys[k] >> 32)) << 32) | k;
+    }
+    qsort(keys, n, sizeof(uint64_t), compare_u64);
+    for (size_t k = 0; k < n; ++k) {
+        order[k] = (uint32_t)base + (uint32_t)keys[k];
+    }
+    if (dict_renumber(dict, base, order) != 0) {
+        free(keys);
+        free(order);
+        return 1;
+    }
+
+    // keys 를 이전 id -> 새 id 표로 다시 쓴다
+    for (size_t k = 0; k < n; ++k) {
+        keys[order[k] - (uint32_t)base] = (uint64_t)base + k;
+    }
+    for (size_t i = 0; i < num_blocks; ++i) {
+        if (block_ids[i] >= (uint32_t)base) block_ids[i] = (uint32_t)keys[block_ids[i] - (uint32_t)base];
+    }
+    free(keys);
+    free(order);
+    return 0;
+}
+
+// data 의 앞 num_blocks 개 block 을 dict 에 dedup 해 block_ids 를 채우고, 나머지 샘플은
+// 변환해서 tail 에 담는다. hdr 에는 기록할 header 를 채운다. mapped 면 지나간 입력 page 를
+// 내려놓는다 (호출자 버퍼에는 쓰면 안 된다). opts->epsilon 이면 허용 오차로 묶인 block 수를
+// near_matches 에 (NULL 이 아니면) 쓴다. opts->freq_order 면 새 항목을 빈도 순으로 바꾼다. 실패 시 1.
+static int encode_blocks(Dictionary *dict, const unsigned char *data, size_t total_samples,
+                         int width_bytes, int block_size_samples, const CompressOptions *opts,
+                         int mapped, uint32_t *block_ids, unsigned char *tail,
+                         DdpHeader *hdr, size_t *tail_bytes_out, size_t *near_matches) {
+    // header 의 sample_count/num_blocks 는 u32 다
+    if (total_samples > UINT32_MAX) {
+        fprintf(stderr, "Input too large for the DDP header\n");
+        return 1;
+    }
+    // block 을 채우지 못한 나머지 샘플은 tail literal 로 그대로 기록한다
+    size_t num_blocks = total_samples / (size_t)block_size_samples;
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+    size_t tail_offset = num_blocks * block_size_bytes;
+    size_t tail_bytes = total_samples * (size_t)width_bytes - tail_offset;
+
+    TransformState xf;
+    transform_init(&xf, opts->transform, width_bytes);
+    TransformState *xfp = (opts->transform != DDP_TRANSFORM_NONE) ? &xf : NULL;
+    NearIndex near;
+    if (opts->epsilon > 0 && near_init(&near, dict, width_bytes, opts->epsilon) != 0) {
+        return 1;
+    }
+    NearIndex *nearp = (opts->epsilon > 0) ? &near : NULL;
+    STATS_TIMER(t_dedup);
+    int ret = dedup_mapped(dict, data, 0, num_blocks, block_ids, opts->threads, xfp, nearp, mapped);
+    if (nearp) {
+        if (near_matches) *near_matches = near.matches;
+        near_free(&near);
+    }
+    if (ret == 0 && opts->freq_order) {
+        ret = renumber_by_frequency(dict, opts->shared ? opts->shared->base_size : 0,
+                                    block_ids, num_blocks);
+    }
+    if (ret != 0) {
+        return 1;
+    }
+    // tail 도 block 과 같은 변환 상태를 이어서 쓴다
+    transform_encode(&xf, data + tail_offset, tail, tail_bytes / (size_t)width_bytes);
+    STATS_PHASE(STATS_DEDUP, t_dedup);
+
+    hdr->version = opts->packed_ids ? 2 : 1;
+    hdr->transform = opts->transform;
+    hdr->codec = opts->codec;
+    hdr->sample_count = (uint32_t)total_samples;
+    hdr->block_size_samples = (uint32_t)block_size_samples;
+    hdr->width_bytes = width_bytes;
+    hdr->flags = opts->rle_ids ? DDP_FLAG_RLE | DDP_FLAG_RUN_INDEX : 0;
+    if (tail_bytes > 0) hdr->flags |= DDP_FLAG_TAIL;
+    if (opts->shared) hdr->flags |= DDP_FLAG_SHARED;
+    hdr->dict_size = (uint32_t)dict->size;
+    hdr->num_blocks = (uint32_t)num_blocks;
+    *tail_bytes_out = tail_bytes;
+    return 0;
+}
+
+// encode_blocks 결과를 w 에 기록한다 (header, shared 참조, 새 dictionary 항목, id, tail). 실패 시 1.
+static int write_blocks(BinWriter *w, const DdpHeader *hdr, const CompressOptions *opts,
+                        const Dictionary *dict, int base_size, const uint32_t *block_ids,
+                        const unsigned char *tail, size_t tail_bytes) {
+    STATS_TIMER(t_dict);
+    if (!write_header(w, hdr) ||
+        (opts->shared && !write_shared_ref(w, opts->shared))) {
+        fprintf(stderr, "Failed to write header\n");
+        return 1;
+    }
+    if (!write_section(w, hdr->codec, dict_block(dict, base_size),
+                       dict->block_size * (size_t)(dict->size - base_size))) {
+        fprintf(stderr, "Failed to write dictionary\n");
+        return 1;
+    }
+    STATS_PHASE(STATS_DICT_WRITE, t_dict);
+
+    STATS_TIMER(t_ids);
+    if (!write_id_section(w, hdr, block_ids)) {
+        return 1;
+    }
+    if (!bw_write(w, tail, tail_bytes)) {
+        fprintf(stderr, "Failed to write tail literal\n");
+        return 1;
+    }
+    STATS_PHASE(STATS_ID_WRITE, t_ids);
+    return 0;
+}
+
+int compress_file_opts(const char *input_filename,
+                       const char *output_filename,
+                       int width_bytes,
+                       int block_size_samples,
+                       const CompressOptions *opts)
+{
+    if (check_compress_args(width_bytes, &block_size_samples, opts) != 0) {
+        return 1;
+    }
+
+    if (block_size_samples == 0 &&
+        auto_block_size(input_filename, width_bytes, opts, &block_size_samples) != 0) {
+        return 1;
+    }
+    STATS_RESET();  // 자동 선택의 시험 lookup 은 세지 않는다
+
+    if (opts->cdc) {
+        return compress_cdc(input_filename, output_filename,
+                            width_bytes, block_size_samples, opts);
+    }
+    if (opts->stream) {
+        return compress_stream(input_filename, output_filename,
+                               width_bytes, block_size_samples, opts);
+    }
+    if (opts->segment_blocks > 0) {
+        return compress_segmented(input_filename, output_filename,
+                                  width_bytes, block_size_samples, opts);
+    }
+
+    STATS_TIMER(t_read);
+    const unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file(input_filename, &data, &nbytes) != 0) {
+        return 1;
+    }
+    STATS_PHASE(STATS_READ, t_read);
+
+    size_t total_samples = nbytes / (size_t)width_bytes;
+    if (total_samples == 0 || total_samples > UINT32_MAX) {
+        fprintf(stderr, total_samples ? "Input too large for the DDP header\n"
+                                      : "Input file too small\n");
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+
+    size_t num_blocks = total_samples / (size_t)block_size_samples;
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+    uint32_t *block_ids = (uint32_t *)malloc(sizeof(uint32_t) * (num_blocks + 1));
+    unsigned char *tail = (unsigned char *)malloc(block_size_bytes);
+    if (!block_ids || !tail) {
+        fprintf(stderr, "Failed to allocate block_ids\n");
+        free(block_ids);
+        free(tail);
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+
+    // 공유 dictionary 는 그 위에 이 입력의 새 block 을 덧붙여 쓰고, 끝나면 되돌린다
+    Dictionary dict;
+    int base_size = 0;
+    if (opts->shared) {
+        dict = opts->shared->dict;
+        base_size = opts->shared->base_size;
+    } else {
+        dict_init(&dict, block_size_bytes);
+    }
+
+    DdpHeader hdr;
+    size_t tail_bytes = 0;
+    BinWriter w;
+    size_t near_matches = 0;
+    int ret = encode_blocks(&dict, data, total_samples, width_bytes, block_size_samples,
+                            opts, 1, block_ids, tail, &hdr, &tail_bytes, &near_matches);
+    if (ret == 0) {
+        ret = open_writer(output_filename, &w);
+    }
+    if (ret == 0) {
+        if (write_blocks(&w, &hdr, opts, &dict, base_size, block_ids, tail, tail_bytes) != 0) {
+            abort_writer(&w);
+            ret = 1;
+        } else {
+            STATS_TIMER(t_close);
+            ret = close_writer(&w);
+            STATS_PHASE(STATS_ID_WRITE, t_close);
+        }
+    }
+
+    int dict_size = dict.size - base_size;
+    free(block_ids);
+    free(tail);
+    if (release_dict(&dict, opts) != 0) {
+        ret = 1;
+    }
+    unmap_binary_file(data, nbytes);
+    if (ret != 0) {
+        return 1;
+    }
+
+    fprintf(stderr,
+            "Compressed: samples=%zu, block_size_samples=%d, dict_size=%d, num_blocks=%zu, tail_samples=%zu\n",
+            total_samples, block_size_samples, dict_size, num_blocks,
+            tail_bytes / (size_t)width_bytes);
+    if (opts->epsilon > 0) {
+        fprintf(stderr, "Near matches: %zu blocks within epsilon=%llu\n",
+                near_matches, (unsigned long long)opts->epsilon);
+    }
+
+    return 0;
+}
+
+// DDP_HEADER_SIZE 바이트 header 를 해석하고 검증한다. 실패 시 메시지를 출력하고 1.
+static int parse_header(const unsigned char *p, DdpHeader *h) {
+    if (!(p[0] == 'D' && p[1] == 'D' &&
+          p[2] == 'P' && (p[3] == '1' || p[3] == '2'))) {
+        fprintf(stderr, "Invalid magic, not a DDP1/DDP2 file\n");
+        return 1;
+    }
+    h->version = p[3] - '0';
+    h->sample_count = load_u32_le(p + 4);
+    h->block_size_samples = load_u32_le(p + 8);
+    if (h->block_size_samples == 0) {
+        fprintf(stderr, "Invalid block_size_samples in header: 0\n");
+        return 1;
+    }
+
+    const unsigned char *header_extra = p + 12;
+    h->width_bytes = (int)header_extra[0];
+    if (!(h->width_bytes == 1 || h->width_bytes == 2 ||
+          h->width_bytes == 4 || h->width_bytes == 8)) {
+        fprintf(stderr, "Invalid width_bytes in header: %d\n", h->width_bytes);
+        return 1;
+    }
+    h->flags = header_extra[1];
+    if ((h->flags & ~DDP_KNOWN_FLAGS) ||
+        ((h->flags & DDP_FLAG_STREAM) &&
+         (h->version == 2 || (h->flags & (DDP_FLAG_RLE | DDP_FLAG_SEGMENTS)))) ||
+        ((h->flags & DDP_FLAG_CDC) &&
+         (h->flags & (DDP_FLAG_STREAM | DDP_FLAG_SEGMENTS | DDP_FLAG_TAIL))) ||
+        ((h->flags & DDP_FLAG_SHARED) &&
+         (h->flags & (DDP_FLAG_STREAM | DDP_FLAG_SEGMENTS | DDP_FLAG_CDC))) ||
+        ((h->flags & DDP_FLAG_BOUNDED) && !(h->flags & DDP_FLAG_STREAM)) ||
+        ((h->flags & DDP_FLAG_RUN_INDEX) && !(h->flags & DDP_FLAG_RLE))) {
+        fprintf(stderr, "Unsupported header flags: 0x%02x\n", h->flags);
+        return 1;
+    }
+    h->transform = (int)header_extra[2];
+    if (h->transform >= DDP_TRANSFORM_COUNT) {
+        fprintf(stderr, "Unsupported transform in header: %d\n", h->transform);
+        return 1;
+    }
+    h->codec = (int)header_extra[3];
+    if (h->codec >= DDP_CODEC_COUNT ||
+        (h->codec != DDP_CODEC_NONE && (h->flags & DDP_FLAG_STREAM))) {
+        fprintf(stderr, "Unsupported codec in header: %d\n", h->codec);
+        return 1;
+    }
+
+    h->dict_size = load_u32_le(p + 16);
+    h->num_blocks = load_u32_le(p + 20);
+    return 0;
+}
+
+static int read_header(BinReader *r, DdpHeader *h) {
+    unsigned char buf[DDP_HEADER_SIZE];
+    if (!br_read(r, buf, DDP_HEADER_SIZE)) {
+        fprintf(stderr, "Failed to read header\n");
+        return 1;
+    }
+    return parse_header(buf, h);
+}
+
+int read_ddp_info(const char *filename, DdpInfo *info) {
+    if (is_segmented_file(filename)) {
+        // segment 마다 header 가 따로 있어 하나의 요약으로 나타낼 수 없다
+        fprintf(stderr, "%s: header summary is not supported for segmented (-S) files\n", filename);
+        return 1;
+    }
+    if (is_channel_file(filename)) {
+        fprintf(stderr, "%s: header summary is not supported for multi-channel files\n", filename);
+        return 1;
+    }
+    BinReader r;
+    DdpHeader h;
+    if (open_reader(filename, &r) != 0) {
+        return 1;
+    }
+    int ret = read_header(&r, &h);
+    close_reader(&r);
+    if (ret != 0) {
+        return 1;
+    }
+    info->sample_count = h.sample_count;
+    info->width_bytes = h.width_bytes;
+    info->block_size_samples = (int)h.block_size_samples;
+    info->flags = h.flags;
+    info->dict_size = h.dict_size;
+    info->num_blocks = h.num_blocks;
+    return 0;
+}
+
+// append 할 파일의 현재 끝 상태
+typedef struct {
+    size_t end_offset;        // 마지막으로 확정된 segment 가 끝나는 위치
+    int pending;              // 그 뒤에 확정되지 않은 segment 가 남아 있음
+} AppendPoint;
+
+// header 에 적힌 새 dictionary 항목 수 added 를 arena 를 잡기 전에 확인한다. size 는 이미 있는
+// 항목 수. entropy coding 된 section 은 원래 크기가 남은 바이트보다 클 수 있지만 write_section 이
+// u32 로 제한한다. 잘못되면 메시지를 출력하고 1.
+static int check_dict_added(BinReader *r, int codec, int size, size_t added, size_t block_size_bytes) {
+    size_t limit = codec == DDP_CODEC_NONE ? br_remaining(r) : UINT32_MAX;
+    if (added > (size_t)(INT_MAX - size) || added > limit / block_size_bytes) {
+        fprintf(stderr, "Invalid dictionary size %zu for the remaining input\n", added);
+        return 1;
+    }
+    return 0;
+}
+
+// append 준비: header, 모든 segment 의 dictionary 를 읽고 id section 은 건너뛴다.
+static int load_for_append(BinReader *r, DdpHeader *hdr, Dictionary *dict,
+                           AppendPoint *at)
+{
+    if (read_header(r, hdr) != 0) {
+        return 1;
+    }
+    if (hdr->flags & DDP_FLAG_STREAM) {
+        fprintf(stderr, "Cannot append to a stream-format file (compress without -s)\n");
+        return 1;
+    }
+    if (hdr->transform != DDP_TRANSFORM_NONE) {
+        // 변환 상태 (마지막 원본 샘플) 를 알려면 파일 전체를 복원해야 한다
+        fprintf(stderr, "Cannot append to a transformed file (compress without -t)\n");
+        return 1;
+    }
+    if (hdr->flags & DDP_FLAG_CDC) {
+        fprintf(stderr, "Cannot append to a content-defined chunking file (compress without -c)\n");
+        return 1;
+    }
+    if (hdr->flags & DDP_FLAG_SHARED) {
+        fprintf(stderr, "Cannot append to a file that uses a shared dictionary\n");
+        return 1;
+    }
+
+    size_t block_size_bytes = (size_t)hdr->block_size_samples * (size_t)hdr->width_bytes;
+    dict_init(dict, block_size_bytes);
+
+    SegmentHeader seg;
+    seg.sample_count = hdr->sample_count;
+    seg.dict_added = hdr->dict_size;
+    seg.num_blocks = hdr->num_blocks;
+    at->pending = 0;
+    int first = 1;
+    // 첫 append 가 header flag 를 쓰기 전에 멈췄어도 미확정 segment 는 끝에 남아 있다
+    while (first || !br_at_eof(r)) {
+        if (!first) {
+            size_t seg_offset = br_tell(r);
+            int st = read_segment_header(r, &seg);
+            if (st < 0) {
+                at->end_offset = seg_offset;
+                at->pending = 1;
+                return 0;
+            }
+            if (st != 0 || !(hdr->flags & DDP_FLAG_SEGMENTS)) {
+                fprintf(stderr, "Compressed file is truncated or has trailing data\n");
+                return 1;
+            }
+        }
+        if (check_dict_added(r, hdr->codec, dict->size, seg.dict_added, block_size_bytes) != 0) {
+            return 1;
+        }
+        unsigned char *dst = dict_append_raw(dict, (int)seg.dict_added);
+        size_t dict_bytes = block_size_bytes * (size_t)seg.dict_added;
+        if (!read_section_into(r, hdr->codec, dst, dict_bytes)) {
+            fprintf(stderr, "Failed to read dictionary\n");
+            return 1;
+        }
+
+        DdpHeader view = segment_header_view(hdr, &seg, (uint32_t)dict->size);
+        size_t tail_bytes = 0;
+        if (!skip_id_section(r, &view)) {
+            fprintf(stderr, "Failed to skip block ids\n");
+            return 1;
+        }
+        if (tail_size(&view, &tail_bytes) != 0 || !br_skip(r, tail_bytes)) {
+            return 1;
+        }
+        first = 0;
+    }
+    at->end_offset = br_tell(r);
+    return 0;
+}
+
+int append_file(const char *input_filename,
+                const char *ddp_filename,
+                int threads)
+{
+    if (threads < 1 || threads > MAX_THREADS) {
+        fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    if (is_segmented_file(ddp_filename)) {
+        fprintf(stderr, "Append is not supported for segmented (-S) files\n");
+        return 1;
+    }
+    if (is_channel_file(ddp_filename)) {
+        fprintf(stderr, "Append is not supported for multi-channel files\n");
+        return 1;
+    }
+
+    FILE *fp = fopen(ddp_filename, "r+b");
+    if (!fp) {
+        perror("fopen compressed");
+        return 1;
+    }
+    BinReader r;
+    if (br_init(&r, fp) != 0) {
+        fclose(fp);
+        return 1;
+    }
+
+    DdpHeader hdr;
+    Dictionary dict;
+    AppendPoint at;
+    memset(&dict, 0, sizeof(dict));
+    int ret = load_for_append(&r, &hdr, &dict, &at);
+    br_free(&r);
+    if (ret == 0) {
+        // fseek 는 EOF 너머로도 성공하므로 계산한 끝 위치를 실제 크기와 맞춰 본다.
+        // 확정되지 않은 segment 가 남아 있으면 그 자리에 새로 쓴다.
+        if (fseek(fp, 0, SEEK_END) != 0 || (size_t)ftell(fp) < at.end_offset ||
+            (!at.pending && (size_t)ftell(fp) != at.end_offset)) {
+            fprintf(stderr, "Compressed file is truncated or has trailing data\n");
+            ret = 1;
+        }
+    }
+    if (ret != 0) {
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+    // 압축 때와 같은 id 가 나오도록 기존 항목을 모두 index 에 올린다
+    dict_reindex(&dict);
+
+    size_t width_bytes = (size_t)hdr.width_bytes;
+    size_t block_size_bytes = dict.block_size;
+
+    const unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file(input_filename, &data, &nbytes) != 0) {
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+    size_t new_samples = nbytes / width_bytes;
+    if (new_samples == 0) {
+        fprintf(stderr, "No full samples found\n");
+        unmap_binary_file(data, nbytes);
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+    if (new_samples > UINT32_MAX) {
+        fprintf(stderr, "Too many samples to append: %zu\n", new_samples);
+        unmap_binary_file(data, nbytes);
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+    // 이전 tail literal 은 그 segment 에 그대로 두고, 새 입력만으로 segment 를 만든다
+    size_t total_bytes = new_samples * width_bytes;
+    size_t num_blocks = total_bytes / block_size_bytes;
+    size_t tail_bytes = total_bytes - num_blocks * block_size_bytes;
+
+    uint32_t *block_ids = (uint32_t *)malloc(sizeof(uint32_t) * (num_blocks + 1));
+    if (!block_ids) {
+        fprintf(stderr, "Failed to allocate block_ids\n");
+        unmap_binary_file(data, nbytes);
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+    int old_size = dict.size;
+    ret = dedup_mapped(&dict, data, 0, num_blocks, block_ids, threads, NULL, NULL, 1);
+    if (ret != 0) {
+        free(block_ids);
+        unmap_binary_file(data, nbytes);
+        dict_free(&dict);
+        fclose(fp);
+        return 1;
+    }
+
+    SegmentHeader seg;
+    seg.sample_count = (uint32_t)new_samples;
+    seg.dict_added = (uint32_t)(dict.size - old_size);
+    seg.num_blocks = (uint32_t)num_blocks;
+    unsigned char flags = hdr.flags | DDP_FLAG_SEGMENTS;
+    if (tail_bytes > 0) flags |= DDP_FLAG_TAIL;
+    hdr.flags = flags;
+    DdpHeader view = segment_header_view(&hdr, &seg, (uint32_t)dict.size);
+
+    // 기존 내용은 건드리지 않고 끝 뒤에 magic 을 비운 segment 를 써서 디스크까지 내린다.
+    // 그다음 header flag 를 갱신하고, 마지막으로 magic 을 채우는 4 바이트 쓰기가 commit 이다.
+    // 그 전에 멈추면 읽는 쪽은 새 segment 를 보지 않고, 다음 append 가 그 자리에 다시 쓴다.
+    BinWriter w;
+    long new_end = -1;
+    int ok = fseek(fp, (long)at.end_offset, SEEK_SET) == 0 && bw_init(&w, fp) == 0;
+    if (ok) {
+        ok = write_segment_header(&w, &seg) &&
+             write_section(&w, hdr.codec, dict_block(&dict, old_size),
+                           block_size_bytes * (size_t)seg.dict_added) &&
+             write_id_section(&w, &view, block_ids) &&
+             bw_write(&w, data + num_blocks * block_size_bytes, tail_bytes) &&
+             bw_flush(&w) == 0;
+        bw_free(&w);
+        if (ok) new_end = ftell(fp);
+    }
+    unmap_binary_file(data, nbytes);
+    ok = ok && new_end >= 0;
+    if (ok && at.pending) {
+        // 남아 있던 미확정 segment 가 더 길었으면 잘라낸다
+        ok = truncate_open_file(fp, (size_t)new_end) == 0;
+    }
+    ok = ok && sync_open_file(fp) == 0;
+    if (ok) {
+        ok = fseek(fp, DDP_HEADER_FLAGS_OFFSET, SEEK_SET) == 0 &&
+             fputc(flags, fp) != EOF &&
+             sync_open_file(fp) == 0;
+    }
+    if (ok) {
+        ok = fseek(fp, (long)at.end_offset, SEEK_SET) == 0 &&
+             fwrite(segment_magic, 1, 4, fp) == 4 &&
+             sync_open_file(fp) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write segment\n");
+        truncate_open_file(fp, at.end_offset);
+    }
+    if (fclose(fp) != 0) ok = 0;
+    int dict_size = dict.size;
     free(block_ids);
     dict_free(&dict);
+    if (!ok) {
+        return 1;
+    }
+
+    fprintf(stderr,
+            "Appended: samples=%zu, new_dict_entries=%u, dict_size=%d, num_blocks=%zu, tail_samples=%zu\n",
+            new_samples, seg.dict_added, dict_size, num_blocks, tail_bytes / width_bytes);
+    return 0;
+}
+
+// DDP_FLAG_STREAM 파일 복원: dictionary 만 메모리에 두고 block 단위로 출력한다.
+static int decompress_stream(BinReader *r, const DdpHeader *hdr,
+                             const char *output_filename)
+{
+    size_t block_size_bytes = (size_t)hdr->block_size_samples * (size_t)hdr->width_bytes;
+    size_t total_bytes = (size_t)hdr->sample_count * (size_t)hdr->width_bytes;
+    size_t num_blocks = (size_t)hdr->num_blocks;
+
+    BinWriter out;
+    if (open_writer(output_filename, &out) != 0) {
+        return 1;
+    }
+
+    // 크기 상한이 있으면 압축기와 같은 CLOCK 상태를 따라가며 항목을 덮어쓴다
+    int max_entries = 0;
+    ClockState clock = { NULL, 0, 0 };
+    if (hdr->flags & DDP_FLAG_BOUNDED) {
+        uint32_t n;
+        if (!br_get_u32le(r, &n) || n == 0 || n > (uint32_t)INT32_MAX) {
+            fprintf(stderr, "Invalid dictionary cap\n");
+            abort_writer(&out);
+            return 1;
+        }
+        max_entries = (int)n;
+        if (clock_init(&clock, max_entries) != 0) {
+            abort_writer(&out);
+            return 1;
+        }
+    }
+
+    Dictionary dict;
+    dict_init(&dict, block_size_bytes);
+    if (max_entries > 0) {
+        dict_reserve(&dict, max_entries);
+    }
+
+    // 변환된 파일은 block 을 scratch 에 복사해 역변환한 뒤 쓴다
+    TransformState xf;
+    transform_init(&xf, hdr->transform, hdr->width_bytes);
+    unsigned char *scratch = NULL;
+    if (hdr->transform != DDP_TRANSFORM_NONE) {
+        scratch = (unsigned char *)malloc(block_size_bytes);
+        if (!scratch) {
+            fprintf(stderr, "Failed to allocate transform buffer\n");
+            clock_free(&clock);
+            dict_free(&dict);
+            abort_writer(&out);
+            return 1;
+        }
+    }
+
+    size_t bytes_written = 0;
+    size_t inserted = 0;
+    for (size_t b = 0; b < num_blocks && bytes_written < total_bytes; ++b) {
+        uint32_t id;
+        if (!br_get_u32le(r, &id)) {
+            fprintf(stderr, "Failed to read block id %zu\n", b);
+            free(scratch);
+            clock_free(&clock);
+            dict_free(&dict);
+            abort_writer(&out);
+            return 1;
+        }
+        if (id == (uint32_t)dict.size && inserted < hdr->dict_size) {
+            unsigned char *dst;
+            if (max_entries == 0) {
+                dst = dict_append_raw(&dict, 1);
+            } else if (dict.size < max_entries) {
+                dst = dict_append_raw(&dict, 1);
+                clock_touch(&clock, (int)id);
+            } else {
+                id = (uint32_t)clock_evict(&clock);
+                dst = dict_block(&dict, (int)id);
+            }
+            ++inserted;
+            if (!br_read(r, dst, block_size_bytes)) {
+                fprintf(stderr, "Failed to read dictionary block %u\n", id);
+                free(scratch);
+                clock_free(&clock);
+                dict_free(&dict);
+                abort_writer(&out);
+                return 1;
+            }
+        } else if (id >= (uint32_t)dict.size) {
+            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", id, b);
+            free(scratch);
+            clock_free(&clock);
+            dict_free(&dict);
+            abort_writer(&out);
+            return 1;
+        } else if (max_entries > 0) {
+            clock_touch(&clock, (int)id);
+        }
+
+        size_t to_copy = block_size_bytes;
+        if (bytes_written + to_copy > total_bytes) {
+            to_copy = total_bytes - bytes_written;
+        }
+        const unsigned char *src = dict_block(&dict, (int)id);
+        if (scratch) {
+            memcpy(scratch, src, to_copy);
+            transform_decode(&xf, scratch, to_copy / (size_t)hdr->width_bytes);
+            src = scratch;
+        }
+        if (!bw_write(&out, src, to_copy)) {
+            fprintf(stderr, "Failed to write all bytes\n");
+            free(scratch);
+            clock_free(&clock);
+            dict_free(&dict);
+            abort_writer(&out);
+            return 1;
+        }
+        bytes_written += to_copy;
+    }
+
+    // tail literal 은 block 크기보다 작으므로 dictionary arena 뒤의 한 칸을 빌려 읽는다
+    size_t tail_bytes = 0;
+    if (tail_size(hdr, &tail_bytes) != 0) {
+        free(scratch);
+        clock_free(&clock);
+        dict_free(&dict);
+        abort_writer(&out);
+        return 1;
+    }
+    if (tail_bytes > 0) {
+        unsigned char *tail = dict_append_raw(&dict, 1);
+        int ok = br_read(r, tail, tail_bytes);
+        if (ok) transform_decode(&xf, tail, tail_bytes / (size_t)hdr->width_bytes);
+        if (!ok || !bw_write(&out, tail, tail_bytes)) {
+            fprintf(stderr, "Failed to copy tail literal\n");
+            free(scratch);
+            clock_free(&clock);
+            dict_free(&dict);
+            abort_writer(&out);
+            return 1;
+        }
+    }
+
+    free(scratch);
+    clock_free(&clock);
+    dict_free(&dict);
+    return close_writer(&out);
+}
+
+typedef struct {
+    const Dictionary *dict;
+    const uint32_t *block_ids;
+    unsigned char *out;
+    size_t out_bytes;
+    size_t begin;
+    size_t end;
+    size_t bad_block;  // 잘못된 id 를 만난 첫 block (없으면 SIZE_MAX)
+} FillJob;
+
+static void *fill_worker(void *arg)
+{
+    FillJob *job = (FillJob *)arg;
+    const Dictionary *dict = job->dict;
+    size_t block_size_bytes = dict->block_size;
+    for (size_t b = job->begin; b < job->end; ++b) {
+        uint32_t id = job->block_ids[b];
+        if (id >= (uint32_t)dict->size) {
+            job->bad_block = b;
+            break;
+        }
+        size_t offset = b * block_size_bytes;
+        size_t to_copy = block_size_bytes;
+        if (offset + to_copy > job->out_bytes) {
+            to_copy = job->out_bytes - offset;
+        }
+        memcpy(job->out + offset, dict_block(dict, (int)id), to_copy);
+    }
+    return NULL;
+}
+
+// 출력 파일을 mmap 하고 block_ids 를 thread 수만큼 나눠 각자 자기 구간을 채운다.
+// block 영역 [0, block_bytes) 를 thread 들이 나눠 채우고 tail literal 을 뒤에 붙인다.
+static int fill_output_parallel(const Dictionary *dict,
+                                const uint32_t *block_ids,
+                                size_t num_blocks,
+                                size_t block_bytes,
+                                const unsigned char *tail,
+                                size_t tail_bytes,
+                                const DdpHeader *hdr,
+                                const char *output_filename,
+                                int threads)
+{
+    size_t block_size_bytes = dict->block_size;
+    size_t out_bytes = num_blocks * block_size_bytes;
+    if (out_bytes > block_bytes) out_bytes = block_bytes;
+    size_t fill_blocks = (out_bytes + block_size_bytes - 1) / block_size_bytes;
+
+    unsigned char *out = NULL;
+    if (create_mapped_file(output_filename, out_bytes + tail_bytes, &out) != 0) {
+        return 1;
+    }
+    if (tail_bytes > 0) {
+        memcpy(out + out_bytes, tail, tail_bytes);
+    }
+
+    pthread_t tids[MAX_THREADS];
+    FillJob jobs[MAX_THREADS];
+    int nthreads = threads;
+    if ((size_t)nthreads > fill_blocks) nthreads = fill_blocks > 0 ? (int)fill_blocks : 1;
+    int started = 0;
+    int ret = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        jobs[t].dict = dict;
+        jobs[t].block_ids = block_ids;
+        jobs[t].out = out;
+        jobs[t].out_bytes = out_bytes;
+        jobs[t].begin = fill_blocks * (size_t)t / (size_t)nthreads;
+        jobs[t].end = fill_blocks * (size_t)(t + 1) / (size_t)nthreads;
+        jobs[t].bad_block = SIZE_MAX;
+        if (t == 0) continue;
+        if (pthread_create(&tids[t], NULL, fill_worker, &jobs[t]) != 0) {
+            fprintf(stderr, "Failed to create worker thread\n");
+            ret = 1;
+            break;
+        }
+        started = t;
+    }
+    if (ret == 0) {
+        fill_worker(&jobs[0]);
+    }
+    for (int t = 1; t <= started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+
+    for (int t = 0; ret == 0 && t <= started; ++t) {
+        if (jobs[t].bad_block != SIZE_MAX) {
+            size_t b = jobs[t].bad_block;
+            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", block_ids[b], b);
+            ret = 1;
+        }
+    }
+
+    // prefix 연산이라 역변환은 thread 들이 채운 뒤 한 번에 순서대로 한다
+    if (ret == 0 && hdr->transform != DDP_TRANSFORM_NONE) {
+        TransformState xf;
+        transform_init(&xf, hdr->transform, hdr->width_bytes);
+        transform_decode(&xf, out, (out_bytes + tail_bytes) / (size_t)hdr->width_bytes);
+    }
+
+    if (close_mapped_file(out, out_bytes + tail_bytes) != 0) {
+        ret = 1;
+    }
+    return ret;
+}
+
+// append 된 파일에서 마지막이 아닌 segment 의 tail literal 들. 복원하면 block 영역의
+// marks[k].at 바이트 뒤에 data + marks[k].offset 의 marks[k].bytes 가 끼어든다.
+typedef struct {
+    size_t at;
+    size_t offset;
+    size_t bytes;
+} TailMark;
+
+typedef struct {
+    unsigned char *data;
+    size_t bytes;
+    TailMark *marks;
+    size_t count;
+} MidTails;
+
+static void mid_tails_free(MidTails *m) {
+    free(m->data);
+    free(m->marks);
+    memset(m, 0, sizeof(*m));
+}
+
+static int mid_tails_add(MidTails *m, size_t at, const unsigned char *tail, size_t bytes) {
+    unsigned char *data = (unsigned char *)realloc(m->data, m->bytes + bytes);
+    TailMark *marks = data ? (TailMark *)realloc(m->marks, sizeof(TailMark) * (m->count + 1)) : NULL;
+    if (data) m->data = data;
+    if (!marks) {
+        fprintf(stderr, "Failed to allocate tail buffer\n");
+        return 0;
+    }
+    m->marks = marks;
+    memcpy(m->data + m->bytes, tail, bytes);
+    marks[m->count].at = at;
+    marks[m->count].offset = m->bytes;
+    marks[m->count].bytes = bytes;
+    m->bytes += bytes;
+    ++m->count;
+    return 1;
+}
+
+// 첫 segment 뒤에 append 된 segment 를 모두 읽어 dict/runs 뒤에 이어 붙이고
+// sample_count/num_blocks 에 더한다. 각 segment 의 tail 은 tail (block 하나 크기) 에 읽고,
+// 다음 segment 가 나오면 mid 로 옮긴다. 호출 시 *tail_bytes 는 첫 segment 의 tail 크기.
+static int read_segments(BinReader *r, const DdpHeader *hdr, Dictionary *dict,
+                         IdRuns *runs, size_t *sample_count, size_t *num_blocks,
+                         unsigned char *tail, size_t *tail_bytes, MidTails *mid)
+{
+    while (!br_at_eof(r)) {
+        SegmentHeader seg;
+        int st = read_segment_header(r, &seg);
+        if (st < 0) {
+            break;
+        }
+        if (st != 0) {
+            return 1;
+        }
+        if ((size_t)seg.sample_count < (size_t)seg.num_blocks * (size_t)hdr->block_size_samples) {
+            fprintf(stderr, "Invalid segment header\n");
+            return 1;
+        }
+        if (*tail_bytes > 0) {
+            if (!mid_tails_add(mid, *num_blocks * dict->block_size, tail, *tail_bytes)) {
+                return 1;
+            }
+            *tail_bytes = 0;
+        }
+        if (check_dict_added(r, hdr->codec, dict->size, seg.dict_added, dict->block_size) != 0) {
+            return 1;
+        }
+        unsigned char *dst = dict_append_raw(dict, (int)seg.dict_added);
+        if (!read_section_into(r, hdr->codec, dst, dict->block_size * (size_t)seg.dict_added)) {
+            fprintf(stderr, "Failed to read segment dictionary\n");
+            return 1;
+        }
+
+        DdpHeader view = segment_header_view(hdr, &seg, (uint32_t)dict->size);
+        IdRuns more;
+        if (!read_id_section(r, &view, &more)) {
+            return 1;
+        }
+        int ok = id_runs_append(runs, &more);
+        id_runs_free(&more);
+        if (!ok || tail_size(&view, tail_bytes) != 0) {
+            return 1;
+        }
+        if (!br_read(r, tail, *tail_bytes)) {
+            fprintf(stderr, "Failed to read tail literal\n");
+            return 1;
+        }
+        *sample_count += (size_t)seg.sample_count;
+        *num_blocks += (size_t)seg.num_blocks;
+    }
+    return 0;
+}
+
+// DDP_FLAG_CDC 파일 복원 (순차). chunk 길이로 dictionary offset 을 만든 뒤 id 순서로 이어 붙인다.
+static int decompress_cdc(BinReader *r, const DdpHeader *hdr, const char *output_filename)
+{
+    size_t width_bytes = (size_t)hdr->width_bytes;
+    size_t dict_size = (size_t)hdr->dict_size;
+    size_t out_bytes = (size_t)hdr->sample_count * width_bytes;
+
+    unsigned char *lens = (unsigned char *)malloc(sizeof(uint32_t) * dict_size + 1);
+    size_t *offsets = (size_t *)malloc(sizeof(size_t) * (dict_size + 1));
+    if (!lens || !offsets) {
+        fprintf(stderr, "Failed to allocate chunk length buffer\n");
+        free(lens);
+        free(offsets);
+        return 1;
+    }
+    if (!read_section_into(r, hdr->codec, lens, sizeof(uint32_t) * dict_size)) {
+        fprintf(stderr, "Failed to read chunk lengths\n");
+        free(lens);
+        free(offsets);
+        return 1;
+    }
+    offsets[0] = 0;
+    for (size_t i = 0; i < dict_size; ++i) {
+        size_t n = (size_t)load_u32_le(lens + i * 4) * width_bytes;
+        if (n == 0 || n > out_bytes) {
+            fprintf(stderr, "Invalid chunk length at dictionary entry %zu\n", i);
+            free(lens);
+            free(offsets);
+            return 1;
+        }
+        offsets[i + 1] = offsets[i] + n;
+    }
+    free(lens);
+
+    unsigned char *dict = (unsigned char *)malloc(offsets[dict_size] + 1);
+    if (!dict) {
+        fprintf(stderr, "Failed to allocate dictionary\n");
+        free(offsets);
+        return 1;
+    }
+    if (!read_section_into(r, hdr->codec, dict, offsets[dict_size])) {
+        fprintf(stderr, "Failed to read dictionary\n");
+        free(dict);
+        free(offsets);
+        return 1;
+    }
+
+    IdRuns runs;
+    if (!read_id_section(r, hdr, &runs)) {
+        free(dict);
+        free(offsets);
+        return 1;
+    }
+
+    unsigned char *out = (unsigned char *)malloc(out_bytes + 1);
+    int ok = out != NULL;
+    if (!ok) fprintf(stderr, "Failed to allocate output buffer\n");
+    size_t bytes_written = 0;
+    for (size_t i = 0; ok && i < runs.num_runs; ++i) {
+        uint32_t id = runs.ids[i];
+        if (id >= dict_size) {
+            fprintf(stderr, "Invalid dictionary id %u\n", id);
+            ok = 0;
+            break;
+        }
+        size_t n = offsets[id + 1] - offsets[id];
+        size_t run_len = runs.lens ? (size_t)runs.lens[i] : 1;
+        for (size_t k = 0; k < run_len; ++k) {
+            if (n > out_bytes - bytes_written) {
+                fprintf(stderr, "Chunks exceed sample_count\n");
+                ok = 0;
+                break;
+            }
+            memcpy(out + bytes_written, dict + offsets[id], n);
+            bytes_written += n;
+        }
+    }
+    if (ok && bytes_written != out_bytes) {
+        fprintf(stderr, "Chunks cover %zu of %zu bytes\n", bytes_written, out_bytes);
+        ok = 0;
+    }
+    id_runs_free(&runs);
+    free(dict);
+    free(offsets);
+    if (!ok) {
+        free(out);
+        return 1;
+    }
+
+    TransformState xf;
+    transform_init(&xf, hdr->transform, hdr->width_bytes);
+    transform_decode(&xf, out, out_bytes / width_bytes);
+    int ret = write_binary_file(output_filename, out, out_bytes);
+    free(out);
+    return ret;
+}
+
+// run 반복을 펼쳐 둘 scratch 크기와, 이 방식을 쓰는 최소 run 출력 크기
+#define REPEAT_BYTES (64u << 10)
+#define REPEAT_MIN_BYTES (4u << 10)
+
+// 출력 버퍼 없이 dictionary 항목을 가리키는 iovec 을 모아 writev 로 내보낸다.
+// 긴 run 만 scratch 에 한 번 펼쳐 두고 그 구간을 여러 번 가리킨다.
+static int write_runs_vectored(const Dictionary *dict, const IdRuns *runs,
+                               size_t block_bytes, const unsigned char *tail,
+                               size_t tail_bytes, const char *output_filename)
+{
+    size_t block_size_bytes = dict->block_size;
+    size_t repeat_blocks = REPEAT_BYTES / block_size_bytes;
+    unsigned char *repeat = NULL;
+    if (repeat_blocks >= 2) {
+        repeat = (unsigned char *)malloc(repeat_blocks * block_size_bytes);
+    }
+
+    VecWriter w;
+    if (vw_open(&w, output_filename) != 0) {
+        free(repeat);
+        return 1;
+    }
+
+    int ok = 1;
+    size_t bytes_written = 0;
+    size_t b = 0;
+    for (size_t r = 0; ok && r < runs->num_runs && bytes_written < block_bytes; ++r) {
+        uint32_t id = runs->ids[r];
+        if (id >= (uint32_t)dict->size) {
+            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", id, b);
+            ok = 0;
+            break;
+        }
+        const unsigned char *block = dict_block(dict, (int)id);
+        size_t run_len = runs->lens ? (size_t)runs->lens[r] : 1;
+        b += run_len;
+
+        size_t to_copy = block_size_bytes * run_len;
+        if (to_copy > block_bytes - bytes_written) {
+            to_copy = block_bytes - bytes_written;
+        }
+        if (repeat && run_len > 1 && to_copy >= REPEAT_MIN_BYTES) {
+            // scratch 는 다음 긴 run 에서 다시 쓰므로 여기서 내보낸다
+            size_t n = run_len < repeat_blocks ? run_len : repeat_blocks;
+            for (size_t k = 0; k < n; ++k) {
+                memcpy(repeat + k * block_size_bytes, block, block_size_bytes);
+            }
+            size_t span = n * block_size_bytes;
+            for (size_t done = 0; ok && done < to_copy; done += span) {
+                ok = vw_add(&w, repeat, to_copy - done < span ? to_copy - done : span);
+            }
+            ok = ok && vw_flush(&w) == 0;
+        } else {
+            for (size_t done = 0; ok && done < to_copy; done += block_size_bytes) {
+                size_t n = to_copy - done < block_size_bytes ? to_copy - done : block_size_bytes;
+                ok = vw_add(&w, block, n);
+            }
+        }
+        bytes_written += to_copy;
+    }
+    ok = ok && vw_add(&w, tail, tail_bytes);
+
+    int ret = vw_close(&w);
+    free(repeat);
+    if (ok && ret != 0) fprintf(stderr, "Failed to write output\n");
+    return (ok && ret == 0) ? 0 : 1;
+}
+
+void decompress_options_init(DecompressOptions *opts)
+{
+    memset(opts, 0, sizeof(*opts));
+    opts->threads = 1;
+}
+
+int decompress_file(const char *input_filename,
+                    const char *output_filename)
+{
+    DecompressOptions opts;
+    decompress_options_init(&opts);
+    return decompress_file_opts(input_filename, output_filename, &opts);
+}
+
+// 고정 block 파일 (stream/CDC 아님) 의 header 뒤를 읽는다. dict 는 block 크기로 초기화된
+// 빈 dictionary 로 받아 shared 항목과 dictionary section 을 채운다. tail 은 block 하나 크기.
+// 성공하면 runs 와 마지막 tail, 앞 segment 들의 tail (mid), 복원할 block 영역 크기
+// (block_bytes) 를 돌려준다. 실패 시 1.
+static int load_blocks(BinReader *r, const DdpHeader *hdr, const SharedDict *shared,
+                       Dictionary *dict, IdRuns *runs, unsigned char *tail,
+                       size_t *block_bytes, size_t *tail_bytes, MidTails *mid) {
+    size_t sample_count = (size_t)hdr->sample_count;
+    size_t dict_size = (size_t)hdr->dict_size;
+    size_t num_blocks = (size_t)hdr->num_blocks;
+    size_t block_size_bytes = dict->block_size;
+    memset(mid, 0, sizeof(*mid));
+
+    size_t base_size = 0;
+    if (hdr->flags & DDP_FLAG_SHARED) {
+        unsigned char ref[DDP_SHARED_REF_SIZE];
+        if (!br_read(r, ref, sizeof(ref))) {
+            fprintf(stderr, "Failed to read shared dictionary reference\n");
+            return 1;
+        }
+        if (check_shared_ref(ref, hdr, shared) != 0) {
+            return 1;
+        }
+        base_size = (size_t)shared->base_size;
+    }
+
+    if (check_dict_added(r, hdr->codec, (int)base_size, dict_size - base_size, block_size_bytes) != 0) {
+        return 1;
+    }
+
+    // dictionary section 은 arena 에 그대로 읽어 들인다 (복원에는 index 가 필요 없음)
+    unsigned char *dict_dst = dict_append_raw(dict, (int)dict_size);
+    if (base_size > 0) {
+        memcpy(dict_dst, shared->dict.blocks, block_size_bytes * base_size);
+    }
+    if (!read_section_into(r, hdr->codec, dict_dst + block_size_bytes * base_size,
+                           block_size_bytes * (dict_size - base_size))) {
+        fprintf(stderr, "Failed to read dictionary\n");
+        return 1;
+    }
+
+    if (!read_id_section(r, hdr, runs)) {
+        return 1;
+    }
+
+    *tail_bytes = 0;
+    int ok = tail_size(hdr, tail_bytes) == 0;
+    if (ok && !br_read(r, tail, *tail_bytes)) {
+        fprintf(stderr, "Failed to read tail literal\n");
+        ok = 0;
+    }
+    if (ok && (hdr->flags & DDP_FLAG_SEGMENTS) &&
+        read_segments(r, hdr, dict, runs, &sample_count, &num_blocks,
+                      tail, tail_bytes, mid) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        id_runs_free(runs);
+        mid_tails_free(mid);
+        return 1;
+    }
+
+    // block 영역은 tail 들을 뺀 나머지. 예전 파일은 sample_count 로 잘라낸다.
+    *block_bytes = sample_count * (size_t)hdr->width_bytes - mid->bytes - *tail_bytes;
+    if (*block_bytes > num_blocks * block_size_bytes) {
+        *block_bytes = num_blocks * block_size_bytes;
+    }
+    return 0;
+}
+
+// run 을 block 영역 block_bytes 만큼 펼치고 mid 의 tail 을 제자리에, 마지막 tail 을 끝에
+// 붙여 out 에 쓴 뒤 역변환한다. out 은 block_bytes + mid->bytes + tail_bytes. 잘못된 id 면 1.
+static int fill_runs(const Dictionary *dict, const IdRuns *runs, size_t block_bytes,
+                     const MidTails *mid, const unsigned char *tail, size_t tail_bytes,
+                     const DdpHeader *hdr, unsigned char *out) {
+    size_t block_size_bytes = dict->block_size;
+    size_t bytes_written = 0;  // block 영역 기준
+    size_t out_pos = 0;
+    size_t k = 0;
+    size_t b = 0;
+    for (size_t r = 0; r < runs->num_runs && bytes_written < block_bytes; ++r) {
+        // segment 의 run 은 서로 이어지지 않으므로 tail 자리는 run 경계에 온다
+        for (; k < mid->count && mid->marks[k].at <= bytes_written; ++k) {
+            memcpy(out + out_pos, mid->data + mid->marks[k].offset, mid->marks[k].bytes);
+            out_pos += mid->marks[k].bytes;
+        }
+        uint32_t id = runs->ids[r];
+        if (id >= (uint32_t)dict->size) {
+            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", id, b);
+            return 1;
+        }
+        const unsigned char *block = dict_block(dict, (int)id);
+        size_t run_len = runs->lens ? (size_t)runs->lens[r] : 1;
+        b += run_len;
+
+        size_t to_copy = block_size_bytes * run_len;
+        if (bytes_written + to_copy > block_bytes) {
+            to_copy = block_bytes - bytes_written;
+        }
+        unsigned char *dst = out + out_pos;
+        size_t first = to_copy < block_size_bytes ? to_copy : block_size_bytes;
+        memcpy(dst, block, first);
+        // run 의 나머지는 이미 채운 부분을 두 배씩 복사해 넓힌다
+        for (size_t filled = first; filled < to_copy; ) {
+            size_t n = filled;
+            if (n > to_copy - filled) n = to_copy - filled;
+            memcpy(dst + filled, dst, n);
+            filled += n;
+        }
+        bytes_written += to_copy;
+        out_pos += to_copy;
+    }
+    for (; k < mid->count; ++k) {
+        memcpy(out + out_pos, mid->data + mid->marks[k].offset, mid->marks[k].bytes);
+        out_pos += mid->marks[k].bytes;
+    }
+    memcpy(out + out_pos, tail, tail_bytes);
+    out_pos += tail_bytes;
+
+    TransformState xf;
+    transform_init(&xf, hdr->transform, hdr->width_bytes);
+    transform_decode(&xf, out, out_pos / (size_t)hdr->width_bytes);
+    return 0;
+}
+
+int decompress_file_opts(const char *input_filename,
+                         const char *output_filename,
+                         const DecompressOptions *opts)
+{
+    if (opts->threads < 1 || opts->threads > MAX_THREADS) {
+        fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    if (is_segmented_file(input_filename)) {
+        return decompress_segmented(input_filename, output_filename, opts);
+    }
+    if (is_channel_file(input_filename)) {
+        // channel 마다 thread 하나로 복원하므로 -j 는 쓰지 않는다
+        return decompress_channels(input_filename, output_filename);
+    }
+
+    BinReader r;
+    if (open_reader(input_filename, &r) != 0) {
+        return 1;
+    }
+
+    DdpHeader hdr;
+    if (read_header(&r, &hdr) != 0) {
+        close_reader(&r);
+        return 1;
+    }
+
+    if (hdr.flags & DDP_FLAG_STREAM) {
+        int ret = decompress_stream(&r, &hdr, output_filename);
+        close_reader(&r);
+        return ret;
+    }
+    if (hdr.flags & DDP_FLAG_CDC) {
+        int ret = decompress_cdc(&r, &hdr, output_filename);
+        close_reader(&r);
+        return ret;
+    }
+
+    size_t num_blocks = (size_t)hdr.num_blocks;
+    size_t block_size_bytes = (size_t)hdr.block_size_samples * (size_t)hdr.width_bytes;
+
+    unsigned char *tail = (unsigned char *)malloc(block_size_bytes);
+    if (!tail) {
+        fprintf(stderr, "Failed to allocate tail buffer\n");
+        close_reader(&r);
+        return 1;
+    }
+    Dictionary dict;
+    dict_init(&dict, block_size_bytes);
+    IdRuns runs;
+    MidTails mid;
+    size_t block_bytes = 0;
+    size_t tail_bytes = 0;
+    int ret = load_blocks(&r, &hdr, opts->shared, &dict, &runs, tail, &block_bytes, &tail_bytes,
+                          &mid);
+    close_reader(&r);
+    if (ret != 0) {
+        free(tail);
+        dict_free(&dict);
+        return 1;
+    }
+    // 이어 붙인 segment 가 있으면 header 값보다 많다
+    num_blocks = (block_bytes + block_size_bytes - 1) / block_size_bytes;
+
+    // 앞 segment 에 tail 이 있으면 block 이 출력의 block 격자에 맞지 않아 버퍼에 순서대로 모은다
+    if (mid.count == 0 && opts->threads > 1) {
+        // thread 별 구간 분할은 block 단위이므로 run 은 먼저 펼친다
+        uint32_t *block_ids = runs.ids;
+        if (runs.lens) {
+            size_t total = 0;
+            for (size_t i = 0; i < runs.num_runs; ++i) total += runs.lens[i];
+            block_ids = (uint32_t *)malloc(sizeof(uint32_t) * (total + 1));
+            if (!block_ids) {
+                fprintf(stderr, "Failed to allocate block_ids\n");
+                free(tail);
+                id_runs_free(&runs);
+                mid_tails_free(&mid);
+                dict_free(&dict);
+                return 1;
+            }
+            size_t b = 0;
+            for (size_t i = 0; i < runs.num_runs; ++i) {
+                for (uint32_t k = 0; k < runs.lens[i]; ++k) {
+                    block_ids[b++] = runs.ids[i];
+                }
+            }
+        }
+        ret = fill_output_parallel(&dict, block_ids, num_blocks, block_bytes,
+                                   tail, tail_bytes, &hdr, output_filename, opts->threads);
+        if (block_ids != runs.ids) free(block_ids);
+    } else if (mid.count == 0 && hdr.transform == DDP_TRANSFORM_NONE) {
+        ret = write_runs_vectored(&dict, &runs, block_bytes, tail, tail_bytes,
+                                  output_filename);
+    } else {
+        // 변환된 파일은 역변환이 앞 샘플에 의존하므로 출력 전체를 버퍼에 모은다
+        size_t out_bytes = block_bytes + mid.bytes + tail_bytes;
+        unsigned char *out = (unsigned char *)malloc(out_bytes + 1);
+        if (!out) {
+            fprintf(stderr, "Failed to allocate output buffer\n");
+            ret = 1;
+        } else {
+            ret = fill_runs(&dict, &runs, block_bytes, &mid, tail, tail_bytes, &hdr, out);
+            if (ret == 0) {
+                ret = write_binary_file(output_filename, out, out_bytes);
+            }
+            free(out);
+        }
+    }
+
+    free(tail);
+    id_runs_free(&runs);
+    mid_tails_free(&mid);
+    dict_free(&dict);
+    return ret;
+}
+
+// mmap 한 파일 안의 id 배열 하나 (DDP1: u32 LE, DDP2: bits 폭 packing)
+typedef struct {
+    const unsigned char *p;
+    size_t n;
+    size_t nbytes;
+    int version;
+    int bits;
+} IdArrayView;
+
+static void id_view_init(IdArrayView *v, const unsigned char *p, size_t n, int version, int bits) {
+    v->p = p;
+    v->n = n;
+    v->version = version;
+    v->bits = bits;
+    v->nbytes = (version == 2) ? packed_ids_size(n, bits) : n * 4;
+}
+
+static uint32_t id_view_get(const IdArrayView *v, size_t i) {
+    if (v->version == 2) {
+        return packed_id_at(v->p, v->nbytes, v->bits, i);
+    }
+    return load_u32_le(v->p + i * 4);
+}
+
+// mmap 한 파일 안의 segment 하나. block/id 번호는 파일 전체 기준.
+typedef struct {
+    size_t first_block;
+    size_t num_blocks;
+    size_t first_byte;   // 복원 결과에서 이 segment 가 시작하는 위치
+    size_t block_bytes;  // block 영역 크기 (tail 은 그 뒤에 이어진다)
+    uint32_t first_id;
+    uint32_t dict_count;
+    const unsigned char *dict;
+    IdArrayView ids;
+    IdArrayView lens;  // RLE 가 아니면 비어 있음
+    size_t num_runs;
+    const unsigned char *run_index;  // DDP_FLAG_RUN_INDEX 가 없으면 NULL
+    size_t run_index_n;
+    const unsigned char *tail;
+    size_t tail_bytes;
+} SegmentView;
+
+// offset 에서 시작하는 dictionary + id section 의 위치를 잡는다. view->dict_size 는
+// 이 segment 까지의 누적 크기. 성공 시 *end 에 section 끝 위치.
+static int map_segment(const unsigned char *file, size_t file_size, size_t offset,
+                       const DdpHeader *view, uint32_t first_id, SegmentView *seg,
+                       size_t *end)
+{
+    size_t block_size_bytes = (size_t)view->block_size_samples * (size_t)view->width_bytes;
+    size_t num_blocks = (size_t)view->num_blocks;
+    int id_bits = id_bits_for(view->dict_size);
+
+    seg->num_blocks = num_blocks;
+    seg->first_id = first_id;
+    seg->dict_count = view->dict_size - first_id;
+    seg->dict = file + offset;
+
+    size_t ids_offset = offset + (size_t)seg->dict_count * block_size_bytes;
+    if (ids_offset > file_size) {
+        fprintf(stderr, "Truncated dictionary section\n");
+        return 1;
+    }
+    size_t runs_offset = ids_offset;
+    size_t index_bytes = 0;
+    seg->num_runs = num_blocks;
+    seg->run_index = NULL;
+    seg->run_index_n = 0;
+    if (view->flags & DDP_FLAG_RLE) {
+        size_t head = (view->version == 2) ? 8 : 4;
+        if (ids_offset + head > file_size) {
+            fprintf(stderr, "Truncated run-length header\n");
+            return 1;
+        }
+        seg->num_runs = load_u32_le(file + ids_offset);
+        int len_bits = (view->version == 2) ? (int)load_u32_le(file + ids_offset + 4) : 32;
+        if (seg->num_runs > num_blocks || len_bits > 32) {
+            fprintf(stderr, "Invalid run-length header\n");
+            return 1;
+        }
+        runs_offset = ids_offset + head;
+        id_view_init(&seg->ids, file + runs_offset, seg->num_runs, view->version, id_bits);
+        id_view_init(&seg->lens, file + runs_offset + seg->ids.nbytes, seg->num_runs,
+                     view->version, len_bits);
+        if (view->flags & DDP_FLAG_RUN_INDEX) {
+            index_bytes = run_index_size(seg->num_runs);
+            size_t index_offset = runs_offset + seg->ids.nbytes + seg->lens.nbytes;
+            if (index_offset + index_bytes > file_size) {
+                fprintf(stderr, "Truncated run index\n");
+                return 1;
+            }
+            seg->run_index = file + index_offset;
+            seg->run_index_n = index_bytes / 4;
+            // 나머지 항목은 segment_seek 가 읽는 것만 확인한다 (파일 크기와 무관한 비용)
+            if (seg->run_index_n > 0 && load_u32_le(seg->run_index) != 0) {
+                fprintf(stderr, "Invalid run index\n");
+                return 1;
+            }
+        }
+    } else {
+        id_view_init(&seg->ids, file + ids_offset, num_blocks, view->version, id_bits);
+        id_view_init(&seg->lens, NULL, 0, view->version, 0);
+    }
+    size_t tail_offset = runs_offset + seg->ids.nbytes + seg->lens.nbytes + index_bytes;
+    if (tail_size(view, &seg->tail_bytes) != 0) {
+        return 1;
+    }
+    seg->tail = file + tail_offset;
+    *end = tail_offset + seg->tail_bytes;
+    if (*end > file_size) {
+        fprintf(stderr, "Truncated file: sections end at %zu, file has %zu bytes\n",
+                *end, file_size);
+        return 1;
+    }
+    return 0;
+}
+
+// segment 안의 local 번째 block 을 포함하는 run 과 그 run 에 남은 block 수.
+// run_index 가 local 과 맞지 않으면 메시지를 출력하고 1.
+static int segment_seek(const SegmentView *seg, size_t local, size_t *run, size_t *run_left)
+{
+    if (seg->lens.n == 0) {
+        *run = local;
+        *run_left = 1;
+        return 0;
+    }
+    if (local >= seg->num_blocks) {
+        // tail 만 읽는 구간이거나 빈 segment
+        *run = seg->num_runs;
+        *run_left = 1;
+        return 0;
+    }
+    // run_index 가 있으면 local 을 넘지 않는 마지막 항목에서 걷기 시작한다. 읽은 항목 k 와
+    // 다음 항목 사이에 local 이 있어야 하고, 걷는 run 은 그 두 항목 사이의 것뿐이다.
+    size_t first = 0;
+    size_t last = seg->num_runs;
+    size_t run_start = 0;
+    if (seg->run_index_n > 0) {
+        size_t lo = 0;
+        size_t hi = seg->run_index_n;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (load_u32_le(seg->run_index + mid * 4) <= local) lo = mid;
+            else hi = mid;
+        }
+        run_start = load_u32_le(seg->run_index + lo * 4);
+        size_t next = lo + 1 < seg->run_index_n
+                    ? load_u32_le(seg->run_index + (lo + 1) * 4) : seg->num_blocks;
+        if (run_start > local || local >= next) {
+            fprintf(stderr, "Invalid run index\n");
+            return 1;
+        }
+        first = lo * RUN_INDEX_STRIDE;
+        if (last - first > RUN_INDEX_STRIDE) last = first + RUN_INDEX_STRIDE;
+    }
+    for (*run = first; *run < last; ++*run) {
+        size_t len = (size_t)id_view_get(&seg->lens, *run) + 1;
+        if (local < run_start + len) {
+            *run_left = run_start + len - local;
+            return 0;
+        }
+        run_start += len;
+    }
+    if (seg->run_index_n > 0) {
+        fprintf(stderr, "Invalid run index\n");
+        return 1;
+    }
+    *run = seg->num_runs;
+    *run_left = 1;
+    return 0;
+}
+
+// id 가 속한 segment 의 dictionary 에서 block 위치를 찾는다 (segment 는 first_id 순).
+static const unsigned char *segment_dict_block(const SegmentView *segs, size_t nsegs,
+                                               uint32_t id, size_t block_size_bytes)
+{
+    size_t lo = 0;
+    size_t hi = nsegs;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (segs[mid].first_id <= id) lo = mid;
+        else hi = mid;
+    }
+    return segs[lo].dict + (size_t)(id - segs[lo].first_id) * block_size_bytes;
+}
+
+// segment s 의 block 영역 [from, to) (segment 기준 byte) 를 out 에 복사한다. 실패 시 1.
+static int copy_segment_blocks(const SegmentView *segs, size_t s, size_t from, size_t to,
+                               size_t block_size_bytes, unsigned char *out)
+{
+    const SegmentView *seg = &segs[s];
+    size_t b = from / block_size_bytes;
+    size_t run = 0;
+    size_t run_left = 1;
+    if (segment_seek(seg, b, &run, &run_left) != 0) {
+        return 1;
+    }
+    for (size_t pos = from; pos < to; ) {
+        if (run >= seg->num_runs) {
+            fprintf(stderr, "Block ids end before block %zu\n", seg->first_block + b);
+            return 1;
+        }
+        uint32_t id = id_view_get(&seg->ids, run);
+        if (id >= seg->first_id + seg->dict_count) {
+            fprintf(stderr, "Invalid dictionary id %u at block %zu\n", id, seg->first_block + b);
+            return 1;
+        }
+        const unsigned char *block = segment_dict_block(segs, s + 1, id, block_size_bytes);
+        size_t in_block = pos - b * block_size_bytes;
+        size_t n = block_size_bytes - in_block;
+        if (n > to - pos) n = to - pos;
+        memcpy(out, block + in_block, n);
+        out += n;
+        pos += n;
+        ++b;
+        if (--run_left == 0) {
+            ++run;
+            run_left = seg->lens.n > 0 && run < seg->num_runs
+                     ? (size_t)id_view_get(&seg->lens, run) + 1 : 1;
+        }
+    }
+    return 0;
+}
+
+int decompress_range(const char *input_filename,
+                     size_t start_sample,
+                     size_t count,
+                     const char *output_filename)
+{
+    if (is_segmented_file(input_filename)) {
+        return decompress_segmented_range(input_filename, start_sample, count, output_filename);
+    }
+    if (is_channel_file(input_filename)) {
+        // channel 마다 따로 압축되어 있어 interleave 된 샘플 위치를 바로 찾을 수 없다
+        fprintf(stderr, "Random access is not supported for multi-channel files\n");
+        return 1;
+    }
+    const unsigned char *file = NULL;
+    size_t file_size = 0;
+    if (map_binary_file(input_filename, &file, &file_size) != 0) {
+        return 1;
+    }
+
+    DdpHeader hdr;
+    if (file_size < DDP_HEADER_SIZE) {
+        fprintf(stderr, "Failed to read header\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (parse_header(file, &hdr) != 0) {
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (hdr.flags & DDP_FLAG_STREAM) {
+        fprintf(stderr, "Random access is not supported for stream-format files\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (hdr.transform != DDP_TRANSFORM_NONE) {
+        // delta/xor 는 앞의 모든 샘플에 의존하므로 구간만 복원할 수 없다
+        fprintf(stderr, "Random access is not supported for transformed files\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (hdr.flags & DDP_FLAG_SHARED) {
+        fprintf(stderr, "Random access is not supported for files that use a shared dictionary\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (hdr.flags & DDP_FLAG_CDC) {
+        // chunk 길이가 가변이라 샘플 위치에서 chunk 를 바로 찾을 수 없다
+        fprintf(stderr, "Random access is not supported for content-defined chunking files\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    if (hdr.codec != DDP_CODEC_NONE) {
+        // 압축된 section 은 통째로 풀어야 하므로 block 위치를 바로 계산할 수 없다
+        fprintf(stderr, "Random access is not supported for entropy-coded files\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+
+    size_t width_bytes = (size_t)hdr.width_bytes;
+    size_t block_size_samples = (size_t)hdr.block_size_samples;
+    size_t block_size_bytes = block_size_samples * width_bytes;
+
+    // section 위치는 header 와 segment header 만으로 계산된다
+    size_t nsegs = 1;
+    size_t cap_segs = 4;
+    SegmentView *segs = (SegmentView *)malloc(sizeof(SegmentView) * cap_segs);
+    if (!segs) {
+        fprintf(stderr, "Failed to allocate segment table\n");
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+    size_t offset = 0;
+    int ret = map_segment(file, file_size, DDP_HEADER_SIZE, &hdr, 0, &segs[0], &offset);
+    segs[0].first_block = 0;
+    segs[0].first_byte = 0;
+    size_t num_blocks = (size_t)hdr.num_blocks;
+    size_t seg_samples = (size_t)hdr.sample_count;
+    uint32_t dict_size = hdr.dict_size;
+    for (;;) {
+        // block 영역은 tail 을 뺀 나머지. 예전 파일은 sample_count 로 잘라낸다.
+        SegmentView *cur = &segs[nsegs - 1];
+        if (ret == 0) {
+            cur->block_bytes = cur->num_blocks * block_size_bytes;
+            if (seg_samples * width_bytes - cur->tail_bytes < cur->block_bytes) {
+                cur->block_bytes = seg_samples * width_bytes - cur->tail_bytes;
+            }
+        }
+        if (ret != 0 || !(hdr.flags & DDP_FLAG_SEGMENTS) || offset >= file_size) {
+            break;
+        }
+        SegmentHeader sh;
+        size_t avail = file_size - offset;
+        int st = parse_segment_header(file + offset, avail < DDP_SEGMENT_HEADER_SIZE
+                                                     ? avail : DDP_SEGMENT_HEADER_SIZE, &sh);
+        if (st < 0) {
+            break;
+        }
+        if (st != 0) {
+            ret = 1;
+            break;
+        }
+        if (sh.dict_added > UINT32_MAX - dict_size ||
+            (size_t)sh.sample_count < (size_t)sh.num_blocks * block_size_samples) {
+            fprintf(stderr, "Invalid segment header\n");
+            ret = 1;
+            break;
+        }
+        if (nsegs == cap_segs) {
+            cap_segs *= 2;
+            SegmentView *grown = (SegmentView *)realloc(segs, sizeof(SegmentView) * cap_segs);
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate segment table\n");
+                ret = 1;
+                break;
+            }
+            segs = grown;
+        }
+        DdpHeader view = segment_header_view(&hdr, &sh, dict_size + sh.dict_added);
+        const SegmentView *prev = &segs[nsegs - 1];
+        segs[nsegs].first_block = num_blocks;
+        segs[nsegs].first_byte = prev->first_byte + prev->block_bytes + prev->tail_bytes;
+        ret = map_segment(file, file_size, offset + DDP_SEGMENT_HEADER_SIZE, &view,
+                          dict_size, &segs[nsegs], &offset);
+        dict_size += sh.dict_added;
+        num_blocks += (size_t)sh.num_blocks;
+        seg_samples = (size_t)sh.sample_count;
+        ++nsegs;
+    }
+    if (ret != 0) {
+        free(segs);
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+
+    const SegmentView *last = &segs[nsegs - 1];
+    size_t sample_count = (last->first_byte + last->block_bytes + last->tail_bytes) / width_bytes;
+    if (start_sample > sample_count || count > sample_count - start_sample) {
+        fprintf(stderr, "Range [%zu, %zu) exceeds sample_count %zu\n",
+                start_sample, start_sample + count, sample_count);
+        free(segs);
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+
+    size_t out_bytes = count * width_bytes;
+    unsigned char *out = (unsigned char *)malloc(out_bytes > 0 ? out_bytes : 1);
+    if (!out) {
+        fprintf(stderr, "Failed to allocate output buffer\n");
+        free(segs);
+        unmap_binary_file(file, file_size);
+        return 1;
+    }
+
+    // segment 마다 block 영역과 tail 을 차례로 잘라 붙인다
+    size_t byte_pos = start_sample * width_bytes;  // 원본 기준 현재 위치
+    size_t byte_end = byte_pos + out_bytes;
+    unsigned char *dst = out;
+    size_t s = 0;
+    while (s + 1 < nsegs && segs[s + 1].first_byte <= byte_pos) ++s;
+    while (ret == 0 && byte_pos < byte_end) {
+        const SegmentView *seg = &segs[s];
+        size_t local = byte_pos - seg->first_byte;
+        size_t stop = byte_end - seg->first_byte;
+        if (local < seg->block_bytes) {
+            if (stop > seg->block_bytes) stop = seg->block_bytes;
+            ret = copy_segment_blocks(segs, s, local, stop, block_size_bytes, dst);
+        } else {
+            if (stop > seg->block_bytes + seg->tail_bytes) stop = seg->block_bytes + seg->tail_bytes;
+            memcpy(dst, seg->tail + (local - seg->block_bytes), stop - local);
+            ++s;
+        }
+        dst += stop - local;
+        byte_pos += stop - local;
+    }
 
+    if (ret == 0) {
+        ret = write_binary_file(output_filename, out, out_bytes);
+    }
+    free(out);
+    free(segs);
+    unmap_binary_file(file, file_size);
     return ret;
 }
+
+int ddp_context_init(DdpContext *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    return bw_init_mem(&ctx->out);
+}
+
+void ddp_context_free(DdpContext *ctx)
+{
+    dict_free(&ctx->dict);
+    dict_free(&ctx->blocks);
+    free(ctx->ids);
+    free(ctx->tail);
+    bw_free(&ctx->out);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+// 필요한 크기보다 작을 때만 키운다. 실패 시 1.
+static int ctx_reserve(DdpContext *ctx, size_t num_ids, size_t tail_bytes) {
+    if (num_ids > ctx->ids_cap) {
+        uint32_t *ids = (uint32_t *)realloc(ctx->ids, sizeof(uint32_t) * num_ids);
+        if (!ids) {
+            fprintf(stderr, "Failed to allocate block_ids\n");
+            return 1;
+        }
+        ctx->ids = ids;
+        ctx->ids_cap = num_ids;
+    }
+    if (tail_bytes > ctx->tail_cap) {
+        unsigned char *tail = (unsigned char *)realloc(ctx->tail, tail_bytes);
+        if (!tail) {
+            fprintf(stderr, "Failed to allocate tail buffer\n");
+            return 1;
+        }
+        ctx->tail = tail;
+        ctx->tail_cap = tail_bytes;
+    }
+    return 0;
+}
+
+// block 크기가 바뀌었을 때만 dictionary 를 새로 만든다.
+static void ctx_dict(Dictionary *dict, size_t block_size_bytes) {
+    if (dict->block_size != block_size_bytes) {
+        dict_free(dict);
+        dict_init(dict, block_size_bytes);
+    }
+}
+
+int ddp_compress_buf(DdpContext *ctx, const void *src, size_t nbytes,
+                     int width_bytes, int block_size_samples, const CompressOptions *opts,
+                     const unsigned char **out, size_t *out_len)
+{
+    CompressOptions defaults;
+    if (!opts) {
+        compress_options_init(&defaults);
+        opts = &defaults;
+    }
+    if (check_compress_args(width_bytes, &block_size_samples, opts) != 0) {
+        return 1;
+    }
+    if (opts->stream || opts->cdc || opts->segment_blocks > 0) {
+        fprintf(stderr, "Buffer compression does not support stream mode, content-defined chunking or segments\n");
+        return 1;
+    }
+    const unsigned char *data = (const unsigned char *)src;
+    size_t total_samples = nbytes / (size_t)width_bytes;
+    if (total_samples == 0 || total_samples > UINT32_MAX) {
+        fprintf(stderr, total_samples ? "Input too large for the DDP header\n"
+                                      : "Input buffer too small\n");
+        return 1;
+    }
+
+    if (block_size_samples == 0) {
+        size_t n = total_samples < AUTO_SAMPLE_BYTES / (size_t)width_bytes
+                       ? total_samples : AUTO_SAMPLE_BYTES / (size_t)width_bytes;
+        unsigned char *buf = (unsigned char *)malloc(n * (size_t)width_bytes);
+        if (!buf) {
+            fprintf(stderr, "Failed to allocate sample buffer\n");
+            return 1;
+        }
+        memcpy(buf, data, n * (size_t)width_bytes);
+        double cost = 0.0;
+        block_size_samples = pick_block_size(buf, n, width_bytes, opts, &cost);
+        free(buf);
+    }
+
+    size_t num_blocks = total_samples / (size_t)block_size_samples;
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+    if (ctx_reserve(ctx, num_blocks + 1, block_size_bytes) != 0) {
+        return 1;
+    }
+
+    Dictionary dict;
+    int base_size = 0;
+    if (opts->shared) {
+        dict = opts->shared->dict;
+        base_size = opts->shared->base_size;
+    } else {
+        ctx_dict(&ctx->dict, block_size_bytes);
+        dict = ctx->dict;
+    }
+
+    DdpHeader hdr;
+    size_t tail_bytes = 0;
+    bw_reset(&ctx->out);
+    int ret = encode_blocks(&dict, data, total_samples, width_bytes, block_size_samples,
+                            opts, 0, ctx->ids, ctx->tail, &hdr, &tail_bytes, NULL);
+    if (ret == 0) {
+        ret = write_blocks(&ctx->out, &hdr, opts, &dict, base_size, ctx->ids,
+                           ctx->tail, tail_bytes);
+    }
+
+    // 항목만 지우고 arena 와 index 크기는 다음 호출을 위해 남긴다
+    if (opts->shared) {
+        if (release_dict(&dict, opts) != 0) ret = 1;
+    } else {
+        if (dict_truncate(&dict, 0) != 0) ret = 1;
+        ctx->dict = dict;
+    }
+    if (ret != 0) {
+        return 1;
+    }
+    *out = ctx->out.buf;
+    *out_len = ctx->out.len;
+    return 0;
+}
+
+int ddp_decompress_buf(DdpContext *ctx, const void *src, size_t nbytes,
+                       const SharedDict *shared, const unsigned char **out, size_t *out_len)
+{
+    BinReader r;
+    br_init_mem(&r, (const unsigned char *)src, nbytes);
+    DdpHeader hdr;
+    if (read_header(&r, &hdr) != 0) {
+        return 1;
+    }
+    if (hdr.flags & (DDP_FLAG_STREAM | DDP_FLAG_CDC)) {
+        fprintf(stderr, "Buffer decompression does not support stream or CDC data\n");
+        return 1;
+    }
+
+    size_t block_size_bytes = (size_t)hdr.block_size_samples * (size_t)hdr.width_bytes;
+    if (ctx_reserve(ctx, 0, block_size_bytes) != 0) {
+        return 1;
+    }
+    ctx_dict(&ctx->blocks, block_size_bytes);
+    ctx->blocks.size = 0;
+
+    IdRuns runs;
+    MidTails mid;
+    size_t block_bytes = 0;
+    size_t tail_bytes = 0;
+    if (load_blocks(&r, &hdr, shared, &ctx->blocks, &runs, ctx->tail,
+                    &block_bytes, &tail_bytes, &mid) != 0) {
+        ctx->blocks.size = 0;
+        return 1;
+    }
+
+    bw_reset(&ctx->out);
+    unsigned char *dst = bw_reserve(&ctx->out, block_bytes + mid.bytes + tail_bytes);
+    int ret = 1;
+    if (!dst) {
+        fprintf(stderr, "Failed to allocate output buffer\n");
+    } else {
+        ret = fill_runs(&ctx->blocks, &runs, block_bytes, &mid, ctx->tail, tail_bytes, &hdr, dst);
+    }
+    id_runs_free(&runs);
+    mid_tails_free(&mid);
+    ctx->blocks.size = 0;
+    if (ret != 0) {
+        return 1;
+    }
+    *out = ctx->out.buf;
+    *out_len = ctx->out.len;
+    return 0;
+}
@@ -1,17 +1,212 @@
 #include "../include/dictionary.h"
+#include "../include/stats.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define INITIAL_CAPACITY 16
+#define INITIAL_TABLE_SIZE 64
+
+#define HASH_K1 0x9E3779B97F4A7C15ULL
+#define HASH_K2 0xC2B2AE3D27D4EB4FULL
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 1..7 바이트를 0 으로 채운 word 로 읽는다 (memcpy(&w, p, n) 과 같은 값). little-endian 이면
+// 앞/뒤에서 겹치게 두 번 load 해서 합치므로 n 이 상수가 아니어도 memcpy 호출이 없다.
+static inline __attribute__((always_inline)) uint64_t load_tail(const unsigned char *p, size_t n)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (n >= 4)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + n - 4, 4);
+        return (uint64_t)lo | ((uint64_t)hi << (8 * (n - 4)));
+    }
+    if (n >= 2)
+    {
+        uint16_t lo, hi;
+        memcpy(&lo, p, 2);
+        memcpy(&hi, p + n - 2, 2);
+        return (uint64_t)lo | ((uint64_t)hi << (8 * (n - 2)));
+    }
+    return p[0];
+#else
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    return w;
+#endif
+}
+
+// 8바이트 단위로 읽어 섞는 64-bit fingerprint (마지막 word 는 0 padding).
+// 모든 hash kernel 이 이 정의를 공유하므로 kernel 과 무관하게 같은 값이 나온다.
+static inline __attribute__((always_inline)) uint64_t hash_bytes_inline(const unsigned char *p, size_t n)
+{
+    uint64_t h = HASH_K1 ^ ((uint64_t)n * HASH_K2);
+    while (n >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = rotl64(h ^ (w * HASH_K2), 31) * HASH_K1;
+        p += 8;
+        n -= 8;
+    }
+    if (n > 0)
+    {
+        uint64_t w = load_tail(p, n);
+        h = rotl64(h ^ (w * HASH_K2), 31) * HASH_K1;
+    }
+    return mix64(h);
+}
+
+// block 비교 kernel. n 이 상수로 inline 되면 분기가 모두 사라지고
+// 8바이트 이하는 load 한두 번, 16/32/64 바이트는 SSE2 비교 (없으면 u64 loop) 가 된다.
+#ifdef __SSE2__
+static inline __attribute__((always_inline)) __m128i xor_16(const unsigned char *a, const unsigned char *b)
+{
+    return _mm_xor_si128(_mm_loadu_si128((const __m128i *)a),
+                         _mm_loadu_si128((const __m128i *)b));
+}
+
+static inline __attribute__((always_inline)) int is_zero_16(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+static inline __attribute__((always_inline)) int block_eq_inline(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    if (n == 1)
+        return a[0] == b[0];
+    if (n <= 3)
+    {
+        // 2, 3 바이트: 앞/뒤에서 겹치게 u16 두 번
+        uint16_t x0, y0, x1, y1;
+        memcpy(&x0, a, 2);
+        memcpy(&y0, b, 2);
+        memcpy(&x1, a + n - 2, 2);
+        memcpy(&y1, b + n - 2, 2);
+        return ((x0 ^ y0) | (x1 ^ y1)) == 0;
+    }
+    if (n <= 8)
+    {
+        // 4..8 바이트: 앞/뒤에서 겹치게 u32 두 번 (n == 4, 8 이면 사실상 단일 load)
+        if (n == 8)
+        {
+            uint64_t x, y;
+            memcpy(&x, a, 8);
+            memcpy(&y, b, 8);
+            return x == y;
+        }
+        uint32_t x0, y0, x1, y1;
+        memcpy(&x0, a, 4);
+        memcpy(&y0, b, 4);
+        memcpy(&x1, a + n - 4, 4);
+        memcpy(&y1, b + n - 4, 4);
+        return ((x0 ^ y0) | (x1 ^ y1)) == 0;
+    }
+#ifdef __SSE2__
+    if (n == 16)
+        return is_zero_16(xor_16(a, b));
+    if (n == 32)
+        return is_zero_16(_mm_or_si128(xor_16(a, b), xor_16(a + 16, b + 16)));
+    if (n == 64)
+    {
+        __m128i d = _mm_or_si128(_mm_or_si128(xor_16(a, b), xor_16(a + 16, b + 16)),
+                                 _mm_or_si128(xor_16(a + 32, b + 32), xor_16(a + 48, b + 48)));
+        return is_zero_16(d);
+    }
+#else
+    if (n <= 64)
+    {
+        // SSE2 가 없으면 u64 단위로 xor 를 모으고, 남는 끝은 겹치는 u64 하나로 비교
+        uint64_t d = 0;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            uint64_t x, y;
+            memcpy(&x, a + i, 8);
+            memcpy(&y, b + i, 8);
+            d |= x ^ y;
+        }
+        if (i < n)
+        {
+            uint64_t x, y;
+            memcpy(&x, a + n - 8, 8);
+            memcpy(&y, b + n - 8, 8);
+            d |= x ^ y;
+        }
+        return d == 0;
+    }
+#endif
+    return memcmp(a, b, n) == 0;
+}
+
+// 선택 가능한 kernel. block_size 가 목록에 없으면 DICT_KERNEL_GENERIC.
+enum
+{
+    DICT_KERNEL_GENERIC = 0,
+    DICT_KERNEL_1,
+    DICT_KERNEL_2,
+    DICT_KERNEL_4,
+    DICT_KERNEL_SMALL,  // 3, 5, 6, 7 바이트: n < 8 만 알려 겹치는 load 두 번으로 hash/비교
+    DICT_KERNEL_8,
+    DICT_KERNEL_16,
+    DICT_KERNEL_32,
+    DICT_KERNEL_64
+};
+
+static int dict_select_kernel(size_t block_size)
+{
+    switch (block_size)
+    {
+    case 1: return DICT_KERNEL_1;
+    case 2: return DICT_KERNEL_2;
+    case 3: return DICT_KERNEL_SMALL;
+    case 4: return DICT_KERNEL_4;
+    case 5:
+    case 6:
+    case 7: return DICT_KERNEL_SMALL;
+    case 8: return DICT_KERNEL_8;
+    case 16: return DICT_KERNEL_16;
+    case 32: return DICT_KERNEL_32;
+    case 64: return DICT_KERNEL_64;
+    default: return DICT_KERNEL_GENERIC;
+    }
+}
 
 void dict_init(Dictionary *dict, size_t block_size)
 {
     dict->size = 0;
     dict->capacity = INITIAL_CAPACITY;
     dict->block_size = block_size;
-    dict->blocks = (unsigned char **)malloc(sizeof(unsigned char *) * dict->capacity);
-    if (!dict->blocks)
+    dict->indexed = 0;
+    dict->blocks = (unsigned char *)malloc(block_size * dict->capacity);
+    dict->hashes = (uint64_t *)malloc(sizeof(uint64_t) * dict->capacity);
+    dict->table = (uint32_t *)calloc(INITIAL_TABLE_SIZE, sizeof(uint32_t));
+    dict->table_mask = INITIAL_TABLE_SIZE - 1;
+    dict->kernel = dict_select_kernel(block_size);
+    dict->borrowed = 0;
+    if (!dict->blocks || !dict->hashes || !dict->table)
     {
         fprintf(stderr, "Failed to allocate memory for dictionary\n");
         exit(1);
@@ -22,57 +217,613 @@ void dict_free(Dictionary *dict)
 {
     if (!dict)
         return;
-    for (int i = 0; i < dict->size; ++i)
+    if (!dict->borrowed)
     {
-        free(dict->blocks[i]);
+        free(dict->blocks);
+        free(dict->hashes);
+        free(dict->table);
     }
-    free(dict->blocks);
+    dict->borrowed = 0;
     dict->blocks = NULL;
+    dict->hashes = NULL;
+    dict->table = NULL;
+    dict->table_mask = 0;
     dict->size = 0;
     dict->capacity = 0;
     dict->block_size = 0;
+    dict->indexed = 0;
 }
 
-static void dict_grow(Dictionary *dict)
+void dict_borrow(Dictionary *dict, size_t block_size, int size, unsigned char *blocks,
+                 uint64_t *hashes, uint32_t *table, size_t table_size)
 {
-    int new_cap = dict->capacity * 2;
-    unsigned char **new_blocks = (unsigned char **)realloc(dict->blocks, sizeof(unsigned char *) * new_cap);
+    dict->blocks = blocks;
+    dict->hashes = hashes;
+    dict->table = table;
+    dict->table_mask = table_size - 1;
+    dict->size = size;
+    dict->capacity = size;
+    dict->indexed = size;
+    dict->block_size = block_size;
+    dict->kernel = dict_select_kernel(block_size);
+    dict->borrowed = 1;
+}
+
+// 빌린 배열을 자기 메모리로 옮긴다 (realloc/free 를 하기 전에).
+static void dict_own(Dictionary *dict)
+{
+    if (!dict->borrowed)
+        return;
+    size_t cap = dict->capacity > 0 ? (size_t)dict->capacity : 1;
+    size_t table_size = dict->table_mask + 1;
+    unsigned char *blocks = (unsigned char *)malloc(dict->block_size * cap);
+    uint64_t *hashes = (uint64_t *)malloc(sizeof(uint64_t) * cap);
+    uint32_t *table = (uint32_t *)malloc(sizeof(uint32_t) * table_size);
+    if (!blocks || !hashes || !table)
+    {
+        fprintf(stderr, "Failed to allocate memory for dictionary\n");
+        exit(1);
+    }
+    memcpy(blocks, dict->blocks, dict->block_size * (size_t)dict->size);
+    memcpy(hashes, dict->hashes, sizeof(uint64_t) * (size_t)dict->indexed);
+    memcpy(table, dict->table, sizeof(uint32_t) * table_size);
+    dict->blocks = blocks;
+    dict->hashes = hashes;
+    dict->table = table;
+    dict->capacity = (int)cap;
+    dict->borrowed = 0;
+}
+
+static void dict_grow(Dictionary *dict, int min_cap)
+{
+    dict_own(dict);
+    // int 로 두 배씩 키우면 2^30 을 넘을 때 overflow 해 끝나지 않는다
+    size_t new_cap = dict->capacity > 0 ? (size_t)dict->capacity * 2 : 1;
+    while (new_cap < (size_t)min_cap)
+    {
+        new_cap *= 2;
+    }
+    if (new_cap > INT_MAX)
+        new_cap = INT_MAX;
+    unsigned char *new_blocks = (unsigned char *)realloc(dict->blocks, dict->block_size * new_cap);
     if (!new_blocks)
     {
         fprintf(stderr, "Failed to reallocate dictionary\n");
         exit(1);
     }
     dict->blocks = new_blocks;
-    dict->capacity = new_cap;
+    uint64_t *new_hashes = (uint64_t *)realloc(dict->hashes, sizeof(uint64_t) * new_cap);
+    if (!new_hashes)
+    {
+        fprintf(stderr, "Failed to reallocate dictionary\n");
+        exit(1);
+    }
+    dict->hashes = new_hashes;
+    dict->capacity = (int)new_cap;
+}
+
+// load factor 를 1/2 이하로 유지하도록 index 를 두 배로 늘리고 저장된 hash 로 재배치
+static void dict_grow_table(Dictionary *dict, int min_entries)
+{
+    dict_own(dict);
+    size_t new_size = (dict->table_mask + 1) * 2;
+    while ((size_t)min_entries * 2 > new_size)
+    {
+        new_size *= 2;
+    }
+    uint32_t *new_table = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!new_table)
+    {
+        fprintf(stderr, "Failed to reallocate dictionary index\n");
+        exit(1);
+    }
+    size_t mask = new_size - 1;
+    for (int i = 0; i < dict->indexed; ++i)
+    {
+        size_t slot = (size_t)dict->hashes[i] & mask;
+        while (new_table[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        new_table[slot] = (uint32_t)i + 1;
+    }
+    free(dict->table);
+    dict->table = new_table;
+    dict->table_mask = mask;
+}
+
+#define DISPATCH_KERNEL(dict, EXPR_N)                                   \
+    switch ((dict)->kernel)                                             \
+    {                                                                   \
+    case DICT_KERNEL_1: EXPR_N(1)                                       \
+    case DICT_KERNEL_2: EXPR_N(2)                                       \
+    case DICT_KERNEL_4: EXPR_N(4)                                       \
+    case DICT_KERNEL_SMALL: EXPR_N((dict)->block_size & 7)              \
+    case DICT_KERNEL_8: EXPR_N(8)                                       \
+    case DICT_KERNEL_16: EXPR_N(16)                                     \
+    case DICT_KERNEL_32: EXPR_N(32)                                     \
+    case DICT_KERNEL_64: EXPR_N(64)                                     \
+    default: EXPR_N((dict)->block_size)                                 \
+    }
+
+uint64_t dict_hash(const Dictionary *dict, const unsigned char *block)
+{
+#define HASH_N(N) return hash_bytes_inline(block, N);
+    DISPATCH_KERNEL(dict, HASH_N)
+#undef HASH_N
 }
 
 int dict_find(const Dictionary *dict, const unsigned char *block)
 {
-    for (int i = 0; i < dict->size; ++i)
+    return dict_find_hashed(dict, block, dict_hash(dict, block));
+}
+
+#ifdef DDP_STATS
+#define FIND_STATS(slots, collisions) (STATS_COUNT(probes, 1), STATS_COUNT(probe_slots, slots), \
+                                       STATS_COUNT(hash_collisions, collisions))
+#else
+#define FIND_STATS(slots, collisions) ((void)0)
+#endif
+
+static inline __attribute__((always_inline)) int find_inline(const Dictionary *dict, const unsigned char *block,
+                                                             uint64_t h, size_t n)
+{
+    size_t slot = (size_t)h & dict->table_mask;
+    size_t left = dict->table_mask + 1;
+    uint32_t entry;
+#ifdef DDP_STATS
+    uint64_t slots = 0, collisions = 0;
+#endif
+    // 빈 slot (0) 과 빌린 table 의 범위 밖 항목 (id >= size) 을 한 번의 unsigned 비교로 멈춘다.
+    // 빈 slot 이 없는 table 이어도 한 바퀴를 돌면 멈춘다.
+    while ((entry = dict->table[slot]) - 1u < (uint32_t)dict->size && left-- > 0)
     {
-        if (memcmp(dict->blocks[i], block, dict->block_size) == 0)
+        int id = (int)(entry - 1);
+#ifdef DDP_STATS
+        ++slots;
+#endif
+        if (dict->hashes[id] == h)
         {
-            return i;
+            if (block_eq_inline(dict->blocks + (size_t)id * n, block, n))
+            {
+                FIND_STATS(slots, collisions);
+                return id;
+            }
+#ifdef DDP_STATS
+            ++collisions;
+#endif
         }
+        slot = (slot + 1) & dict->table_mask;
     }
+    FIND_STATS(slots, collisions);
     return -1;
 }
 
+int dict_find_hashed(const Dictionary *dict, const unsigned char *block, uint64_t h)
+{
+#define FIND_N(N) return find_inline(dict, block, h, N);
+    DISPATCH_KERNEL(dict, FIND_N)
+#undef FIND_N
+}
+
+// 빈 slot 을 찾지 못하면 (한 바퀴를 돌아도 다 찬 table) 항목은 index 에 오르지 않는다.
+// 찾기만 못 할 뿐 복원 결과는 그대로이고, dict_truncate 가 잃은 항목을 알려 준다.
+static void dict_index_one(Dictionary *dict, int id, uint64_t h)
+{
+    size_t slot = (size_t)h & dict->table_mask;
+    size_t left = dict->table_mask + 1;
+    while (dict->table[slot] - 1u < (uint32_t)dict->size)
+    {
+        if (--left == 0)
+        {
+            dict->hashes[id] = h;
+            return;
+        }
+        slot = (slot + 1) & dict->table_mask;
+    }
+    dict->hashes[id] = h;
+    dict->table[slot] = (uint32_t)id + 1;
+}
+
+void dict_reindex(Dictionary *dict)
+{
+    if (dict->indexed == dict->size)
+        return;
+    if ((size_t)dict->size * 2 > dict->table_mask + 1)
+    {
+        dict_grow_table(dict, dict->size);
+    }
+    for (int i = dict->indexed; i < dict->size; ++i)
+    {
+        dict_index_one(dict, i, dict_hash(dict, dict_block(dict, i)));
+    }
+    dict->indexed = dict->size;
+}
+
+// batch 의 stage 1, 2: 모두 hash 한 뒤 home slot 을, 다음에 그 slot 의 첫 항목
+// (hash 와 block) 을 prefetch 해서 m 개 block 의 cache miss 가 겹치도록 한다.
+// 한 block 씩 찾으면 dictionary 가 L2 보다 클 때 probe 마다 miss 를 차례로 기다린다.
+static inline __attribute__((always_inline)) void batch_prefetch(const Dictionary *dict,
+                                                                  const unsigned char *blocks,
+                                                                  size_t m, uint64_t *h, size_t n)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        h[i] = hash_bytes_inline(blocks + i * n, n);
+        __builtin_prefetch(&dict->table[(size_t)h[i] & dict->table_mask]);
+    }
+    for (size_t i = 0; i < m; ++i)
+    {
+        uint32_t entry = dict->table[(size_t)h[i] & dict->table_mask];
+        if (entry - 1u < (uint32_t)dict->size)
+        {
+            __builtin_prefetch(&dict->hashes[entry - 1]);
+            __builtin_prefetch(dict->blocks + (size_t)(entry - 1) * n);
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void find_batch_inline(const Dictionary *dict,
+                                                                     const unsigned char *blocks,
+                                                                     size_t count, uint32_t *ids,
+                                                                     uint64_t *hashes, size_t n)
+{
+    uint64_t h[DICT_BATCH];
+    for (size_t g = 0; g < count; g += DICT_BATCH)
+    {
+        size_t m = count - g < DICT_BATCH ? count - g : DICT_BATCH;
+        const unsigned char *group = blocks + g * n;
+        batch_prefetch(dict, group, m, h, n);
+        for (size_t i = 0; i < m; ++i)
+        {
+            ids[g + i] = (uint32_t)find_inline(dict, group + i * n, h[i], n);
+            if (hashes)
+                hashes[g + i] = h[i];
+        }
+    }
+}
+
+void dict_find_batch(const Dictionary *dict, const unsigned char *blocks, size_t count,
+                     uint32_t *ids, uint64_t *hashes)
+{
+#define FIND_BATCH_N(N) find_batch_inline(dict, blocks, count, ids, hashes, N); return;
+    DISPATCH_KERNEL(dict, FIND_BATCH_N)
+#undef FIND_BATCH_N
+}
+
+// stage 3 는 group 안에서도 순서대로 찾고 더하므로 같은 group 에 두 번 나온 block 도
+// 첫 등장에서 받은 id 를 다시 찾는다. 추가로 table 이 커지면 prefetch 한 주소는 의미가
+// 없어지지만 hint 일 뿐이라 결과에는 영향이 없다.
+static inline __attribute__((always_inline)) void add_batch_inline(Dictionary *dict,
+                                                                    const unsigned char *blocks,
+                                                                    size_t count, uint32_t *ids,
+                                                                    size_t n)
+{
+    uint64_t h[DICT_BATCH];
+    dict_reindex(dict);
+    for (size_t g = 0; g < count; g += DICT_BATCH)
+    {
+        size_t m = count - g < DICT_BATCH ? count - g : DICT_BATCH;
+        const unsigned char *group = blocks + g * n;
+        batch_prefetch(dict, group, m, h, n);
+        for (size_t i = 0; i < m; ++i)
+        {
+            const unsigned char *block = group + i * n;
+            int id = find_inline(dict, block, h[i], n);
+            if (id < 0)
+                id = dict_add_hashed(dict, block, h[i]);
+            ids[g + i] = (uint32_t)id;
+        }
+    }
+}
+
+void dict_add_batch(Dictionary *dict, const unsigned char *blocks, size_t count, uint32_t *ids)
+{
+#define ADD_BATCH_N(N) add_batch_inline(dict, blocks, count, ids, N); return;
+    DISPATCH_KERNEL(dict, ADD_BATCH_N)
+#undef ADD_BATCH_N
+}
+
+unsigned char *dict_append_raw(Dictionary *dict, int n)
+{
+    if (dict->size + n > dict->capacity)
+    {
+        dict_grow(dict, dict->size + n);
+    }
+    unsigned char *dst = dict_block(dict, dict->size);
+    dict->size += n;
+    return dst;
+}
+
 int dict_add(Dictionary *dict, const unsigned char *block)
 {
+    return dict_add_hashed(dict, block, dict_hash(dict, block));
+}
+
+int dict_add_hashed(Dictionary *dict, const unsigned char *block, uint64_t h)
+{
+    dict_reindex(dict);
     if (dict->size == dict->capacity)
     {
-        dict_grow(dict);
+        dict_grow(dict, dict->size + 1);
+    }
+    if ((size_t)(dict->size + 1) * 2 > dict->table_mask + 1)
+    {
+        dict_grow_table(dict, dict->size + 1);
+    }
+
+    int idx = dict->size;
+    STATS_COUNT(inserts, 1);
+    memcpy(dict_block(dict, idx), block, dict->block_size);
+    dict_index_one(dict, idx, h);
+    dict->size += 1;
+    dict->indexed = dict->size;
+    return idx;
+}
+void dict_reserve(Dictionary *dict, int capacity)
+{
+    dict_own(dict);
+    if (capacity > dict->capacity)
+    {
+        unsigned char *new_blocks = (unsigned char *)realloc(dict->blocks, dict->block_size * capacity);
+        uint64_t *new_hashes = new_blocks ? (uint64_t *)realloc(dict->hashes, sizeof(uint64_t) * capacity) : NULL;
+        if (!new_blocks || !new_hashes)
+        {
+            fprintf(stderr, "Failed to reallocate dictionary\n");
+            exit(1);
+        }
+        dict->blocks = new_blocks;
+        dict->hashes = new_hashes;
+        dict->capacity = capacity;
+    }
+    if ((size_t)capacity * 2 > dict->table_mask + 1)
+    {
+        dict_grow_table(dict, capacity);
+    }
+}
+
+void dict_replace_hashed(Dictionary *dict, int id, const unsigned char *block, uint64_t h)
+{
+    dict_reindex(dict);
+    size_t mask = dict->table_mask;
+    size_t i = (size_t)dict->hashes[id] & mask;
+    int found = 0;
+    for (size_t left = mask + 1; left > 0 && dict->table[i] != 0; --left)
+    {
+        if (dict->table[i] == (uint32_t)id + 1)
+        {
+            found = 1;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    // index 에 없던 항목 (dict_index_one 참고) 이면 지울 것 없이 새 block 만 올린다
+    if (found)
+    {
+        // backward-shift 삭제: 뒤따르는 항목 중 home slot 이 (i, j] 밖인 것을 빈 자리로 당긴다
+        size_t left = mask;
+        for (size_t j = (i + 1) & mask; left > 0 && dict->table[j] != 0; j = (j + 1) & mask, --left)
+        {
+            size_t home = (size_t)dict->hashes[dict->table[j] - 1] & mask;
+            int stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (stays)
+                continue;
+            dict->table[i] = dict->table[j];
+            i = j;
+        }
+        dict->table[i] = 0;
+    }
+
+    STATS_COUNT(inserts, 1);
+    memcpy(dict_block(dict, id), block, dict->block_size);
+    dict_index_one(dict, id, h);
+}
+
+int dict_truncate(Dictionary *dict, int size)
+{
+    dict_reindex(dict);
+    for (int id = dict->size - 1; id >= size; --id)
+    {
+        size_t slot = (size_t)dict->hashes[id] & dict->table_mask;
+        size_t left = dict->table_mask + 1;
+        while (dict->table[slot] != (uint32_t)id + 1)
+        {
+            // 빈 slot 에 닿거나 한 바퀴를 돌았으면 index 가 깨진 것이다. 계속 돌면 끝나지 않는다
+            // 남은 항목으로 index 를 새로 만들어 다음 호출은 온전한 dictionary 로 시작하게 한다
+            if (dict->table[slot] == 0 || --left == 0)
+            {
+                fprintf(stderr, "Dictionary index lost entry %d\n", id);
+                memset(dict->table, 0, sizeof(uint32_t) * (dict->table_mask + 1));
+                dict->size = size;
+                dict->indexed = 0;
+                dict_reindex(dict);
+                return 1;
+            }
+            slot = (slot + 1) & dict->table_mask;
+        }
+        // linear probing 에서 가장 나중에 넣은 항목 뒤의 slot 은 모두 그보다 먼저
+        // 들어온 항목이고, 그 항목들의 probe 는 이 slot 을 지나지 않았다
+        dict->table[slot] = 0;
+    }
+    dict->size = size;
+    dict->indexed = size;
+    return 0;
+}
+
+int dict_renumber(Dictionary *dict, int base, const uint32_t *order)
+{
+    int size = dict->size;
+    size_t n = (size_t)(size - base);
+    if (n == 0)
+        return 0;
+    // 옮기기 전에 지우고 새 번호 순서로 다시 넣어야 dict_truncate 가 기대하는 추가 순서와
+    // table 배치가 맞는다
+    if (dict_truncate(dict, base) != 0)
+        return 1;
+    unsigned char *blocks = (unsigned char *)malloc(dict->block_size * n);
+    uint64_t *hashes = (uint64_t *)malloc(sizeof(uint64_t) * n);
+    if (!blocks || !hashes)
+    {
+        fprintf(stderr, "Failed to allocate memory for dictionary\n");
+        exit(1);
+    }
+    for (size_t k = 0; k < n; ++k)
+    {
+        memcpy(blocks + k * dict->block_size, dict_block(dict, (int)order[k]), dict->block_size);
+        hashes[k] = dict->hashes[order[k]];
+    }
+    memcpy(dict_block(dict, base), blocks, dict->block_size * n);
+    // dict_index_one 은 id >= size 인 slot 을 빈 것으로 보므로 먼저 크기를 되돌려야
+    // 앞서 넣은 항목을 덮어쓰지 않는다
+    dict->size = size;
+    for (size_t k = 0; k < n; ++k)
+    {
+        dict_index_one(dict, base + (int)k, hashes[k]);
+    }
+    dict->indexed = size;
+    free(blocks);
+    free(hashes);
+    return 0;
+}
+
+uint64_t dict_checksum(const Dictionary *dict)
+{
+    return hash_bytes_inline(dict->blocks, dict->block_size * (size_t)dict->size) ^
+           mix64((uint64_t)dict->block_size);
+}
+
+void vdict_init(VarDictionary *dict)
+{
+    dict->size = 0;
+    dict->capacity = INITIAL_CAPACITY;
+    dict->data_len = 0;
+    dict->data_cap = 4096;
+    dict->data = (unsigned char *)malloc(dict->data_cap);
+    dict->offsets = (size_t *)malloc(sizeof(size_t) * (dict->capacity + 1));
+    dict->hashes = (uint64_t *)malloc(sizeof(uint64_t) * dict->capacity);
+    dict->table = (uint32_t *)calloc(INITIAL_TABLE_SIZE, sizeof(uint32_t));
+    dict->table_mask = INITIAL_TABLE_SIZE - 1;
+    if (!dict->data || !dict->offsets || !dict->hashes || !dict->table)
+    {
+        fprintf(stderr, "Failed to allocate memory for dictionary\n");
+        exit(1);
+    }
+    dict->offsets[0] = 0;
+}
+
+void vdict_free(VarDictionary *dict)
+{
+    if (!dict)
+        return;
+    free(dict->data);
+    free(dict->offsets);
+    free(dict->hashes);
+    free(dict->table);
+    memset(dict, 0, sizeof(*dict));
+}
+
+uint64_t vdict_hash(const unsigned char *chunk, size_t len)
+{
+    return hash_bytes_inline(chunk, len);
+}
+
+int vdict_find_hashed(const VarDictionary *dict, const unsigned char *chunk, size_t len, uint64_t h)
+{
+    size_t slot = (size_t)h & dict->table_mask;
+    uint32_t entry;
+    STATS_COUNT(probes, 1);
+    while ((entry = dict->table[slot]) != 0)
+    {
+        int id = (int)(entry - 1);
+        STATS_COUNT(probe_slots, 1);
+        if (dict->hashes[id] == h)
+        {
+            if (vdict_len(dict, id) == len &&
+                memcmp(dict->data + dict->offsets[id], chunk, len) == 0)
+            {
+                return id;
+            }
+            STATS_COUNT(hash_collisions, 1);
+        }
+        slot = (slot + 1) & dict->table_mask;
     }
-    unsigned char *copy = (unsigned char *)malloc(dict->block_size);
-    if (!copy)
+    return -1;
+}
+
+static void vdict_grow_table(VarDictionary *dict)
+{
+    size_t new_size = (dict->table_mask + 1) * 2;
+    uint32_t *new_table = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!new_table)
     {
-        fprintf(stderr, "Failed to allocate block copy\n");
+        fprintf(stderr, "Failed to reallocate dictionary index\n");
         exit(1);
     }
-    memcpy(copy, block, dict->block_size);
-    dict->blocks[dict->size] = copy;
+    size_t mask = new_size - 1;
+    for (int i = 0; i < dict->size; ++i)
+    {
+        size_t slot = (size_t)dict->hashes[i] & mask;
+        while (new_table[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        new_table[slot] = (uint32_t)i + 1;
+    }
+    free(dict->table);
+    dict->table = new_table;
+    dict->table_mask = mask;
+}
+
+int vdict_add_hashed(VarDictionary *dict, const unsigned char *chunk, size_t len, uint64_t h)
+{
+    if (dict->size == dict->capacity)
+    {
+        int new_cap = dict->capacity * 2;
+        size_t *new_offsets = (size_t *)realloc(dict->offsets, sizeof(size_t) * (new_cap + 1));
+        uint64_t *new_hashes = new_offsets ? (uint64_t *)realloc(dict->hashes, sizeof(uint64_t) * new_cap) : NULL;
+        if (!new_offsets || !new_hashes)
+        {
+            fprintf(stderr, "Failed to reallocate dictionary\n");
+            exit(1);
+        }
+        dict->offsets = new_offsets;
+        dict->hashes = new_hashes;
+        dict->capacity = new_cap;
+    }
+    if (dict->data_len + len > dict->data_cap)
+    {
+        size_t new_cap = dict->data_cap * 2;
+        while (new_cap < dict->data_len + len)
+        {
+            new_cap *= 2;
+        }
+        unsigned char *new_data = (unsigned char *)realloc(dict->data, new_cap);
+        if (!new_data)
+        {
+            fprintf(stderr, "Failed to reallocate dictionary\n");
+            exit(1);
+        }
+        dict->data = new_data;
+        dict->data_cap = new_cap;
+    }
+    if ((size_t)(dict->size + 1) * 2 > dict->table_mask + 1)
+    {
+        vdict_grow_table(dict);
+    }
+
     int idx = dict->size;
+    memcpy(dict->data + dict->data_len, chunk, len);
+    dict->data_len += len;
+    dict->offsets[idx + 1] = dict->data_len;
+
+    size_t slot = (size_t)h & dict->table_mask;
+    while (dict->table[slot] != 0)
+    {
+        slot = (slot + 1) & dict->table_mask;
+    }
+    dict->hashes[idx] = h;
+    dict->table[slot] = (uint32_t)idx + 1;
     dict->size += 1;
+    STATS_COUNT(inserts, 1);
     return idx;
-}
\ No newline at end of file
+}
@@ -0,0 +1,217 @@
+#include "../include/entropy.h"
+#include <string.h>
+
+// 출력 형식: [빈도표] [state 0] [state 1] [byte stream]
+//  빈도표: 256 개 빈도를 varint (7bit, 최대 2바이트) 로, 합은 RANS_M
+//  state: u32 LE. 부호화는 뒤에서 앞으로, 복원은 앞에서 뒤로 진행한다.
+#define RANS_PROB_BITS 12
+#define RANS_M (1u << RANS_PROB_BITS)
+#define RANS_L (1u << 23)
+
+int codec_parse(const char *name)
+{
+    if (strcmp(name, "none") == 0)
+        return DDP_CODEC_NONE;
+    if (strcmp(name, "rans") == 0)
+        return DDP_CODEC_RANS;
+    return -1;
+}
+
+size_t rans_bound(size_t n)
+{
+    // 심볼당 최대 RANS_PROB_BITS bit + 빈도표 + state 2개
+    return n + n / 2 + 2 * 256 + 8 + 16;
+}
+
+static void store_u32_le(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+static uint32_t load_u32_le(const unsigned char *p)
+{
+    return (uint32_t)p[0]
+         | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+// 빈도를 합이 RANS_M 이 되도록 맞춘다. 등장한 심볼은 최소 1.
+static void normalize_freqs(const size_t *counts, size_t total, uint32_t *freqs)
+{
+    uint32_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        freqs[s] = 0;
+        if (counts[s] == 0)
+            continue;
+        uint64_t f = (uint64_t)counts[s] * RANS_M / total;
+        freqs[s] = f > 0 ? (uint32_t)f : 1;
+        sum += freqs[s];
+        if (counts[s] > counts[largest])
+            largest = s;
+    }
+    if (sum < RANS_M)
+    {
+        freqs[largest] += RANS_M - sum;
+        return;
+    }
+    // 최소 1 로 올린 심볼 때문에 넘친 만큼 큰 빈도부터 깎는다
+    while (sum > RANS_M)
+    {
+        int best = -1;
+        for (int s = 0; s < 256; ++s)
+        {
+            if (freqs[s] > 1 && (best < 0 || freqs[s] > freqs[best]))
+                best = s;
+        }
+        uint32_t cut = sum - RANS_M;
+        if (cut > freqs[best] - 1)
+            cut = freqs[best] - 1;
+        freqs[best] -= cut;
+        sum -= cut;
+    }
+}
+
+static inline void enc_put(uint32_t *x, unsigned char **ptr, uint32_t start, uint32_t freq)
+{
+    uint32_t x_max = ((RANS_L >> RANS_PROB_BITS) << 8) * freq;
+    uint32_t v = *x;
+    while (v >= x_max)
+    {
+        *--*ptr = (unsigned char)(v & 0xFF);
+        v >>= 8;
+    }
+    *x = ((v / freq) << RANS_PROB_BITS) + (v % freq) + start;
+}
+
+size_t rans_encode(const unsigned char *in, size_t n, unsigned char *out)
+{
+    size_t counts[256] = { 0 };
+    for (size_t i = 0; i < n; ++i)
+        ++counts[in[i]];
+
+    uint32_t freqs[256];
+    uint32_t starts[256];
+    if (n > 0)
+    {
+        normalize_freqs(counts, n, freqs);
+    }
+    else
+    {
+        memset(freqs, 0, sizeof(freqs));
+        freqs[0] = RANS_M;
+    }
+    uint32_t acc = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        starts[s] = acc;
+        acc += freqs[s];
+    }
+
+    unsigned char *p = out;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (freqs[s] < 0x80)
+        {
+            *p++ = (unsigned char)freqs[s];
+        }
+        else
+        {
+            *p++ = (unsigned char)(0x80 | (freqs[s] & 0x7F));
+            *p++ = (unsigned char)(freqs[s] >> 7);
+        }
+    }
+    unsigned char *states = p;
+
+    // byte stream 은 버퍼 끝에서부터 거꾸로 쌓은 뒤 state 뒤로 옮긴다
+    unsigned char *end = out + rans_bound(n);
+    unsigned char *ptr = end;
+    uint32_t x0 = RANS_L;
+    uint32_t x1 = RANS_L;
+    for (size_t i = n; i-- > 0;)
+    {
+        unsigned char s = in[i];
+        if (i & 1)
+            enc_put(&x1, &ptr, starts[s], freqs[s]);
+        else
+            enc_put(&x0, &ptr, starts[s], freqs[s]);
+    }
+    store_u32_le(states, x0);
+    store_u32_le(states + 4, x1);
+    size_t stream = (size_t)(end - ptr);
+    memmove(states + 8, ptr, stream);
+    return (size_t)(states + 8 - out) + stream;
+}
+
+int rans_decode(const unsigned char *in, size_t in_size, unsigned char *out, size_t n)
+{
+    const unsigned char *p = in;
+    const unsigned char *end = in + in_size;
+    uint32_t freqs[256];
+    uint32_t starts[256];
+    uint32_t acc = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (p >= end)
+            return 1;
+        uint32_t f = *p++;
+        if (f & 0x80)
+        {
+            if (p >= end)
+                return 1;
+            f = (f & 0x7F) | ((uint32_t)*p++ << 7);
+        }
+        freqs[s] = f;
+        starts[s] = acc;
+        acc += f;
+    }
+    if (acc != RANS_M || end - p < 8)
+        return 1;
+
+    // slot -> (심볼, 빈도 - 1, slot - 시작) 을 u32 하나로 묶은 표 (8 + 12 + 12 bit)
+    uint32_t slots[RANS_M];
+    for (int s = 0; s < 256; ++s)
+    {
+        for (uint32_t k = 0; k < freqs[s]; ++k)
+        {
+            slots[starts[s] + k] = (uint32_t)s | ((freqs[s] - 1) << 8) | (k << 20);
+        }
+    }
+
+    uint32_t x0 = load_u32_le(p);
+    uint32_t x1 = load_u32_le(p + 4);
+    p += 8;
+
+    // 손상된 입력으로 stream 끝을 넘지 않도록 renormalize 마다 남은 바이트를 확인한다
+#define RANS_DEC_STEP(x, i)                                              \
+    do                                                                   \
+    {                                                                    \
+        uint32_t e = slots[(x) & (RANS_M - 1)];                          \
+        out[i] = (unsigned char)e;                                       \
+        (x) = (((e >> 8) & 0xFFF) + 1) * ((x) >> RANS_PROB_BITS) + (e >> 20); \
+        while ((x) < RANS_L)                                             \
+        {                                                                \
+            if (p >= end)                                                \
+                return 1;                                                \
+            (x) = ((x) << 8) | *p++;                                     \
+        }                                                                \
+    } while (0)
+
+    size_t i = 0;
+    for (; i + 1 < n; i += 2)
+    {
+        RANS_DEC_STEP(x0, i);
+        RANS_DEC_STEP(x1, i + 1);
+    }
+    if (i < n)
+    {
+        RANS_DEC_STEP(x0, i);
+    }
+#undef RANS_DEC_STEP
+    return 0;
+}
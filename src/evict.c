@@ -0,0 +1,39 @@
+#include "../include/evict.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int clock_init(ClockState *c, int capacity)
+{
+    c->ref = (unsigned char *)calloc((size_t)capacity, 1);
+    c->capacity = capacity;
+    c->hand = 0;
+    if (!c->ref)
+    {
+        fprintf(stderr, "Failed to allocate eviction state\n");
+        return 1;
+    }
+    return 0;
+}
+
+void clock_free(ClockState *c)
+{
+    free(c->ref);
+    c->ref = NULL;
+    c->capacity = 0;
+    c->hand = 0;
+}
+
+int clock_evict(ClockState *c)
+{
+    while (c->ref[c->hand])
+    {
+        c->ref[c->hand] = 0;
+        if (++c->hand == c->capacity)
+            c->hand = 0;
+    }
+    int victim = c->hand;
+    c->ref[victim] = 1;
+    if (++c->hand == c->capacity)
+        c->hand = 0;
+    return victim;
+}
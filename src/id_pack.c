@@ -0,0 +1,120 @@
+#include "../include/id_pack.h"
+#include <string.h>
+
+int id_bits_for(uint32_t dict_size)
+{
+    int bits = 0;
+    while (bits < 32 && ((uint64_t)1 << bits) < dict_size)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+size_t packed_ids_size(size_t n, int bits)
+{
+    return (n * (size_t)bits + 7) / 8;
+}
+
+static void store_u32_le(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+static uint64_t load_u64_le(const unsigned char *p)
+{
+    return (uint64_t)p[0]
+         | ((uint64_t)p[1] << 8)
+         | ((uint64_t)p[2] << 16)
+         | ((uint64_t)p[3] << 24)
+         | ((uint64_t)p[4] << 32)
+         | ((uint64_t)p[5] << 40)
+         | ((uint64_t)p[6] << 48)
+         | ((uint64_t)p[7] << 56);
+}
+
+void pack_ids(const uint32_t *ids, size_t n, int bits, unsigned char *out)
+{
+    if (bits == 0)
+        return;
+
+    // 64-bit accumulator 에 모았다가 32 bit 씩 내보낸다 (bits <= 32 이므로 넘치지 않음)
+    uint64_t acc = 0;
+    int nbits = 0;
+    unsigned char *p = out;
+    for (size_t i = 0; i < n; ++i)
+    {
+        acc |= (uint64_t)ids[i] << nbits;
+        nbits += bits;
+        if (nbits >= 32)
+        {
+            store_u32_le(p, (uint32_t)acc);
+            p += 4;
+            acc >>= 32;
+            nbits -= 32;
+        }
+    }
+    while (nbits > 0)
+    {
+        *p++ = (unsigned char)(acc & 0xFF);
+        acc >>= 8;
+        nbits -= 8;
+    }
+}
+
+void unpack_ids(const unsigned char *packed, size_t n, int bits, uint32_t *ids_out)
+{
+    if (bits == 0)
+    {
+        memset(ids_out, 0, sizeof(uint32_t) * n);
+        return;
+    }
+
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    size_t size = packed_ids_size(n, bits);
+    size_t i = 0;
+    size_t bitpos = 0;
+
+    // 8바이트를 한 번에 읽을 수 있는 동안은 id 마다 load 한 번 + shift/mask 로 꺼낸다
+    while (i < n && (bitpos >> 3) + 8 <= size)
+    {
+        uint64_t w = load_u64_le(packed + (bitpos >> 3));
+        ids_out[i++] = (uint32_t)((w >> (bitpos & 7)) & mask);
+        bitpos += (size_t)bits;
+    }
+
+    // 끝부분은 남은 바이트만 0 padding 해서 읽는다
+    while (i < n)
+    {
+        unsigned char tail[8] = { 0 };
+        size_t at = bitpos >> 3;
+        memcpy(tail, packed + at, size - at);
+        uint64_t w = load_u64_le(tail);
+        ids_out[i++] = (uint32_t)((w >> (bitpos & 7)) & mask);
+        bitpos += (size_t)bits;
+    }
+}
+
+uint32_t packed_id_at(const unsigned char *packed, size_t size, int bits, size_t i)
+{
+    if (bits == 0)
+        return 0;
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    size_t bitpos = i * (size_t)bits;
+    size_t at = bitpos >> 3;
+    uint64_t w;
+    if (at + 8 <= size)
+    {
+        w = load_u64_le(packed + at);
+    }
+    else
+    {
+        unsigned char tail[8] = { 0 };
+        memcpy(tail, packed + at, size - at);
+        w = load_u64_le(tail);
+    }
+    return (uint32_t)((w >> (bitpos & 7)) & mask);
+}
\ No newline at end of file
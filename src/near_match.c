@@ -0,0 +1,154 @@
+#include "../include/near_match.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEAR_INITIAL_HEADS 64
+
+// cell = block_samples * epsilon + 1. 샘플 차이의 합이 S 인 두 block 이 한 table 에서
+// 갈라질 확률은 S / cell 이하라서 (최악의 경우에도 1 미만), offset 을 cell / NEAR_TABLES 씩
+// 엇갈린 table 중 하나에서는 대개 같은 bucket 에 든다. 격자를 더 키우면 bucket 에
+// 먼 항목이 섞여 NEAR_CANDIDATES 안에서 놓치는 경우가 더 많았다.
+#define NEAR_CELL_SCALE 1
+
+static uint64_t near_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t load_sample(const unsigned char *p, int width)
+{
+    uint64_t v = 0;
+    for (int i = width - 1; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+// table t 의 signature: (sample + t * cell / NEAR_TABLES) / cell 을 이어서 hash
+static uint64_t near_key(const NearIndex *ni, const unsigned char *block, int t)
+{
+    uint64_t offset = ni->cell / NEAR_TABLES * (uint64_t)t;
+    uint64_t h = 0x9E3779B97F4A7C15ULL * (uint64_t)(t + 1);
+    for (size_t i = 0; i < ni->block_samples; ++i)
+    {
+        uint64_t q = (load_sample(block + i * (size_t)ni->width_bytes, ni->width_bytes) + offset) / ni->cell;
+        h = near_mix(h ^ q);
+    }
+    return h;
+}
+
+static int within_epsilon(const NearIndex *ni, const unsigned char *a, const unsigned char *b)
+{
+    for (size_t i = 0; i < ni->block_samples; ++i)
+    {
+        uint64_t x = load_sample(a + i * (size_t)ni->width_bytes, ni->width_bytes);
+        uint64_t y = load_sample(b + i * (size_t)ni->width_bytes, ni->width_bytes);
+        if ((x > y ? x - y : y - x) > ni->epsilon)
+            return 0;
+    }
+    return 1;
+}
+
+static void near_link(NearIndex *ni, const Dictionary *dict, int id)
+{
+    size_t heads = ni->head_mask + 1;
+    for (int t = 0; t < NEAR_TABLES; ++t)
+    {
+        size_t slot = (size_t)near_key(ni, dict_block(dict, id), t) & ni->head_mask;
+        uint32_t *head = ni->heads + (size_t)t * heads + slot;
+        ni->next[(size_t)t * (size_t)ni->capacity + (size_t)id] = *head;
+        *head = (uint32_t)id + 1;
+    }
+}
+
+// bucket 수를 항목 수의 두 배 이상으로 유지한다. 다시 연결할 때도 id 순서로 넣어
+// bucket 안의 순서 (최근 항목 먼저) 가 바뀌지 않는다.
+static void near_grow(NearIndex *ni, const Dictionary *dict, int min_entries)
+{
+    int new_cap = ni->capacity > 0 ? ni->capacity : NEAR_INITIAL_HEADS / 2;
+    while (new_cap < min_entries)
+        new_cap *= 2;
+    size_t heads = ni->head_mask + 1;
+    while (heads < (size_t)new_cap * 2)
+        heads *= 2;
+
+    uint32_t *new_heads = (uint32_t *)calloc(NEAR_TABLES * heads, sizeof(uint32_t));
+    uint32_t *new_next = (uint32_t *)malloc(sizeof(uint32_t) * NEAR_TABLES * (size_t)new_cap);
+    if (!new_heads || !new_next)
+    {
+        fprintf(stderr, "Failed to allocate near-match index\n");
+        exit(1);
+    }
+    free(ni->heads);
+    free(ni->next);
+    ni->heads = new_heads;
+    ni->next = new_next;
+    ni->head_mask = heads - 1;
+    ni->capacity = new_cap;
+    for (int id = 0; id < ni->size; ++id)
+        near_link(ni, dict, id);
+}
+
+int near_init(NearIndex *ni, const Dictionary *dict, int width_bytes, uint64_t epsilon)
+{
+    memset(ni, 0, sizeof(*ni));
+    ni->epsilon = epsilon;
+    ni->width_bytes = width_bytes;
+    ni->block_samples = dict->block_size / (size_t)width_bytes;
+    uint64_t span = (uint64_t)NEAR_CELL_SCALE * (uint64_t)ni->block_samples;
+    ni->cell = (epsilon > (UINT64_MAX - 1) / span) ? UINT64_MAX : span * epsilon + 1;
+    ni->head_mask = NEAR_INITIAL_HEADS - 1;
+    if (width_bytes <= 0 || ni->block_samples == 0)
+    {
+        fprintf(stderr, "Invalid near-match block geometry\n");
+        return 1;
+    }
+    near_grow(ni, dict, dict->size);
+    for (int id = 0; id < dict->size; ++id)
+    {
+        near_link(ni, dict, id);
+        ni->size = id + 1;
+    }
+    return 0;
+}
+
+void near_free(NearIndex *ni)
+{
+    free(ni->heads);
+    free(ni->next);
+    memset(ni, 0, sizeof(*ni));
+}
+
+int near_find(NearIndex *ni, const Dictionary *dict, const unsigned char *block)
+{
+    size_t heads = ni->head_mask + 1;
+    for (int t = 0; t < NEAR_TABLES; ++t)
+    {
+        size_t slot = (size_t)near_key(ni, block, t) & ni->head_mask;
+        uint32_t entry = ni->heads[(size_t)t * heads + slot];
+        for (int c = 0; c < NEAR_CANDIDATES && entry != 0; ++c)
+        {
+            int id = (int)(entry - 1);
+            if (within_epsilon(ni, dict_block(dict, id), block))
+            {
+                ++ni->matches;
+                return id;
+            }
+            entry = ni->next[(size_t)t * (size_t)ni->capacity + (size_t)id];
+        }
+    }
+    return -1;
+}
+
+void near_add(NearIndex *ni, const Dictionary *dict, int id)
+{
+    if (id >= ni->capacity)
+        near_grow(ni, dict, id + 1);
+    near_link(ni, dict, id);
+    ni->size = id + 1;
+}
@@ -0,0 +1,562 @@
+#include "../include/segments.h"
+#include "../include/crc32c.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENTS_MAX_THREADS 256
+
+typedef struct
+{
+    uint64_t offset;        // segment header 위치
+    uint64_t first_sample;  // 앞 segment 들의 sample 수 합
+    uint32_t stream_bytes;
+    uint32_t sample_count;
+    uint32_t crc;
+} SegmentEntry;
+
+// mmap 한 DDPS 파일과 segment 목록
+typedef struct
+{
+    const unsigned char *file;
+    size_t file_size;
+    int width_bytes;
+    SegmentEntry *segs;
+    size_t num_segs;
+    uint64_t total_samples;
+    int recovered;  // 1: footer 를 못 써서 header 를 따라가며 찾은 목록
+} SegmentFile;
+
+// thread 하나의 작업. 압축은 segment 하나, 검사/복원은 t, t + threads, ... 번째 segment.
+typedef struct
+{
+    const SegmentFile *sf;
+    int t;
+    int threads;
+    const DecompressOptions *dopts;
+    unsigned char *out;   // 복원: 출력 mapping (NULL 이면 검사만)
+    unsigned char *bad;   // segment 별 실패 표시
+    const unsigned char *src;
+    size_t nbytes;
+    int width_bytes;
+    int block_size_samples;
+    const CompressOptions *copts;
+    DdpContext ctx;
+    const unsigned char *stream;
+    size_t stream_len;
+    uint32_t crc;
+    int ret;
+} SegmentJob;
+
+static uint32_t load_u32_le(const unsigned char *b)
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t load_u64_le(const unsigned char *b)
+{
+    return (uint64_t)load_u32_le(b) | ((uint64_t)load_u32_le(b + 4) << 32);
+}
+
+static int put_u64le(BinWriter *w, uint64_t v)
+{
+    return bw_put_u32le(w, (uint32_t)v) && bw_put_u32le(w, (uint32_t)(v >> 32));
+}
+
+// 만들지 못한 thread 의 작업은 현재 thread 가 한다.
+static void run_jobs(SegmentJob *jobs, int n, void *(*worker)(void *))
+{
+    pthread_t tids[SEGMENTS_MAX_THREADS];
+    int started[SEGMENTS_MAX_THREADS];
+    for (int i = 1; i < n; ++i)
+        started[i] = pthread_create(&tids[i], NULL, worker, &jobs[i]) == 0;
+    worker(&jobs[0]);
+    for (int i = 1; i < n; ++i)
+    {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+        else
+            worker(&jobs[i]);
+    }
+}
+
+static void *compress_worker(void *arg)
+{
+    SegmentJob *job = (SegmentJob *)arg;
+    job->ret = ddp_compress_buf(&job->ctx, job->src, job->nbytes, job->width_bytes,
+                                job->block_size_samples, job->copts, &job->stream, &job->stream_len);
+    if (job->ret == 0 && job->stream_len > UINT32_MAX)
+    {
+        fprintf(stderr, "Segment stream is larger than 4 GiB, use a smaller -S\n");
+        job->ret = 1;
+    }
+    if (job->ret == 0)
+        job->crc = crc32c(0, job->stream, job->stream_len);
+    return NULL;
+}
+
+int compress_segmented(const char *input_filename, const char *output_filename,
+                       int width_bytes, int block_size_samples, const CompressOptions *opts)
+{
+    uint64_t seg_samples = (uint64_t)opts->segment_blocks * (uint64_t)block_size_samples;
+    if (seg_samples > UINT32_MAX)
+    {
+        fprintf(stderr, "Segment of %u blocks is too large for the DDP header\n", opts->segment_blocks);
+        return 1;
+    }
+    const unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file(input_filename, &data, &nbytes) != 0)
+        return 1;
+    uint64_t total_samples = nbytes / (size_t)width_bytes;
+    if (total_samples == 0)
+    {
+        fprintf(stderr, "Input file too small\n");
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    uint64_t num_segs_u64 = (total_samples + seg_samples - 1) / seg_samples;
+    if (num_segs_u64 > UINT32_MAX)
+    {
+        fprintf(stderr, "Too many segments, use a larger -S\n");
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    size_t num_segs = (size_t)num_segs_u64;
+
+    // 공유 dictionary 는 압축할 때마다 항목을 더했다 지우므로 segment 를 차례로, 그 안에서 -j 를 쓴다
+    CompressOptions inner = *opts;
+    inner.segment_blocks = 0;
+    int threads = opts->shared ? 1 : opts->threads;
+    if (!opts->shared)
+        inner.threads = 1;
+    if (threads > SEGMENTS_MAX_THREADS)
+        threads = SEGMENTS_MAX_THREADS;
+
+    SegmentEntry *segs = (SegmentEntry *)malloc(sizeof(SegmentEntry) * num_segs);
+    SegmentJob *jobs = (SegmentJob *)calloc((size_t)threads, sizeof(SegmentJob));
+    int inited = 0;
+    int ok = segs && jobs;
+    for (; ok && inited < threads; ++inited)
+        ok = ddp_context_init(&jobs[inited].ctx) == 0;
+    if (!ok)
+        fprintf(stderr, "Failed to allocate segment state\n");
+    FILE *fp = ok ? fopen(output_filename, "wb") : NULL;
+    BinWriter w;
+    if (ok && !fp)
+    {
+        perror("fopen output");
+        ok = 0;
+    }
+    else if (fp && bw_init(&w, fp) != 0)
+    {
+        fclose(fp);
+        fp = NULL;
+        ok = 0;
+    }
+
+    if (ok)
+    {
+        const unsigned char pad[3] = { 0 };
+        ok = bw_write(&w, "DDPS", 4) && bw_put_u8(&w, (uint8_t)width_bytes) && bw_write(&w, pad, 3) &&
+             bw_put_u32le(&w, (uint32_t)block_size_samples) && bw_put_u32le(&w, opts->segment_blocks);
+    }
+    uint64_t offset = SEGMENTS_HEADER_SIZE;
+    size_t stream_total = 0;
+    for (size_t s0 = 0; ok && s0 < num_segs; s0 += (size_t)threads)
+    {
+        int n = (int)(num_segs - s0 < (size_t)threads ? num_segs - s0 : (size_t)threads);
+        for (int i = 0; i < n; ++i)
+        {
+            uint64_t first = (uint64_t)(s0 + (size_t)i) * seg_samples;
+            uint64_t count = total_samples - first < seg_samples ? total_samples - first : seg_samples;
+            jobs[i].src = data + first * (uint64_t)width_bytes;
+            jobs[i].nbytes = (size_t)count * (size_t)width_bytes;
+            jobs[i].width_bytes = width_bytes;
+            jobs[i].block_size_samples = block_size_samples;
+            jobs[i].copts = &inner;
+            segs[s0 + (size_t)i].first_sample = first;
+            segs[s0 + (size_t)i].sample_count = (uint32_t)count;
+        }
+        run_jobs(jobs, n, compress_worker);
+        for (int i = 0; ok && i < n; ++i)
+        {
+            SegmentEntry *e = &segs[s0 + (size_t)i];
+            if (jobs[i].ret != 0)
+            {
+                fprintf(stderr, "Failed to compress segment %zu\n", s0 + (size_t)i);
+                ok = 0;
+                break;
+            }
+            e->offset = offset;
+            e->stream_bytes = (uint32_t)jobs[i].stream_len;
+            e->crc = jobs[i].crc;
+            ok = bw_write(&w, "DSEG", 4) && bw_put_u32le(&w, e->stream_bytes) &&
+                 bw_put_u32le(&w, e->sample_count) && bw_put_u32le(&w, e->crc) &&
+                 bw_write(&w, jobs[i].stream, jobs[i].stream_len);
+            offset += SEGMENT_HEADER_SIZE + e->stream_bytes;
+            stream_total += jobs[i].stream_len;
+        }
+        release_mapped_prefix(data, (size_t)(segs[s0 + (size_t)n - 1].first_sample +
+                                             segs[s0 + (size_t)n - 1].sample_count) * (size_t)width_bytes);
+    }
+
+    if (ok)
+    {
+        // footer index 를 메모리에 모아 checksum 을 낸 뒤 쓴다
+        BinWriter index;
+        ok = bw_init_mem(&index) == 0;
+        for (size_t s = 0; ok && s < num_segs; ++s)
+            ok = put_u64le(&index, segs[s].offset) && bw_put_u32le(&index, segs[s].stream_bytes) &&
+                 bw_put_u32le(&index, segs[s].sample_count) && bw_put_u32le(&index, segs[s].crc) &&
+                 bw_put_u32le(&index, 0);
+        ok = ok && bw_write(&w, index.buf, index.len) &&
+             bw_put_u32le(&w, (uint32_t)num_segs) &&
+             bw_put_u32le(&w, crc32c(0, index.buf, index.len)) &&
+             put_u64le(&w, offset) && bw_write(&w, "DDPE", 4);
+        bw_free(&index);
+    }
+    if (fp)
+    {
+        if (bw_flush(&w) != 0)
+            ok = 0;
+        if (fclose(fp) != 0)
+            ok = 0;
+        bw_free(&w);
+        if (!ok)
+            fprintf(stderr, "Failed to write output\n");
+    }
+    if (ok)
+        fprintf(stderr, "Compressed (segmented): samples=%llu, block_size_samples=%d, segments=%zu, segment_blocks=%u, stream_bytes=%zu\n",
+                (unsigned long long)total_samples, block_size_samples, num_segs, opts->segment_blocks,
+                stream_total);
+    for (int i = 0; i < inited; ++i)
+        ddp_context_free(&jobs[i].ctx);
+    free(jobs);
+    free(segs);
+    unmap_binary_file(data, nbytes);
+    return ok ? 0 : 1;
+}
+
+int is_segmented_file(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return 0;
+    unsigned char magic[4];
+    int yes = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "DDPS", 4) == 0;
+    fclose(fp);
+    return yes;
+}
+
+// e 의 segment header 와 stream 이 limit 안에 있고 header 가 e 와 같으면 1 (checksum 은 보지 않는다).
+static int segment_header_ok(const SegmentFile *sf, const SegmentEntry *e, uint64_t limit)
+{
+    if (e->offset > limit || limit - e->offset < SEGMENT_HEADER_SIZE ||
+        limit - e->offset - SEGMENT_HEADER_SIZE < e->stream_bytes)
+        return 0;
+    const unsigned char *h = sf->file + e->offset;
+    return memcmp(h, "DSEG", 4) == 0 && load_u32_le(h + 4) == e->stream_bytes &&
+           load_u32_le(h + 8) == e->sample_count && load_u32_le(h + 12) == e->crc;
+}
+
+static int segment_crc_ok(const SegmentFile *sf, const SegmentEntry *e)
+{
+    return crc32c(0, sf->file + e->offset + SEGMENT_HEADER_SIZE, e->stream_bytes) == e->crc;
+}
+
+// footer index 를 읽는다. 없거나 맞지 않으면 0.
+static int read_footer(SegmentFile *sf)
+{
+    if (sf->file_size < SEGMENTS_HEADER_SIZE + SEGMENTS_TRAILER_SIZE)
+        return 0;
+    const unsigned char *t = sf->file + sf->file_size - SEGMENTS_TRAILER_SIZE;
+    if (memcmp(t + 16, "DDPE", 4) != 0)
+        return 0;
+    uint64_t num = load_u32_le(t);
+    uint64_t index_offset = load_u64_le(t + 8);
+    uint64_t index_end = sf->file_size - SEGMENTS_TRAILER_SIZE;
+    if (index_offset < SEGMENTS_HEADER_SIZE || index_offset > index_end ||
+        (index_end - index_offset) != num * SEGMENT_ENTRY_SIZE ||
+        crc32c(0, sf->file + index_offset, (size_t)(index_end - index_offset)) != load_u32_le(t + 4))
+        return 0;
+
+    sf->segs = (SegmentEntry *)malloc(sizeof(SegmentEntry) * (num ? num : 1));
+    if (!sf->segs)
+        return 0;
+    uint64_t expect = SEGMENTS_HEADER_SIZE;
+    uint64_t first = 0;
+    for (uint64_t i = 0; i < num; ++i)
+    {
+        const unsigned char *p = sf->file + index_offset + i * SEGMENT_ENTRY_SIZE;
+        SegmentEntry *e = &sf->segs[i];
+        e->offset = load_u64_le(p);
+        e->stream_bytes = load_u32_le(p + 8);
+        e->sample_count = load_u32_le(p + 12);
+        e->crc = load_u32_le(p + 16);
+        e->first_sample = first;
+        if (e->offset != expect || !segment_header_ok(sf, e, index_offset))
+        {
+            free(sf->segs);
+            sf->segs = NULL;
+            return 0;
+        }
+        expect = e->offset + SEGMENT_HEADER_SIZE + e->stream_bytes;
+        first += e->sample_count;
+    }
+    if (expect != index_offset)
+    {
+        free(sf->segs);
+        sf->segs = NULL;
+        return 0;
+    }
+    sf->num_segs = (size_t)num;
+    sf->total_samples = first;
+    return 1;
+}
+
+// footer 없이 header 를 따라가며 checksum 이 맞는 segment 까지 모은다.
+static int scan_segments(SegmentFile *sf)
+{
+    size_t cap = 64;
+    sf->segs = (SegmentEntry *)malloc(sizeof(SegmentEntry) * cap);
+    if (!sf->segs)
+        return 1;
+    uint64_t pos = SEGMENTS_HEADER_SIZE;
+    uint64_t first = 0;
+    while (sf->file_size - pos >= SEGMENT_HEADER_SIZE)
+    {
+        const unsigned char *h = sf->file + pos;
+        SegmentEntry e = { pos, first, load_u32_le(h + 4), load_u32_le(h + 8), load_u32_le(h + 12) };
+        if (!segment_header_ok(sf, &e, sf->file_size) || !segment_crc_ok(sf, &e))
+            break;
+        if (sf->num_segs == cap)
+        {
+            SegmentEntry *grown = (SegmentEntry *)realloc(sf->segs, sizeof(SegmentEntry) * cap * 2);
+            if (!grown)
+                return 1;
+            sf->segs = grown;
+            cap *= 2;
+        }
+        sf->segs[sf->num_segs++] = e;
+        pos += SEGMENT_HEADER_SIZE + e.stream_bytes;
+        first += e.sample_count;
+    }
+    sf->total_samples = first;
+    sf->recovered = 1;
+    return 0;
+}
+
+static int open_segment_file(const char *filename, SegmentFile *sf)
+{
+    memset(sf, 0, sizeof(*sf));
+    if (map_binary_file(filename, &sf->file, &sf->file_size) != 0)
+        return 1;
+    if (sf->file_size < SEGMENTS_HEADER_SIZE || memcmp(sf->file, "DDPS", 4) != 0)
+    {
+        fprintf(stderr, "Invalid magic, not a segmented DDPS file\n");
+        unmap_binary_file(sf->file, sf->file_size);
+        return 1;
+    }
+    sf->width_bytes = sf->file[4];
+    if (!(sf->width_bytes == 1 || sf->width_bytes == 2 || sf->width_bytes == 4 || sf->width_bytes == 8))
+    {
+        fprintf(stderr, "Invalid width_bytes in segmented header\n");
+        unmap_binary_file(sf->file, sf->file_size);
+        return 1;
+    }
+    if (read_footer(sf))
+        return 0;
+    if (scan_segments(sf) != 0)
+    {
+        fprintf(stderr, "Failed to allocate segment index\n");
+        free(sf->segs);
+        unmap_binary_file(sf->file, sf->file_size);
+        return 1;
+    }
+    fprintf(stderr, "Footer index missing or damaged: found %zu intact segments (%llu samples) by scanning\n",
+            sf->num_segs, (unsigned long long)sf->total_samples);
+    return 0;
+}
+
+static void close_segment_file(SegmentFile *sf)
+{
+    free(sf->segs);
+    unmap_binary_file(sf->file, sf->file_size);
+    memset(sf, 0, sizeof(*sf));
+}
+
+// segment k 의 checksum 을 확인하고 dst 가 있으면 그 segment 의 샘플을 복원해 쓴다. 실패 시 1.
+static int decode_segment(const SegmentFile *sf, size_t k, DdpContext *ctx, const SharedDict *shared,
+                          uint64_t skip_samples, uint64_t count, unsigned char *dst)
+{
+    const SegmentEntry *e = &sf->segs[k];
+    if (!segment_crc_ok(sf, e))
+    {
+        fprintf(stderr, "Segment %zu: checksum mismatch\n", k);
+        return 1;
+    }
+    if (!dst)
+        return 0;
+    const unsigned char *out = NULL;
+    size_t out_len = 0;
+    size_t width = (size_t)sf->width_bytes;
+    if (ddp_decompress_buf(ctx, sf->file + e->offset + SEGMENT_HEADER_SIZE, e->stream_bytes,
+                           shared, &out, &out_len) != 0 ||
+        out_len != (size_t)e->sample_count * width)
+    {
+        fprintf(stderr, "Segment %zu: failed to decode\n", k);
+        return 1;
+    }
+    memcpy(dst, out + skip_samples * width, (size_t)count * width);
+    return 0;
+}
+
+static void *segment_worker(void *arg)
+{
+    SegmentJob *job = (SegmentJob *)arg;
+    const SegmentFile *sf = job->sf;
+    const SharedDict *shared = job->dopts ? job->dopts->shared : NULL;
+    for (size_t k = (size_t)job->t; k < sf->num_segs; k += (size_t)job->threads)
+    {
+        const SegmentEntry *e = &sf->segs[k];
+        unsigned char *dst = job->out ? job->out + e->first_sample * (uint64_t)sf->width_bytes : NULL;
+        if (decode_segment(sf, k, &job->ctx, shared, 0, e->sample_count, dst) != 0)
+            job->bad[k] = 1;
+    }
+    return NULL;
+}
+
+// 모든 segment 를 threads 개 thread 로 확인 (out 이 있으면 복원) 한다. 깨진 segment 수를 돌려준다.
+static size_t run_segments(const SegmentFile *sf, int threads, const DecompressOptions *dopts,
+                           unsigned char *out, int *failed)
+{
+    if (threads > SEGMENTS_MAX_THREADS)
+        threads = SEGMENTS_MAX_THREADS;
+    if ((size_t)threads > sf->num_segs)
+        threads = sf->num_segs ? (int)sf->num_segs : 1;
+    unsigned char *bad = (unsigned char *)calloc(sf->num_segs ? sf->num_segs : 1, 1);
+    SegmentJob *jobs = (SegmentJob *)calloc((size_t)threads, sizeof(SegmentJob));
+    int inited = 0;
+    *failed = !bad || !jobs;
+    for (; !*failed && inited < threads; ++inited)
+        *failed = ddp_context_init(&jobs[inited].ctx) != 0;
+    size_t num_bad = 0;
+    if (!*failed)
+    {
+        for (int t = 0; t < threads; ++t)
+        {
+            jobs[t].sf = sf;
+            jobs[t].t = t;
+            jobs[t].threads = threads;
+            jobs[t].dopts = dopts;
+            jobs[t].out = out;
+            jobs[t].bad = bad;
+        }
+        run_jobs(jobs, threads, segment_worker);
+        for (size_t k = 0; k < sf->num_segs; ++k)
+            num_bad += bad[k];
+    }
+    else
+    {
+        fprintf(stderr, "Failed to allocate segment state\n");
+    }
+    for (int t = 0; t < inited; ++t)
+        ddp_context_free(&jobs[t].ctx);
+    free(jobs);
+    free(bad);
+    return num_bad;
+}
+
+int decompress_segmented(const char *input_filename, const char *output_filename,
+                         const DecompressOptions *opts)
+{
+    SegmentFile sf;
+    if (open_segment_file(input_filename, &sf) != 0)
+        return 1;
+    size_t out_bytes = (size_t)(sf.total_samples * (uint64_t)sf.width_bytes);
+    unsigned char *out = NULL;
+    if (create_mapped_file(output_filename, out_bytes, &out) != 0)
+    {
+        close_segment_file(&sf);
+        return 1;
+    }
+    int failed = 0;
+    size_t num_bad = run_segments(&sf, opts->threads, opts, out, &failed);
+    if (close_mapped_file(out, out_bytes) != 0)
+        failed = 1;
+    if (num_bad > 0)
+        fprintf(stderr, "%zu of %zu segments failed to decode\n", num_bad, sf.num_segs);
+    int ret = failed || num_bad > 0 || sf.recovered;
+    close_segment_file(&sf);
+    return ret;
+}
+
+int decompress_segmented_range(const char *input_filename, uint64_t start_sample, uint64_t count,
+                               const char *output_filename)
+{
+    SegmentFile sf;
+    if (open_segment_file(input_filename, &sf) != 0)
+        return 1;
+    if (start_sample > sf.total_samples || count > sf.total_samples - start_sample)
+    {
+        fprintf(stderr, "Range [%llu, %llu) is outside the %llu stored samples\n",
+                (unsigned long long)start_sample, (unsigned long long)(start_sample + count),
+                (unsigned long long)sf.total_samples);
+        close_segment_file(&sf);
+        return 1;
+    }
+    size_t width = (size_t)sf.width_bytes;
+    unsigned char *buf = (unsigned char *)malloc((size_t)count * width + 1);
+    DdpContext ctx;
+    int ret = !buf || ddp_context_init(&ctx) != 0;
+    if (ret)
+    {
+        fprintf(stderr, "Failed to allocate range buffer\n");
+        free(buf);
+        close_segment_file(&sf);
+        return 1;
+    }
+
+    // first_sample 이 오름차순이므로 구간 시작을 담은 segment 를 이분 탐색으로 찾는다
+    size_t lo = 0, hi = sf.num_segs;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sf.segs[mid].first_sample <= start_sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    uint64_t done = 0;
+    for (size_t k = lo; ret == 0 && done < count; ++k)
+    {
+        const SegmentEntry *e = &sf.segs[k];
+        uint64_t skip = start_sample + done - e->first_sample;
+        uint64_t n = e->sample_count - skip < count - done ? e->sample_count - skip : count - done;
+        ret = decode_segment(&sf, k, &ctx, NULL, skip, n, buf + done * width);
+        done += n;
+    }
+    if (ret == 0)
+        ret = write_binary_file(output_filename, buf, (size_t)count * width);
+    ddp_context_free(&ctx);
+    free(buf);
+    ret = ret || sf.recovered;
+    close_segment_file(&sf);
+    return ret;
+}
+
+int verify_segmented(const char *input_filename, int threads)
+{
+    SegmentFile sf;
+    if (open_segment_file(input_filename, &sf) != 0)
+        return 1;
+    int failed = 0;
+    size_t num_bad = run_segments(&sf, threads, NULL, NULL, &failed);
+    fprintf(stderr, "Verified: segments=%zu, bad=%zu, samples=%llu%s\n", sf.num_segs, num_bad,
+            (unsigned long long)sf.total_samples, sf.recovered ? " (footer missing)" : "");
+    int ret = failed || num_bad > 0 || sf.recovered;
+    close_segment_file(&sf);
+    return ret;
+}
@@ -0,0 +1,759 @@
+#define _DEFAULT_SOURCE
+#include "../include/server.h"
+#include "../include/batch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_MAX_WORKERS 256
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_LINE_MAX 8192
+#define SERVER_JOB_QUEUE 1024  // 받아 두고 아직 읽기 시작하지 않은 작업 수 상한
+
+// 닫힌 뒤 push 는 실패하고 pop 은 남은 항목을 다 꺼낸 다음 NULL 을 돌려준다.
+typedef struct
+{
+    void **items;
+    size_t cap;
+    size_t head;
+    size_t count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} Queue;
+
+typedef struct
+{
+    int fd;
+    int refs;  // main loop 의 연결 1 + 답을 기다리는 작업 수 (Server.client_lock)
+    size_t len;
+    int overflow;  // SERVER_LINE_MAX 보다 긴 줄을 버리는 중
+    char line[SERVER_LINE_MAX];
+} Client;
+
+typedef struct
+{
+    char *input;
+    char *output;
+    Client *client;  // socket 으로 받은 작업이면 답할 연결
+} Job;
+
+// pipeline 을 도는 자리. buffer 와 context 는 작업 사이에 그대로 남아 다음 작업이 재사용한다.
+typedef struct
+{
+    Job *job;
+    unsigned char *buf;
+    size_t cap;
+    size_t len;
+    DdpContext ctx;
+    const unsigned char *out;
+    size_t out_len;
+    int ret;
+} Slot;
+
+typedef struct
+{
+    const ServerOptions *server;
+    int width_bytes;
+    int block_size_samples;
+    CompressOptions opts;  // worker 용 복사본 (threads 는 작업 하나 안의 fingerprint thread 수)
+    Queue jobs;
+    Queue free_slots;
+    Queue to_dedup;
+    Queue to_write;
+    pthread_mutex_t client_lock;  // Client.refs 와 연결에 쓰기
+    size_t done;    // writer thread 만 고친다
+    size_t failed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} Server;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int queue_init(Queue *q, size_t cap)
+{
+    q->items = (void **)malloc(sizeof(void *) * cap);
+    q->cap = cap;
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return q->items == NULL;
+}
+
+static void queue_free(Queue *q)
+{
+    free(q->items);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+// 자리가 날 때까지 기다린다. 닫혔으면 넣지 않고 1.
+static int queue_push(Queue *q, void *item)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->cap && !q->closed)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    int closed = q->closed;
+    if (!closed)
+    {
+        q->items[(q->head + q->count) % q->cap] = item;
+        ++q->count;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return closed;
+}
+
+static void *queue_pop(Queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    void *item = NULL;
+    if (q->count > 0)
+    {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->cap;
+        --q->count;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+static void queue_close(Queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void job_free(Job *job)
+{
+    free(job->input);
+    free(job->output);
+    free(job);
+}
+
+// 끊긴 연결이면 답을 버린다 (SIGPIPE 없이).
+static void client_send(Server *s, Client *c, const char *status, const char *path)
+{
+    char msg[SERVER_LINE_MAX + 16];
+    int n = snprintf(msg, sizeof(msg), "%s %s\n", status, path);
+    if (n < 0)
+        return;
+    if ((size_t)n >= sizeof(msg))
+    {
+        n = (int)sizeof(msg) - 1;
+        msg[n - 1] = '\n';
+    }
+    pthread_mutex_lock(&s->client_lock);
+    ssize_t sent = send(c->fd, msg, (size_t)n, MSG_NOSIGNAL);
+    pthread_mutex_unlock(&s->client_lock);
+    (void)sent;
+}
+
+// 연결 참조를 하나 놓고 마지막이면 닫는다.
+static void client_unref(Server *s, Client *c)
+{
+    pthread_mutex_lock(&s->client_lock);
+    int last = --c->refs == 0;
+    pthread_mutex_unlock(&s->client_lock);
+    if (last)
+    {
+        close(c->fd);
+        free(c);
+    }
+}
+
+// slot 의 buffer 를 (모자라면 키워서) 파일 내용으로 채운다. 실패 시 1.
+static int read_input(Slot *slot, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size > slot->cap)
+    {
+        unsigned char *grown = (unsigned char *)realloc(slot->buf, size);
+        if (!grown)
+        {
+            fprintf(stderr, "Failed to allocate input buffer for %s\n", path);
+            close(fd);
+            return 1;
+        }
+        slot->buf = grown;
+        slot->cap = size;
+    }
+    size_t got = 0;
+    while (got < size)
+    {
+        ssize_t n = read(fd, slot->buf + got, size - got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (got != size)
+    {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return 1;
+    }
+    slot->len = size;
+    return 0;
+}
+
+// <path>.tmp 에 다 쓴 다음 path 로 rename 한다. 실패 시 1.
+static int write_output(const char *path, const unsigned char *data, size_t n)
+{
+    size_t len = strlen(path) + sizeof(".tmp");
+    char *tmp = (char *)malloc(len);
+    if (!tmp)
+    {
+        fprintf(stderr, "Failed to allocate path\n");
+        return 1;
+    }
+    snprintf(tmp, len, "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    int ok = fp != NULL;
+    if (ok)
+        ok = fwrite(data, 1, n, fp) == n;
+    if (fp && fclose(fp) != 0)
+        ok = 0;
+    if (ok && rename(tmp, path) != 0)
+        ok = 0;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        remove(tmp);
+    }
+    free(tmp);
+    return !ok;
+}
+
+static void *reader_thread(void *arg)
+{
+    Server *s = (Server *)arg;
+    Job *job;
+    while ((job = (Job *)queue_pop(&s->jobs)) != NULL)
+    {
+        Slot *slot = (Slot *)queue_pop(&s->free_slots);
+        slot->job = job;
+        slot->ret = read_input(slot, job->input);
+        queue_push(&s->to_dedup, slot);
+    }
+    queue_close(&s->to_dedup);
+    return NULL;
+}
+
+static void *dedup_thread(void *arg)
+{
+    Server *s = (Server *)arg;
+    Slot *slot;
+    while ((slot = (Slot *)queue_pop(&s->to_dedup)) != NULL)
+    {
+        if (slot->ret == 0)
+            slot->ret = ddp_compress_buf(&slot->ctx, slot->buf, slot->len, s->width_bytes,
+                                         s->block_size_samples, &s->opts, &slot->out, &slot->out_len);
+        queue_push(&s->to_write, slot);
+    }
+    return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+    Server *s = (Server *)arg;
+    Slot *slot;
+    while ((slot = (Slot *)queue_pop(&s->to_write)) != NULL)
+    {
+        Job *job = slot->job;
+        int ret = slot->ret || write_output(job->output, slot->out, slot->out_len);
+        if (ret == 0)
+        {
+            fprintf(stderr, "%s -> %s (%zu -> %zu bytes)\n", job->input, job->output, slot->len, slot->out_len);
+            ++s->done;
+            s->bytes_in += slot->len;
+            s->bytes_out += slot->out_len;
+        }
+        else
+        {
+            fprintf(stderr, "Failed: %s\n", job->input);
+            ++s->failed;
+        }
+        if (job->client)
+        {
+            client_send(s, job->client, ret ? "error" : "ok", ret ? job->input : job->output);
+            client_unref(s, job->client);
+        }
+        job_free(job);
+        slot->job = NULL;
+        queue_push(&s->free_slots, slot);
+    }
+    return NULL;
+}
+
+// 작업을 pipeline 에 넣는다. 자리가 없으면 reader 가 꺼낼 때까지 기다린다. 실패 시 1.
+static int submit(Server *s, const char *input, char *output, Client *client)
+{
+    Job *job = (Job *)calloc(1, sizeof(Job));
+    if (job)
+        job->input = strdup(input);
+    if (!job || !job->input || !output)
+    {
+        fprintf(stderr, "Failed to allocate job\n");
+        if (job)
+            free(job->input);
+        free(job);
+        free(output);
+        return 1;
+    }
+    job->output = output;
+    if (client)
+    {
+        pthread_mutex_lock(&s->client_lock);
+        ++client->refs;
+        pthread_mutex_unlock(&s->client_lock);
+        job->client = client;
+    }
+    queue_push(&s->jobs, job);
+    return 0;
+}
+
+static char *join_path(const char *dir, const char *name)
+{
+    size_t n = strlen(dir) + strlen(name) + 2;
+    char *path = (char *)malloc(n);
+    if (path)
+        snprintf(path, n, "%s/%s", dir, name);
+    return path;
+}
+
+static int newer_than(const struct stat *a, const struct stat *b)
+{
+    return a->st_mtim.tv_sec > b->st_mtim.tv_sec ||
+           (a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec > b->st_mtim.tv_nsec);
+}
+
+// watch_dir 의 파일 name 을 압축한다. only_stale 이면 출력이 입력보다 새것일 때 건너뛴다.
+static void submit_watched(Server *s, const char *name, int only_stale)
+{
+    char *input = join_path(s->server->watch_dir, name);
+    char *output = batch_output_path(s->server->output_dir, name);
+    struct stat in_st, out_st;
+    if (input && output && only_stale &&
+        (stat(input, &in_st) != 0 || !S_ISREG(in_st.st_mode) ||
+         (stat(output, &out_st) == 0 && !newer_than(&in_st, &out_st))))
+    {
+        free(input);
+        free(output);
+        return;
+    }
+    if (input)
+        submit(s, input, output, NULL);
+    else
+        free(output);
+    free(input);
+}
+
+// 시작할 때와 inotify queue 가 넘쳐 event 를 잃었을 때 이미 있는 파일을 훑는다.
+static void scan_watch_dir(Server *s)
+{
+    char **names = NULL;
+    size_t count = 0;
+    if (batch_list_files(s->server->watch_dir, &names, &count) != 0)
+        return;
+    for (size_t i = 0; i < count; ++i)
+    {
+        submit_watched(s, names[i], 1);
+        free(names[i]);
+    }
+    free(names);
+}
+
+static void handle_events(Server *s, int fd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len <= 0)
+        return;
+    for (char *p = buf; p < buf + len;)
+    {
+        const struct inotify_event *ev = (const struct inotify_event *)p;
+        if (ev->mask & IN_Q_OVERFLOW)
+            scan_watch_dir(s);
+        else if (ev->len > 0 && ev->name[0] != '.' && !(ev->mask & IN_ISDIR))
+            submit_watched(s, ev->name, 0);
+        p += sizeof(struct inotify_event) + ev->len;
+    }
+}
+
+// socket 에서 받은 한 줄: "<input>" 또는 "<input>\t<output>".
+static void handle_line(Server *s, Client *c)
+{
+    c->line[c->len] = '\0';
+    if (c->len > 0 && c->line[c->len - 1] == '\r')
+        c->line[--c->len] = '\0';
+    if (c->len == 0)
+        return;
+    char *tab = strchr(c->line, '\t');
+    char *output;
+    if (tab)
+    {
+        *tab = '\0';
+        output = tab[1] != '\0' ? strdup(tab + 1) : NULL;
+    }
+    else
+    {
+        const char *slash = strrchr(c->line, '/');
+        output = batch_output_path(s->server->output_dir, slash ? slash + 1 : c->line);
+    }
+    if (c->line[0] == '\0' || !output)
+    {
+        client_send(s, c, "error", c->line);
+        free(output);
+        return;
+    }
+    if (submit(s, c->line, output, c) != 0)
+        client_send(s, c, "error", c->line);
+}
+
+// 연결이 끝났으면 1.
+static int handle_client(Server *s, Client *c)
+{
+    char buf[4096];
+    ssize_t n = read(c->fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+        return 0;
+    if (n <= 0)
+        return 1;
+    for (ssize_t i = 0; i < n; ++i)
+    {
+        if (buf[i] == '\n')
+        {
+            if (c->overflow)
+                client_send(s, c, "error", "line too long");
+            else
+                handle_line(s, c);
+            c->len = 0;
+            c->overflow = 0;
+        }
+        else if (c->len + 1 < SERVER_LINE_MAX)
+        {
+            c->line[c->len++] = buf[i];
+        }
+        else
+        {
+            c->overflow = 1;
+        }
+    }
+    return 0;
+}
+
+// 같은 경로에 살아 있는 server 가 없으면 남은 socket 파일을 지우고 bind 한다. 실패 시 -1.
+static int open_listener(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            fprintf(stderr, "Another server is listening on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+        close(fd);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+    if (fd < 0 || bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+        fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int check_server_args(const ServerOptions *server, int width_bytes, int block_size_samples,
+                             const CompressOptions *opts)
+{
+    if (!(width_bytes == 1 || width_bytes == 2 || width_bytes == 4 || width_bytes == 8))
+    {
+        fprintf(stderr, "width_bytes must be 1,2,4,8\n");
+        return 1;
+    }
+    if (block_size_samples < 0)
+    {
+        fprintf(stderr, "block_size_samples must be positive (or 0 for auto)\n");
+        return 1;
+    }
+    if (opts->stream || opts->cdc || opts->segment_blocks > 0 || opts->dict_limit_bytes > 0)
+    {
+        fprintf(stderr, "Server mode does not support -s, -c, -S or -M\n");
+        return 1;
+    }
+    if (!server->watch_dir && !server->socket_path)
+    {
+        fprintf(stderr, "Nothing to serve: give a directory to watch or -L <socket>\n");
+        return 1;
+    }
+    struct stat out_st, in_st;
+    if (stat(server->output_dir, &out_st) != 0 || !S_ISDIR(out_st.st_mode))
+    {
+        fprintf(stderr, "Output directory %s does not exist\n", server->output_dir);
+        return 1;
+    }
+    if (server->watch_dir)
+    {
+        if (stat(server->watch_dir, &in_st) != 0 || !S_ISDIR(in_st.st_mode))
+        {
+            fprintf(stderr, "Watch directory %s does not exist\n", server->watch_dir);
+            return 1;
+        }
+        // 출력이 다시 event 로 들어와 압축되지 않도록
+        if (in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino)
+        {
+            fprintf(stderr, "Output directory must differ from the watched directory\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int run_server(const ServerOptions *server, int width_bytes, int block_size_samples,
+               const CompressOptions *opts)
+{
+    if (check_server_args(server, width_bytes, block_size_samples, opts) != 0)
+        return 1;
+
+    Server s;
+    memset(&s, 0, sizeof(s));
+    s.server = server;
+    s.width_bytes = width_bytes;
+    s.block_size_samples = block_size_samples;
+    s.opts = *opts;
+    // 공유 dictionary 는 압축할 때마다 항목을 더했다 지우므로 worker 는 하나, 그 안에서 -j 를 쓴다
+    int workers = opts->shared ? 1 : opts->threads;
+    if (!opts->shared)
+        s.opts.threads = 1;
+    if (workers > SERVER_MAX_WORKERS)
+        workers = SERVER_MAX_WORKERS;
+    int depth = server->queue_depth > 0 ? server->queue_depth : 2 * workers + 2;
+
+    int watch_fd = -1;
+    if (server->watch_dir)
+    {
+        watch_fd = inotify_init1(IN_CLOEXEC);
+        if (watch_fd < 0 || inotify_add_watch(watch_fd, server->watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            fprintf(stderr, "Failed to watch %s: %s\n", server->watch_dir, strerror(errno));
+            if (watch_fd >= 0)
+                close(watch_fd);
+            return 1;
+        }
+    }
+    int listen_fd = -1;
+    if (server->socket_path && (listen_fd = open_listener(server->socket_path)) < 0)
+    {
+        if (watch_fd >= 0)
+            close(watch_fd);
+        return 1;
+    }
+
+    Slot *slots = (Slot *)calloc((size_t)depth, sizeof(Slot));
+    int queue_failed = queue_init(&s.jobs, SERVER_JOB_QUEUE);
+    queue_failed |= queue_init(&s.free_slots, (size_t)depth);
+    queue_failed |= queue_init(&s.to_dedup, (size_t)depth);
+    queue_failed |= queue_init(&s.to_write, (size_t)depth);
+    int ok = slots != NULL && !queue_failed;
+    int slots_inited = 0;
+    for (; ok && slots_inited < depth; ++slots_inited)
+    {
+        ok = ddp_context_init(&slots[slots_inited].ctx) == 0;
+        if (ok)
+            queue_push(&s.free_slots, &slots[slots_inited]);
+    }
+    pthread_mutex_init(&s.client_lock, NULL);
+
+    // 신호는 main thread 의 poll 만 깨우도록 pipeline thread 에서는 막아 둔다
+    sigset_t block, old_mask;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old_mask);
+    pthread_t reader, writer, tids[SERVER_MAX_WORKERS];
+    int reader_started = 0, writer_started = 0, started = 0;
+    if (ok)
+        ok = writer_started = pthread_create(&writer, NULL, writer_thread, &s) == 0;
+    for (; ok && started < workers; ++started)
+        ok = pthread_create(&tids[started], NULL, dedup_thread, &s) == 0;
+    if (ok)
+        ok = reader_started = pthread_create(&reader, NULL, reader_thread, &s) == 0;
+    stop_requested = 0;
+    struct sigaction sa, old_int, old_term;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (!ok)
+        fprintf(stderr, "Failed to start the server pipeline\n");
+
+    Client *clients[SERVER_MAX_CLIENTS];
+    int num_clients = 0;
+    if (ok)
+    {
+        fprintf(stderr, "Serving: workers=%d, queue_depth=%d%s%s%s%s\n", workers, depth,
+                server->watch_dir ? ", watch=" : "", server->watch_dir ? server->watch_dir : "",
+                server->socket_path ? ", socket=" : "", server->socket_path ? server->socket_path : "");
+        if (server->watch_dir)
+            scan_watch_dir(&s);
+    }
+    while (ok && !stop_requested)
+    {
+        struct pollfd fds[2 + SERVER_MAX_CLIENTS];
+        int n = 0;
+        if (watch_fd >= 0)
+            fds[n++] = (struct pollfd){ .fd = watch_fd, .events = POLLIN };
+        if (listen_fd >= 0)
+            fds[n++] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        int first_client = n;
+        for (int i = 0; i < num_clients; ++i)
+            fds[n++] = (struct pollfd){ .fd = clients[i]->fd, .events = POLLIN };
+        if (poll(fds, (nfds_t)n, 1000) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            ok = 0;
+            break;
+        }
+        int k = 0;
+        if (watch_fd >= 0 && (fds[k++].revents & POLLIN))
+            handle_events(&s, watch_fd);
+        if (listen_fd >= 0 && (fds[k++].revents & POLLIN))
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            Client *c = fd >= 0 && num_clients < SERVER_MAX_CLIENTS ? (Client *)calloc(1, sizeof(Client)) : NULL;
+            if (c)
+            {
+                c->fd = fd;
+                c->refs = 1;
+                clients[num_clients++] = c;
+            }
+            else if (fd >= 0)
+            {
+                fprintf(stderr, "Refusing connection: %d clients already connected\n", num_clients);
+                close(fd);
+            }
+        }
+        // 뒤에서부터 돌아야 끝난 연결 자리에 마지막 연결을 옮겨도 다시 보지 않는다
+        for (int i = num_clients - 1; i >= 0; --i)
+        {
+            if ((fds[first_client + i].revents & (POLLIN | POLLHUP | POLLERR)) &&
+                handle_client(&s, clients[i]))
+            {
+                client_unref(&s, clients[i]);
+                clients[i] = clients[--num_clients];
+            }
+        }
+    }
+    if (stop_requested)
+        fprintf(stderr, "Shutting down: finishing queued files\n");
+
+    // 받아 둔 작업은 끝까지 처리한다
+    queue_close(&s.jobs);
+    if (reader_started)
+        pthread_join(reader, NULL);
+    else
+        queue_close(&s.to_dedup);
+    for (int i = 0; i < started; ++i)
+        pthread_join(tids[i], NULL);
+    queue_close(&s.to_write);
+    if (writer_started)
+        pthread_join(writer, NULL);
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+
+    // 시작에 실패했으면 pipeline 에 남은 작업을 버린다
+    Job *job;
+    while ((job = (Job *)queue_pop(&s.jobs)) != NULL)
+        job_free(job);
+    for (int i = 0; i < num_clients; ++i)
+        client_unref(&s, clients[i]);
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        unlink(server->socket_path);
+    }
+    if (watch_fd >= 0)
+        close(watch_fd);
+    for (int i = 0; i < slots_inited; ++i)
+    {
+        if (slots[i].job)
+            job_free(slots[i].job);
+        free(slots[i].buf);
+        ddp_context_free(&slots[i].ctx);
+    }
+    free(slots);
+    queue_free(&s.jobs);
+    queue_free(&s.free_slots);
+    queue_free(&s.to_dedup);
+    queue_free(&s.to_write);
+    pthread_mutex_destroy(&s.client_lock);
+    if (!ok)
+        return 1;
+
+    // 작업 하나의 실패는 그 client 와 요약에만 알린다. pipeline 은 제대로 돌았다
+    fprintf(stderr, "Server: %zu files, %zu failed, %llu -> %llu bytes\n", s.done, s.failed,
+            (unsigned long long)s.bytes_in, (unsigned long long)s.bytes_out);
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "../include/shared_dict.h"
+#include "../include/bin_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHARED_DICT_HEADER_SIZE 24
+#define SHARED_DICT_INDEX_HEADER_SIZE 8
+
+// 저장된 hash/index 배열을 그대로 쓰려면 host 가 little-endian 이어야 한다
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HOST_IS_LE 1
+#else
+#define HOST_IS_LE 0
+#endif
+
+// index 가 이 build 의 dict_hash 로 만든 것인지 고르게 뽑은 항목으로 확인한다
+#define INDEX_HASH_SAMPLES 16
+
+static uint32_t load_u32_le(const unsigned char *b)
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+           ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t load_u64_le(const unsigned char *b)
+{
+    return (uint64_t)load_u32_le(b) | ((uint64_t)load_u32_le(b + 4) << 32);
+}
+
+static size_t index_offset(size_t blocks_end)
+{
+    return (blocks_end + 7) & ~(size_t)7;
+}
+
+// 빌릴 table 을 한 번 훑어 본다. 항목은 0 (빈 slot) 이나 1..dict_size 이고 id 마다 정확히
+// 한 번 나와야 한다. table_size >= 2 * dict_size 이므로 빈 slot 도 남는다. 어긋나면 1.
+static int check_table(const uint32_t *table, size_t table_size, uint32_t dict_size)
+{
+    unsigned char *seen = (unsigned char *)calloc((size_t)dict_size / 8 + 1, 1);
+    if (!seen)
+        return 1;
+    size_t used = 0;
+    int ret = 0;
+    for (size_t i = 0; i < table_size; ++i)
+    {
+        uint32_t entry = table[i];
+        if (entry == 0)
+            continue;
+        uint32_t id = entry - 1;
+        if (id >= dict_size || (seen[id >> 3] & (1u << (id & 7))) != 0)
+        {
+            ret = 1;
+            break;
+        }
+        seen[id >> 3] |= (unsigned char)(1u << (id & 7));
+        ++used;
+    }
+    free(seen);
+    return (ret == 0 && used == dict_size) ? 0 : 1;
+}
+
+// index section 이 온전하면 mapping 위에 dict 를 빌려 만든다. 쓸 수 없으면 1 (block 에서 다시 만든다).
+static int borrow_index(SharedDict *sd, unsigned char *map, size_t nbytes,
+                        size_t block_size_bytes, uint32_t dict_size)
+{
+    size_t blocks_end = SHARED_DICT_HEADER_SIZE + block_size_bytes * dict_size;
+    size_t off = index_offset(blocks_end);
+    if (!HOST_IS_LE || nbytes < off + SHARED_DICT_INDEX_HEADER_SIZE)
+        return 1;
+    uint64_t table_size = load_u64_le(map + off);
+    if (table_size == 0 || (table_size & (table_size - 1)) != 0 ||
+        table_size < (uint64_t)dict_size * 2 || table_size > ((uint64_t)UINT32_MAX + 1) ||
+        nbytes != off + SHARED_DICT_INDEX_HEADER_SIZE + 8 * (size_t)dict_size + 4 * (size_t)table_size)
+        return 1;
+
+    // block 은 복원에 쓰기 전에 shared_dict_verify 가 checksum 으로 확인한다
+    unsigned char *hashes = map + off + SHARED_DICT_INDEX_HEADER_SIZE;
+    uint32_t *table = (uint32_t *)(void *)(hashes + 8 * (size_t)dict_size);
+    if (check_table(table, (size_t)table_size, dict_size) != 0)
+        return 1;
+    dict_borrow(&sd->dict, block_size_bytes, (int)dict_size, map + SHARED_DICT_HEADER_SIZE,
+                (uint64_t *)(void *)hashes, table, (size_t)table_size);
+    for (int k = 0; k < INDEX_HASH_SAMPLES && dict_size > 0; ++k)
+    {
+        int id = (int)((uint64_t)dict_size * (uint64_t)k / INDEX_HASH_SAMPLES);
+        if (dict_hash(&sd->dict, dict_block(&sd->dict, id)) != sd->dict.hashes[id])
+        {
+            dict_free(&sd->dict);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int shared_dict_load(const char *filename, SharedDict *sd)
+{
+    unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (map_binary_file_private(filename, &data, &nbytes) != 0)
+    {
+        return 1;
+    }
+    if (nbytes < SHARED_DICT_HEADER_SIZE ||
+        memcmp(data, "DDPD", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a shared dictionary file\n", filename);
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    int width_bytes = (int)data[4];
+    int flags = (int)data[5];
+    uint32_t block_size_samples = load_u32_le(data + 8);
+    uint32_t dict_size = load_u32_le(data + 12);
+    uint64_t checksum = load_u64_le(data + 16);
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+    size_t stored_blocks = (nbytes - SHARED_DICT_HEADER_SIZE) / (block_size_bytes ? block_size_bytes : 1);
+    int has_index = (flags & SHARED_DICT_FLAG_INDEX) != 0;
+    if (!(width_bytes == 1 || width_bytes == 2 || width_bytes == 4 || width_bytes == 8) ||
+        block_size_samples == 0 || dict_size > (uint32_t)INT32_MAX ||
+        (flags & ~SHARED_DICT_FLAG_INDEX) != 0 ||
+        (has_index ? stored_blocks < dict_size
+                   : stored_blocks != dict_size ||
+                     (nbytes - SHARED_DICT_HEADER_SIZE) % block_size_bytes != 0))
+    {
+        fprintf(stderr, "%s: invalid shared dictionary header\n", filename);
+        unmap_binary_file(data, nbytes);
+        return 1;
+    }
+    sd->base_size = (int)dict_size;
+    sd->width_bytes = width_bytes;
+    sd->block_size_samples = (int)block_size_samples;
+    sd->checksum = checksum;
+    sd->map = NULL;
+    sd->map_bytes = 0;
+    sd->verified = 0;
+
+    if (has_index && borrow_index(sd, data, nbytes, block_size_bytes, dict_size) == 0)
+    {
+        sd->map = data;
+        sd->map_bytes = nbytes;
+        return 0;
+    }
+    if (has_index)
+        fprintf(stderr, "%s: unusable dictionary index, rebuilding it\n", filename);
+
+    dict_init(&sd->dict, block_size_bytes);
+    unsigned char *dst = dict_append_raw(&sd->dict, (int)dict_size);
+    memcpy(dst, data + SHARED_DICT_HEADER_SIZE, block_size_bytes * dict_size);
+    unmap_binary_file(data, nbytes);
+
+    if (dict_checksum(&sd->dict) != checksum)
+    {
+        fprintf(stderr, "%s: shared dictionary checksum mismatch\n", filename);
+        dict_free(&sd->dict);
+        return 1;
+    }
+    sd->verified = 1;
+    dict_reindex(&sd->dict);
+    return 0;
+}
+
+int shared_dict_verify(const char *filename, SharedDict *sd)
+{
+    if (sd->verified)
+        return 0;
+    Dictionary base = sd->dict;
+    base.size = sd->base_size;
+    if (dict_checksum(&base) != sd->checksum)
+    {
+        fprintf(stderr, "%s: shared dictionary checksum mismatch\n", filename);
+        return 1;
+    }
+    sd->verified = 1;
+    return 0;
+}
+
+void shared_dict_free(SharedDict *sd)
+{
+    dict_free(&sd->dict);
+    unmap_binary_file(sd->map, sd->map_bytes);
+    sd->map = NULL;
+    sd->map_bytes = 0;
+    sd->base_size = 0;
+}
+
+static int save_shared_dict(const char *filename, const Dictionary *dict,
+                            int width_bytes, int block_size_samples, int with_index)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        perror("fopen output");
+        return 1;
+    }
+    BinWriter w;
+    if (bw_init(&w, fp) != 0)
+    {
+        fclose(fp);
+        return 1;
+    }
+    uint64_t checksum = dict_checksum(dict);
+    const unsigned char pad[8] = { 0 };
+    int ok = bw_write(&w, "DDPD", 4) &&
+             bw_put_u8(&w, (uint8_t)width_bytes) &&
+             bw_put_u8(&w, with_index ? SHARED_DICT_FLAG_INDEX : 0) &&
+             bw_write(&w, pad, 2) &&
+             bw_put_u32le(&w, (uint32_t)block_size_samples) &&
+             bw_put_u32le(&w, (uint32_t)dict->size) &&
+             bw_put_u32le(&w, (uint32_t)checksum) &&
+             bw_put_u32le(&w, (uint32_t)(checksum >> 32)) &&
+             bw_write(&w, dict->blocks, dict->block_size * (size_t)dict->size);
+    if (ok && with_index)
+    {
+        size_t blocks_end = SHARED_DICT_HEADER_SIZE + dict->block_size * (size_t)dict->size;
+        uint64_t table_size = (uint64_t)dict->table_mask + 1;
+        ok = bw_write(&w, pad, index_offset(blocks_end) - blocks_end) &&
+             bw_put_u32le(&w, (uint32_t)table_size) &&
+             bw_put_u32le(&w, (uint32_t)(table_size >> 32));
+        for (int i = 0; ok && i < dict->size; ++i)
+        {
+            ok = bw_put_u32le(&w, (uint32_t)dict->hashes[i]) &&
+                 bw_put_u32le(&w, (uint32_t)(dict->hashes[i] >> 32));
+        }
+        ok = ok && bw_put_u32le_array(&w, dict->table, (size_t)table_size);
+    }
+    ok = ok && bw_flush(&w) == 0;
+    bw_free(&w);
+    if (fclose(fp) != 0)
+        ok = 0;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write shared dictionary\n");
+        return 1;
+    }
+    fprintf(stderr, "Shared dictionary: entries=%d, checksum=%016llx%s\n",
+            dict->size, (unsigned long long)checksum, with_index ? ", with index" : "");
+    return 0;
+}
+
+int shared_dict_build(const char *filename, const char *const *inputs, int num_inputs,
+                      int width_bytes, int block_size_samples, int min_files, int with_index)
+{
+    if (!(width_bytes == 1 || width_bytes == 2 || width_bytes == 4 || width_bytes == 8) ||
+        block_size_samples <= 0 || num_inputs <= 0)
+    {
+        fprintf(stderr, "Invalid shared dictionary parameters\n");
+        return 1;
+    }
+    if (num_inputs == 1)
+        min_files = 1;
+    size_t block_size_bytes = (size_t)block_size_samples * (size_t)width_bytes;
+
+    // all: 모든 입력의 고유 block, files[id]: 그 block 이 나온 파일 수
+    Dictionary all;
+    dict_init(&all, block_size_bytes);
+    int *files = NULL;
+    int files_cap = 0;
+    for (int f = 0; f < num_inputs; ++f)
+    {
+        const unsigned char *data = NULL;
+        size_t nbytes = 0;
+        if (map_binary_file(inputs[f], &data, &nbytes) != 0)
+        {
+            free(files);
+            dict_free(&all);
+            return 1;
+        }
+        // 파일 하나 안의 중복은 한 번만 센다
+        Dictionary seen;
+        dict_init(&seen, block_size_bytes);
+        size_t num_blocks = nbytes / block_size_bytes;
+        for (size_t b = 0; b < num_blocks; ++b)
+        {
+            const unsigned char *block = data + b * block_size_bytes;
+            uint64_t h = dict_hash(&seen, block);
+            if (dict_find_hashed(&seen, block, h) >= 0)
+                continue;
+            dict_add_hashed(&seen, block, h);
+            int id = dict_find_hashed(&all, block, h);
+            if (id < 0)
+            {
+                id = dict_add_hashed(&all, block, h);
+                if (id >= files_cap)
+                {
+                    int new_cap = files_cap ? files_cap * 2 : 1024;
+                    int *grown = (int *)realloc(files, sizeof(int) * (size_t)new_cap);
+                    if (!grown)
+                    {
+                        fprintf(stderr, "Failed to allocate block counts\n");
+                        free(files);
+                        dict_free(&seen);
+                        dict_free(&all);
+                        unmap_binary_file(data, nbytes);
+                        return 1;
+                    }
+                    files = grown;
+                    files_cap = new_cap;
+                }
+                files[id] = 0;
+            }
+            files[id] += 1;
+        }
+        dict_free(&seen);
+        unmap_binary_file(data, nbytes);
+    }
+
+    Dictionary shared;
+    dict_init(&shared, block_size_bytes);
+    for (int id = 0; id < all.size; ++id)
+    {
+        if (files[id] >= min_files)
+            dict_add(&shared, dict_block(&all, id));
+    }
+    free(files);
+    dict_free(&all);
+
+    dict_reindex(&shared);
+    int ret = save_shared_dict(filename, &shared, width_bytes, block_size_samples, with_index);
+    dict_free(&shared);
+    return ret;
+}
@@ -0,0 +1,106 @@
+#include "../include/stats.h"
+
+#ifdef DDP_STATS
+
+#include "../include/compressor.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+DdpStats ddp_stats;
+
+static const char *const phase_names[STATS_PHASES] = {
+    "read_sec", "dedup_sec", "dict_write_sec", "id_write_sec"
+};
+
+double stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void stats_reset(void)
+{
+    memset(&ddp_stats, 0, sizeof(ddp_stats));
+}
+
+static uint64_t file_size(const char *filename)
+{
+    struct stat st;
+    return stat(filename, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+// JSON 문자열, CSV 필드 어느 쪽에도 안전하도록 따옴표 안에 쓴다
+static void write_quoted(FILE *fp, const char *s, int json)
+{
+    fputc('"', fp);
+    for (; *s; ++s)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"')
+            fputs(json ? "\\\"" : "\"\"", fp);
+        else if (json && c == '\\')
+            fputs("\\\\", fp);
+        else if (json && c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+int stats_write(FILE *fp, const char *format, const char *input_filename,
+                const char *output_filename)
+{
+    int json = strcmp(format, "json") == 0;
+    if (!json && strcmp(format, "csv") != 0)
+    {
+        fprintf(stderr, "Unknown stats format '%s'\n", format);
+        return 1;
+    }
+    DdpInfo info;
+    if (read_ddp_info(output_filename, &info) != 0)
+        return 1;
+
+    uint64_t bytes_in = file_size(input_filename);
+    uint64_t bytes_out = file_size(output_filename);
+    double ratio = bytes_out ? (double)bytes_in / (double)bytes_out : 0.0;
+
+    if (json)
+    {
+        fputs("{\"input\":", fp);
+        write_quoted(fp, input_filename, 1);
+        fputs(",\"output\":", fp);
+        write_quoted(fp, output_filename, 1);
+        fprintf(fp, ",\"block_size_samples\":%d,\"num_blocks\":%u,\"dict_size\":%u",
+                info.block_size_samples, info.num_blocks, info.dict_size);
+        fprintf(fp, ",\"bytes_in\":%llu,\"bytes_out\":%llu,\"ratio\":%.4f",
+                (unsigned long long)bytes_in, (unsigned long long)bytes_out, ratio);
+        for (int p = 0; p < STATS_PHASES; ++p)
+            fprintf(fp, ",\"%s\":%.6f", phase_names[p], ddp_stats.phase_sec[p]);
+        fprintf(fp, ",\"probes\":%llu,\"probe_slots\":%llu,\"hash_collisions\":%llu,\"inserts\":%llu}\n",
+                (unsigned long long)ddp_stats.probes, (unsigned long long)ddp_stats.probe_slots,
+                (unsigned long long)ddp_stats.hash_collisions, (unsigned long long)ddp_stats.inserts);
+    }
+    else
+    {
+        fputs("input,output,block_size_samples,num_blocks,dict_size,bytes_in,bytes_out,ratio", fp);
+        for (int p = 0; p < STATS_PHASES; ++p)
+            fprintf(fp, ",%s", phase_names[p]);
+        fputs(",probes,probe_slots,hash_collisions,inserts\n", fp);
+        write_quoted(fp, input_filename, 0);
+        fputc(',', fp);
+        write_quoted(fp, output_filename, 0);
+        fprintf(fp, ",%d,%u,%u,%llu,%llu,%.4f", info.block_size_samples, info.num_blocks,
+                info.dict_size, (unsigned long long)bytes_in, (unsigned long long)bytes_out, ratio);
+        for (int p = 0; p < STATS_PHASES; ++p)
+            fprintf(fp, ",%.6f", ddp_stats.phase_sec[p]);
+        fprintf(fp, ",%llu,%llu,%llu,%llu\n",
+                (unsigned long long)ddp_stats.probes, (unsigned long long)ddp_stats.probe_slots,
+                (unsigned long long)ddp_stats.hash_collisions, (unsigned long long)ddp_stats.inserts);
+    }
+    return ferror(fp) ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "../include/transform.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void transform_init(TransformState *t, int kind, int width)
+{
+    t->kind = kind;
+    t->width = width;
+    t->prev = 0;
+}
+
+int transform_parse(const char *name)
+{
+    if (strcmp(name, "none") == 0)
+        return DDP_TRANSFORM_NONE;
+    if (strcmp(name, "delta") == 0)
+        return DDP_TRANSFORM_DELTA;
+    if (strcmp(name, "xor") == 0)
+        return DDP_TRANSFORM_XOR;
+    return -1;
+}
+
+static inline uint64_t load_sample(const unsigned char *p, int width)
+{
+    uint64_t v = 0;
+    for (int k = 0; k < width; ++k)
+    {
+        v |= (uint64_t)p[k] << (8 * k);
+    }
+    return v;
+}
+
+static inline void store_sample(unsigned char *p, uint64_t v, int width)
+{
+    for (int k = 0; k < width; ++k)
+    {
+        p[k] = (unsigned char)(v >> (8 * k));
+    }
+}
+
+static uint64_t width_mask(int width)
+{
+    return width == 8 ? UINT64_MAX : (((uint64_t)1 << (8 * width)) - 1);
+}
+
+// 나머지 샘플과 1/8 바이트 폭은 scalar 로 처리한다
+static void encode_scalar(TransformState *t, const unsigned char *in, unsigned char *out, size_t n)
+{
+    int w = t->width;
+    uint64_t mask = width_mask(w);
+    uint64_t prev = t->prev;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t x = load_sample(in + i * (size_t)w, w);
+        uint64_t y = (t->kind == DDP_TRANSFORM_DELTA) ? (x - prev) & mask : x ^ prev;
+        store_sample(out + i * (size_t)w, y, w);
+        prev = x;
+    }
+    t->prev = prev;
+}
+
+static void decode_scalar(TransformState *t, unsigned char *data, size_t n)
+{
+    int w = t->width;
+    uint64_t mask = width_mask(w);
+    uint64_t prev = t->prev;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t y = load_sample(data + i * (size_t)w, w);
+        uint64_t x = (t->kind == DDP_TRANSFORM_DELTA) ? (y + prev) & mask : y ^ prev;
+        store_sample(data + i * (size_t)w, x, w);
+        prev = x;
+    }
+    t->prev = prev;
+}
+
+#ifdef __SSE2__
+// 16바이트 register 안에서 직전 샘플 vector 는 cur 를 한 lane 밀고 이전 register 의
+// 마지막 lane 을 채워 만든다. 다시 읽지 않으므로 in == out 이어도 안전하다.
+// 역변환은 lane 간 prefix sum/xor (log2(lane 수) 단계) 뒤에 이전 마지막 값을 더한다.
+
+#define DEFINE_SSE2_KERNELS(BITS, LANE_BYTES, ADD, SUB, BROADCAST_LAST)                     \
+static size_t encode_sse2_##BITS(int kind, const unsigned char *in, unsigned char *out,      \
+                                 size_t n, uint64_t *prev)                                   \
+{                                                                                            \
+    const size_t lanes = 16 / LANE_BYTES;                                                    \
+    size_t vec = n - n % lanes;                                                              \
+    __m128i carry = _mm_cvtsi32_si128((int)*prev);                                           \
+    for (size_t i = 0; i < vec; i += lanes)                                                  \
+    {                                                                                        \
+        __m128i cur = _mm_loadu_si128((const __m128i *)(in + i * LANE_BYTES));               \
+        __m128i before = _mm_or_si128(_mm_slli_si128(cur, LANE_BYTES), carry);               \
+        __m128i y = (kind == DDP_TRANSFORM_DELTA) ? SUB(cur, before)                         \
+                                                  : _mm_xor_si128(cur, before);              \
+        carry = _mm_srli_si128(cur, 16 - LANE_BYTES);                                        \
+        _mm_storeu_si128((__m128i *)(out + i * LANE_BYTES), y);                              \
+    }                                                                                        \
+    if (vec > 0)                                                                             \
+        *prev = (uint64_t)(uint32_t)_mm_cvtsi128_si32(carry);                                \
+    return vec;                                                                              \
+}                                                                                            \
+                                                                                             \
+static size_t decode_sse2_##BITS(int kind, unsigned char *data, size_t n, uint64_t *prev)    \
+{                                                                                            \
+    const size_t lanes = 16 / LANE_BYTES;                                                    \
+    size_t vec = n - n % lanes;                                                              \
+    __m128i last = BROADCAST_LAST(_mm_cvtsi32_si128((int)*prev), 1);                         \
+    for (size_t i = 0; i < vec; i += lanes)                                                  \
+    {                                                                                        \
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i * LANE_BYTES));               \
+        if (kind == DDP_TRANSFORM_DELTA)                                                     \
+        {                                                                                    \
+            for (int s = LANE_BYTES; s < 16; s *= 2)                                         \
+                v = ADD(v, shift_left_bytes(v, s));                                          \
+            v = ADD(v, last);                                                                \
+        }                                                                                    \
+        else                                                                                 \
+        {                                                                                    \
+            for (int s = LANE_BYTES; s < 16; s *= 2)                                         \
+                v = _mm_xor_si128(v, shift_left_bytes(v, s));                                \
+            v = _mm_xor_si128(v, last);                                                      \
+        }                                                                                    \
+        _mm_storeu_si128((__m128i *)(data + i * LANE_BYTES), v);                             \
+        last = BROADCAST_LAST(v, 0);                                                         \
+    }                                                                                        \
+    if (vec > 0)                                                                             \
+        *prev = (uint64_t)(uint32_t)_mm_cvtsi128_si32(last) & width_mask(LANE_BYTES);        \
+    return vec;                                                                              \
+}
+
+// _mm_slli_si128 은 즉시값만 받으므로 prefix 단계에 쓰는 이동량만 펼쳐 둔다
+static inline __m128i shift_left_bytes(__m128i v, int s)
+{
+    switch (s)
+    {
+    case 2:
+        return _mm_slli_si128(v, 2);
+    case 4:
+        return _mm_slli_si128(v, 4);
+    default:
+        return _mm_slli_si128(v, 8);
+    }
+}
+
+// from_low: lane 0 을 (처음 호출), 아니면 마지막 lane 을 모든 lane 에 복제
+static inline __m128i broadcast_last_16(__m128i v, int from_low)
+{
+    if (from_low)
+        return _mm_set1_epi16((short)_mm_cvtsi128_si32(v));
+    __m128i hi = _mm_shufflehi_epi16(v, 0xFF);
+    return _mm_unpackhi_epi64(hi, hi);
+}
+
+static inline __m128i broadcast_last_32(__m128i v, int from_low)
+{
+    return from_low ? _mm_shuffle_epi32(v, 0x00) : _mm_shuffle_epi32(v, 0xFF);
+}
+
+DEFINE_SSE2_KERNELS(16, 2, _mm_add_epi16, _mm_sub_epi16, broadcast_last_16)
+DEFINE_SSE2_KERNELS(32, 4, _mm_add_epi32, _mm_sub_epi32, broadcast_last_32)
+#endif
+
+void transform_encode(TransformState *t, const unsigned char *in, unsigned char *out, size_t n)
+{
+    if (t->kind == DDP_TRANSFORM_NONE)
+    {
+        if (in != out)
+            memcpy(out, in, n * (size_t)t->width);
+        return;
+    }
+    size_t done = 0;
+#ifdef __SSE2__
+    if (t->width == 2)
+        done = encode_sse2_16(t->kind, in, out, n, &t->prev);
+    else if (t->width == 4)
+        done = encode_sse2_32(t->kind, in, out, n, &t->prev);
+#endif
+    size_t off = done * (size_t)t->width;
+    encode_scalar(t, in + off, out + off, n - done);
+}
+
+void transform_decode(TransformState *t, unsigned char *data, size_t n)
+{
+    if (t->kind == DDP_TRANSFORM_NONE)
+        return;
+    size_t done = 0;
+#ifdef __SSE2__
+    if (t->width == 2)
+        done = decode_sse2_16(t->kind, data, n, &t->prev);
+    else if (t->width == 4)
+        done = decode_sse2_32(t->kind, data, n, &t->prev);
+#endif
+    decode_scalar(t, data + done * (size_t)t->width, n - done);
+}
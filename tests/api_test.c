@@ -0,0 +1,136 @@
+// ddp_compress_buf / ddp_decompress_buf 를 하나의 DdpContext 로 되풀이해 왕복을 확인한다.
+// 사용법: api_test <input.bin> <dict_input.bin> <work_dir>
+// 공유 dictionary 는 dict_input 으로 만들므로 input 과 다르면 공유 항목 뒤에 새 항목이 붙는다.
+#include "../include/compressor.h"
+#include "../include/shared_dict.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH_BYTES 2
+#define BLOCK_SAMPLES 8
+
+// 압축 -> 복원 한 번. 복원 결과가 src 와 같으면 0. 압축 결과는 *packed 에 복사해 둔다.
+static int round_trip(DdpContext *ctx, const unsigned char *src, size_t nbytes,
+                      const CompressOptions *opts, const SharedDict *shared,
+                      unsigned char **packed, size_t *packed_len)
+{
+    const unsigned char *out;
+    size_t out_len;
+    if (ddp_compress_buf(ctx, src, nbytes, WIDTH_BYTES, BLOCK_SAMPLES, opts, &out, &out_len) != 0)
+    {
+        fprintf(stderr, "ddp_compress_buf failed\n");
+        return 1;
+    }
+    // 결과는 ctx 소유이고 복원이 덮어쓰므로 복사한다
+    *packed = (unsigned char *)malloc(out_len > 0 ? out_len : 1);
+    if (!*packed)
+    {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
+    memcpy(*packed, out, out_len);
+    *packed_len = out_len;
+
+    if (ddp_decompress_buf(ctx, *packed, *packed_len, shared, &out, &out_len) != 0)
+    {
+        fprintf(stderr, "ddp_decompress_buf failed\n");
+        return 1;
+    }
+    if (out_len != nbytes || memcmp(out, src, nbytes) != 0)
+    {
+        fprintf(stderr, "Round trip mismatch: %zu bytes in, %zu bytes out\n", nbytes, out_len);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4)
+    {
+        fprintf(stderr, "Usage: %s <input.bin> <dict_input.bin> <work_dir>\n", argv[0]);
+        return 1;
+    }
+    unsigned char *data = NULL;
+    size_t nbytes = 0;
+    if (read_binary_file(argv[1], &data, &nbytes) != 0)
+        return 1;
+    nbytes -= nbytes % WIDTH_BYTES;
+
+    // index 가 있는 공유 dictionary 는 mmap 한 table 을 빌려 쓰므로 truncate 경로도 함께 본다
+    char dict_path[4096];
+    snprintf(dict_path, sizeof(dict_path), "%s/api_test.ddpd", argv[3]);
+    const char *inputs[1] = { argv[2] };
+    SharedDict sd;
+    if (shared_dict_build(dict_path, inputs, 1, WIDTH_BYTES, BLOCK_SAMPLES, 1, 1) != 0 ||
+        shared_dict_load(dict_path, &sd) != 0)
+    {
+        free(data);
+        return 1;
+    }
+    if (shared_dict_verify(dict_path, &sd) != 0)
+    {
+        shared_dict_free(&sd);
+        free(data);
+        return 1;
+    }
+
+    DdpContext ctx;
+    if (ddp_context_init(&ctx) != 0)
+    {
+        shared_dict_free(&sd);
+        free(data);
+        return 1;
+    }
+
+    int failed = 0;
+    // bit 0: freq_order, bit 1: shared, bit 2: rle_ids. 같은 context 로 입력 크기를 바꿔 가며
+    // 두 번씩 압축해 같은 바이트가 나오는지도 본다 (공유 dictionary 가 원래대로 돌아왔는지)
+    for (int mode = 0; mode < 8; ++mode)
+    {
+        CompressOptions opts;
+        compress_options_init(&opts);
+        opts.freq_order = mode & 1;
+        opts.shared = (mode & 2) ? &sd : NULL;
+        opts.rle_ids = (mode & 4) ? 1 : 0;
+        size_t sizes[3] = { nbytes, nbytes / 2 - (nbytes / 2) % WIDTH_BYTES, nbytes };
+        unsigned char *first = NULL;
+        size_t first_len = 0;
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            unsigned char *packed = NULL;
+            size_t packed_len = 0;
+            int ret = round_trip(&ctx, data, sizes[pass], &opts, opts.shared, &packed, &packed_len);
+            if (ret == 0 && pass == 2 &&
+                (packed_len != first_len || memcmp(packed, first, packed_len) != 0))
+            {
+                fprintf(stderr, "Output changed when the context was reused\n");
+                ret = 1;
+            }
+            if (ret != 0)
+            {
+                fprintf(stderr, "FAIL: freq_order=%d shared=%d rle=%d pass=%d\n",
+                        opts.freq_order, opts.shared != NULL, opts.rle_ids, pass);
+                failed = 1;
+            }
+            if (pass == 0)
+            {
+                first = packed;
+                first_len = packed_len;
+            }
+            else
+            {
+                free(packed);
+            }
+        }
+        free(first);
+    }
+
+    ddp_context_free(&ctx);
+    shared_dict_free(&sd);
+    free(data);
+    if (!failed)
+        printf("api_test: ok\n");
+    return failed;
+}
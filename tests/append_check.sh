@@ -0,0 +1,96 @@
+#!/usr/bin/env bash
+# 'a' (append) 왕복: block 에 맞지 않는 조각을 이어 붙여 앞 segment 들도 tail 을 갖게 하고
+# 전체 복원 (-j 1/4), 구간 복원, 확정되지 않은 segment 가 남은 파일을 확인한다.
+# 사용법: tests/append_check.sh <dedup_bin> <work_dir> <input.bin>...
+set -u
+
+BIN=$1
+WORK=$2
+shift 2
+WIDTH=2
+BLOCK=8
+LIMIT=60
+
+fail() {
+    echo "append_check: FAIL: $*" >&2
+    exit 1
+}
+
+run() {
+    timeout "$LIMIT" "$@" >/dev/null 2>"$WORK/last.err" || {
+        cat "$WORK/last.err" >&2
+        fail "$*"
+    }
+}
+
+# 원본의 [start, start + count) 샘플과 r 결과를 비교한다
+check_range() {
+    local ddp=$1 src=$2 start=$3 count=$4
+    run "$BIN" r "$ddp" "$start" "$count" "$WORK/range.out"
+    dd if="$src" of="$WORK/range.ref" bs="$WIDTH" skip="$start" count="$count" status=none
+    cmp -s "$WORK/range.ref" "$WORK/range.out" || fail "r $ddp $start $count"
+}
+
+rm -rf "$WORK"
+mkdir -p "$WORK"
+
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    samples=$(( $(stat -c %s "$input") / WIDTH ))
+    # block 경계에 맞지 않는 세 조각과 block 하나보다 짧은 조각
+    a=$(( samples / 3 / BLOCK * BLOCK + 3 ))
+    b=$(( samples / 3 / BLOCK * BLOCK + 5 ))
+    c=$(( BLOCK / 2 + 1 ))
+    head -c $(( a * WIDTH )) "$input" > "$WORK/p1.bin"
+    tail -c +$(( a * WIDTH + 1 )) "$input" | head -c $(( b * WIDTH )) > "$WORK/p2.bin"
+    tail -c +$(( (a + b) * WIDTH + 1 )) "$input" > "$WORK/p3.bin"
+    head -c $(( c * WIDTH )) "$input" > "$WORK/p4.bin"
+    cat "$WORK/p1.bin" "$WORK/p2.bin" "$WORK/p3.bin" "$WORK/p4.bin" > "$WORK/$name.ref"
+    total=$(( $(stat -c %s "$WORK/$name.ref") / WIDTH ))
+
+    for opt in "" "-r" "-p -r"; do
+        ddp=$WORK/$name.ddp
+        run "$BIN" c $opt "$WIDTH" "$BLOCK" "$WORK/p1.bin" "$ddp"
+        cp "$ddp" "$WORK/one.ddp"
+        run "$BIN" a "$WORK/p2.bin" "$ddp"
+        cp "$ddp" "$WORK/two.ddp"
+        run "$BIN" a "$WORK/p3.bin" "$ddp"
+        run "$BIN" a "$WORK/p4.bin" "$ddp"
+
+        for j in 1 4; do
+            run "$BIN" d -j "$j" "$ddp" "$WORK/$name.out"
+            cmp -s "$WORK/$name.ref" "$WORK/$name.out" || fail "a $opt $name (d -j $j)"
+        done
+        check_range "$ddp" "$WORK/$name.ref" 0 "$total"
+        check_range "$ddp" "$WORK/$name.ref" $(( a - 2 )) $(( b + 4 ))
+        check_range "$ddp" "$WORK/$name.ref" $(( a + b - 1 )) 3
+        check_range "$ddp" "$WORK/$name.ref" $(( total - c - 1 )) $(( c + 1 ))
+
+        # p3 를 쓰다 멈춘 파일: magic 이 비어 있는 segment 는 없는 것으로 보고
+        # 다음 append 가 그 자리를 덮어쓴다
+        two=$(stat -c %s "$WORK/two.ddp")
+        cp "$ddp" "$WORK/crash.ddp"
+        printf '\0\0\0\0' | dd of="$WORK/crash.ddp" bs=1 seek="$two" conv=notrunc status=none
+        run "$BIN" d "$WORK/crash.ddp" "$WORK/crash.out"
+        cat "$WORK/p1.bin" "$WORK/p2.bin" > "$WORK/crash.ref"
+        cmp -s "$WORK/crash.ref" "$WORK/crash.out" || fail "pending segment $opt $name"
+        run "$BIN" a "$WORK/p4.bin" "$WORK/crash.ddp"
+        run "$BIN" d "$WORK/crash.ddp" "$WORK/crash.out"
+        cat "$WORK/p1.bin" "$WORK/p2.bin" "$WORK/p4.bin" > "$WORK/crash.ref"
+        cmp -s "$WORK/crash.ref" "$WORK/crash.out" || fail "append after pending $opt $name"
+
+        # 첫 append 가 header flag (13 번째 바이트) 를 쓰기 전에 멈춘 파일
+        one=$(stat -c %s "$WORK/one.ddp")
+        cp "$WORK/two.ddp" "$WORK/crash.ddp"
+        dd if="$WORK/one.ddp" of="$WORK/crash.ddp" bs=1 skip=13 seek=13 count=1 conv=notrunc status=none
+        printf '\0\0\0\0' | dd of="$WORK/crash.ddp" bs=1 seek="$one" conv=notrunc status=none
+        run "$BIN" d "$WORK/crash.ddp" "$WORK/crash.out"
+        cmp -s "$WORK/p1.bin" "$WORK/crash.out" || fail "pending first segment $opt $name"
+        run "$BIN" a "$WORK/p4.bin" "$WORK/crash.ddp"
+        run "$BIN" d "$WORK/crash.ddp" "$WORK/crash.out"
+        cat "$WORK/p1.bin" "$WORK/p4.bin" > "$WORK/crash.ref"
+        cmp -s "$WORK/crash.ref" "$WORK/crash.out" || fail "append after pending first segment $opt $name"
+    done
+done
+
+echo "append_check: ok"
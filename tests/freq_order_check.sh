@@ -0,0 +1,99 @@
+#!/usr/bin/env bash
+# -F (빈도순 번호) 뒤에 dictionary 를 truncate 하는 경로를 모두 왕복해 본다:
+# 단일 파일, 공유 dictionary (-D, index 포함), batch ('m'), 서버 ('w').
+# 마지막으로 index table 이 깨진 공유 dictionary 로도 끝나고 왕복하는지 본다.
+# 사용법: tests/freq_order_check.sh <dedup_bin> <dict_input.bin> <work_dir> <input.bin>...
+set -u
+
+BIN=$1
+DICT_INPUT=$2
+WORK=$3
+shift 3
+WIDTH=2
+BLOCK=8
+# 예전에는 truncate 가 끝나지 않았으므로 명령마다 시간 제한을 둔다
+LIMIT=60
+
+fail() {
+    echo "freq_order_check: FAIL: $*" >&2
+    exit 1
+}
+
+run() {
+    timeout "$LIMIT" "$@" >/dev/null 2>"$WORK/last.err" || {
+        cat "$WORK/last.err" >&2
+        fail "$*"
+    }
+}
+
+rm -rf "$WORK"
+mkdir -p "$WORK/in" "$WORK/batch" "$WORK/watch" "$WORK/served"
+DICT=$WORK/shared.ddpd
+run "$BIN" t -n 1 -i "$WIDTH" "$BLOCK" "$DICT" "$DICT_INPUT"
+
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    cp "$input" "$WORK/in/"
+
+    run "$BIN" c -F "$WIDTH" "$BLOCK" "$input" "$WORK/$name.ddp"
+    run "$BIN" d "$WORK/$name.ddp" "$WORK/$name.out"
+    cmp -s "$input" "$WORK/$name.out" || fail "c -F $name"
+
+    run "$BIN" c -F -D "$DICT" "$WIDTH" "$BLOCK" "$input" "$WORK/$name.shared.ddp"
+    run "$BIN" d -D "$DICT" "$WORK/$name.shared.ddp" "$WORK/$name.shared.out"
+    cmp -s "$input" "$WORK/$name.shared.out" || fail "c -F -D $name"
+done
+
+# batch 와 서버는 같은 공유 dictionary 로 여러 파일을 이어서 압축한다
+run "$BIN" m -F -D "$DICT" "$WIDTH" "$BLOCK" "$WORK/in" "$WORK/batch"
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    run "$BIN" d -D "$DICT" "$WORK/batch/$name.ddp" "$WORK/$name.batch.out"
+    cmp -s "$input" "$WORK/$name.batch.out" || fail "m -F -D $name"
+done
+
+# 서버는 시작할 때 watch_dir 에 있는 파일을 모두 압축한다. 샘플이 없는 파일 하나는 실패하지만
+# 서버는 나머지를 처리하고 요약에 실패 수를 남긴 채 0 으로 끝나야 한다
+cp "$@" "$WORK/watch/"
+printf 'x' > "$WORK/watch/short.bin"
+"$BIN" w -F -D "$DICT" "$WIDTH" "$BLOCK" "$WORK/watch" "$WORK/served" >/dev/null 2>"$WORK/server.err" &
+server=$!
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    waited=0
+    while [ ! -f "$WORK/served/$name.ddp" ] && [ "$waited" -lt "$((LIMIT * 10))" ]; do
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+done
+kill -TERM "$server" 2>/dev/null
+wait "$server" || { cat "$WORK/server.err" >&2; fail "w exited nonzero after a clean drain"; }
+grep -q ", 1 failed," "$WORK/server.err" || { cat "$WORK/server.err" >&2; fail "w summary misses the failed job"; }
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    [ -f "$WORK/served/$name.ddp" ] || { cat "$WORK/server.err" >&2; fail "w -F -D $name: no output"; }
+    run "$BIN" d -D "$DICT" "$WORK/served/$name.ddp" "$WORK/$name.served.out"
+    cmp -s "$input" "$WORK/$name.served.out" || fail "w -F -D $name"
+done
+
+# index table 의 모든 slot 을 id 0 으로 채운다. 예전에는 probe 가 빈 slot 을 찾지 못해 돌았다.
+# table 은 파일 끝의 table_size 개 u32 이고 table_size 는 그 앞 index header 의 u64 다.
+BROKEN=$WORK/broken.ddpd
+cp "$DICT" "$BROKEN"
+dict_size=$(od -An -t u4 -j 12 -N 4 "$BROKEN" | tr -d ' ')
+index_at=$(( (24 + dict_size * WIDTH * BLOCK + 7) / 8 * 8 ))
+table_size=$(od -An -t u8 -j "$index_at" -N 8 "$BROKEN" | tr -d ' ')
+printf '\001\000\000\000' > "$WORK/slots"
+while [ $(( $(stat -c %s "$WORK/slots") / 4 )) -lt "$table_size" ]; do
+    cat "$WORK/slots" "$WORK/slots" > "$WORK/slots.2" && mv "$WORK/slots.2" "$WORK/slots"
+done
+dd if="$WORK/slots" of="$BROKEN" bs=4 seek=$(( $(stat -c %s "$BROKEN") / 4 - table_size )) \
+   conv=notrunc status=none
+for input in "$@"; do
+    name=$(basename "$input" .bin)
+    run "$BIN" c -D "$BROKEN" "$WIDTH" "$BLOCK" "$input" "$WORK/$name.broken.ddp"
+    run "$BIN" d -D "$BROKEN" "$WORK/$name.broken.ddp" "$WORK/$name.broken.out"
+    cmp -s "$input" "$WORK/$name.broken.out" || fail "c -D with a broken index $name"
+done
+
+echo "freq_order_check: ok"